@@ -1,15 +1,160 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <limits>
+#include <new>
 #include <stdexcept>
 #include <iostream>
+#include <tuple>
+#include <utility>
 
 namespace GekkoDS {
     // fw declare types
     class MemStream;
     template <typename T> class Vec;
+    template <typename Q> class SparseIndex;
     template <typename Q, typename T> class SparseSet;
+    template <typename Q, typename... Ts> class SoASparseSet;
+    class FrameArena;
+    class Allocator;
+    class LinearAllocator;
+
+    template <typename T> void write_elements(const Vec<T>& vec, MemStream& stream);
+    template <typename T> void read_elements(Vec<T>& vec, uint32_t count, MemStream& stream);
+
+    // Memory source for every GekkoDS container.
+    class Allocator {
+    public:
+        virtual ~Allocator() = default;
+
+        virtual void* allocate(size_t size, size_t align) = 0;
+        virtual void deallocate(void* ptr, size_t size, size_t align) = 0;
+
+        // Resizes an allocation without moving it, returns false when that is not possible.
+        virtual bool grow_in_place(void* /*ptr*/, size_t /*old_size*/, size_t /*new_size*/) {
+            return false;
+        }
+    };
+
+    // Forwards to the global heap. min_align raises the alignment of every
+    // allocation, e.g. to keep container storage on its own cache lines.
+    class HeapAllocator : public Allocator {
+        size_t _min_align;
+
+    public:
+        explicit HeapAllocator(size_t min_align = 0) : _min_align(min_align) {}
+
+        void* allocate(size_t size, size_t align) override {
+            if (align < _min_align) align = _min_align;
+            if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+                return ::operator new(size, std::align_val_t(align));
+            }
+            return ::operator new(size);
+        }
+
+        void deallocate(void* ptr, size_t /*size*/, size_t align) override {
+            if (align < _min_align) align = _min_align;
+            if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+                ::operator delete(ptr, std::align_val_t(align));
+                return;
+            }
+            ::operator delete(ptr);
+        }
+    };
+
+    // Allocator used by containers that were not given one.
+    inline Allocator* default_allocator() {
+        static HeapAllocator heap;
+        return &heap;
+    }
+
+    // Bump allocator carving allocations out of large blocks taken from a parent.
+    // Only the most recent allocation can grow in place or be given back, anything
+    // else is reclaimed all at once by release() or the destructor. Handing one to
+    // a World lets a whole simulation be dropped without walking its containers.
+    class LinearAllocator : public Allocator {
+        struct Block {
+            Block* next;
+            size_t capacity;
+            size_t offset;
+        };
+        static constexpr size_t HEADER_SIZE = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+        Allocator* _parent;
+        size_t _block_size;
+        Block* _head = nullptr;
+        uint8_t* _last = nullptr;
+        size_t _reserved = 0;
+
+        static uint8_t* block_data(Block* block) {
+            return reinterpret_cast<uint8_t*>(block) + HEADER_SIZE;
+        }
+
+    public:
+        explicit LinearAllocator(size_t block_size = 64 * 1024, Allocator* parent = default_allocator())
+            : _parent(parent), _block_size(block_size) {}
+
+        LinearAllocator(const LinearAllocator&) = delete;
+        LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+        ~LinearAllocator() override {
+            release();
+        }
+
+        void* allocate(size_t size, size_t align) override {
+            if (_head) {
+                const uintptr_t base = reinterpret_cast<uintptr_t>(block_data(_head));
+                const uintptr_t start = (base + _head->offset + align - 1) & ~(uintptr_t(align) - 1);
+                if (start + size <= base + _head->capacity) {
+                    _head->offset = start + size - base;
+                    _last = reinterpret_cast<uint8_t*>(start);
+                    return _last;
+                }
+            }
+
+            size_t capacity = _block_size;
+            if (capacity < size + align) capacity = size + align;
+            Block* block = static_cast<Block*>(_parent->allocate(HEADER_SIZE + capacity, alignof(std::max_align_t)));
+            block->next = _head;
+            block->capacity = capacity;
+            block->offset = 0;
+            _head = block;
+            _reserved += HEADER_SIZE + capacity;
+            return allocate(size, align);
+        }
+
+        void deallocate(void* ptr, size_t /*size*/, size_t /*align*/) override {
+            // only the newest allocation can be rolled back
+            if (ptr && ptr == _last) {
+                _head->offset = _last - block_data(_head);
+                _last = nullptr;
+            }
+        }
+
+        bool grow_in_place(void* ptr, size_t /*old_size*/, size_t new_size) override {
+            if (!ptr || ptr != _last) return false;
+            const size_t start = _last - block_data(_head);
+            if (start + new_size > _head->capacity) return false;
+            _head->offset = start + new_size;
+            return true;
+        }
+
+        // Frees every block, all memory handed out becomes invalid.
+        void release() {
+            while (_head) {
+                Block* next = _head->next;
+                _parent->deallocate(_head, HEADER_SIZE + _head->capacity, alignof(std::max_align_t));
+                _head = next;
+            }
+            _last = nullptr;
+            _reserved = 0;
+        }
+
+        // Bytes taken from the parent allocator.
+        size_t reserved() const { return _reserved; }
+    };
 
     // A simple dynamic array for trivially copyable types.
     template <typename T>
@@ -19,6 +164,7 @@ namespace GekkoDS {
 
         T* _data = nullptr;
         uint32_t _size = 0, _capacity = 0;
+        Allocator* _allocator = default_allocator();
 
         void ensure_capacity(uint32_t min_capacity) {
             if (min_capacity <= _capacity) return;
@@ -28,11 +174,16 @@ namespace GekkoDS {
                 new_capacity *= 2;
             }
 
-            T* new_data = new T[new_capacity];
+            if (_data && _allocator->grow_in_place(_data, _capacity * sizeof(T), new_capacity * sizeof(T))) {
+                _capacity = new_capacity;
+                return;
+            }
+
+            T* new_data = static_cast<T*>(_allocator->allocate(new_capacity * sizeof(T), alignof(T)));
 
             if (_data) {
                 std::memcpy(new_data, _data, _size * sizeof(T));
-                delete[] _data;
+                _allocator->deallocate(_data, _capacity * sizeof(T), alignof(T));
             }
 
             _data = new_data;
@@ -45,22 +196,72 @@ namespace GekkoDS {
         template<typename U>
         friend void save_vec(Vec<U>& vec, MemStream& stream);
     public:
+        Vec() = default;
+        explicit Vec(Allocator* allocator) : _allocator(allocator ? allocator : default_allocator()) {}
+
         ~Vec() {
-            delete[] _data;
+            if (_data) {
+                _allocator->deallocate(_data, _capacity * sizeof(T), alignof(T));
+            }
+        }
+
+        // Moves hand the storage over together with its allocator, copies would share it.
+        Vec(const Vec&) = delete;
+        Vec& operator=(const Vec&) = delete;
+
+        Vec(Vec&& other) noexcept
+            : _data(other._data), _size(other._size), _capacity(other._capacity), _allocator(other._allocator) {
+            other._data = nullptr;
+            other._size = 0;
+            other._capacity = 0;
+        }
+
+        Vec& operator=(Vec&& other) noexcept {
+            if (this == &other) return *this;
+            if (_data) {
+                _allocator->deallocate(_data, _capacity * sizeof(T), alignof(T));
+            }
+            _data = other._data;
+            _size = other._size;
+            _capacity = other._capacity;
+            _allocator = other._allocator;
+            other._data = nullptr;
+            other._size = 0;
+            other._capacity = 0;
+            return *this;
+        }
+
+        // Moves the storage over to another allocator, nullptr selects the default.
+        void set_allocator(Allocator* allocator) {
+            if (!allocator) allocator = default_allocator();
+            if (allocator == _allocator) return;
+
+            T* new_data = nullptr;
+            if (_data) {
+                new_data = static_cast<T*>(allocator->allocate(_capacity * sizeof(T), alignof(T)));
+                std::memcpy(new_data, _data, _size * sizeof(T));
+                _allocator->deallocate(_data, _capacity * sizeof(T), alignof(T));
+            }
+            _data = new_data;
+            _allocator = allocator;
         }
 
+        Allocator* allocator() const { return _allocator; }
+
         void push_back(const T& value) {
             ensure_capacity(_size + 1);
             _data[_size++] = value;
         }
 
         void push_back_range(const Vec<T>& other) {
+            if (other._size == 0) return;
             ensure_capacity(_size + other._size);
             std::memcpy(_data + _size, other._data, other._size * sizeof(T));
             _size += other._size;
         }
 
         void push_back_range(const T* values, uint32_t count) {
+            if (count == 0) return;
             ensure_capacity(_size + count);
             std::memcpy(_data + _size, values, count * sizeof(T));
             _size += count;
@@ -82,6 +283,26 @@ namespace GekkoDS {
             pop_back();
         }
 
+        // Inserts before index and shifts the tail up, keeping the order.
+        void insert_at(uint32_t index, const T& value) {
+            if (index > _size) {
+                return;
+            }
+            ensure_capacity(_size + 1);
+            std::memmove(_data + index + 1, _data + index, (_size - index) * sizeof(T));
+            _data[index] = value;
+            _size++;
+        }
+
+        // Removes index and shifts the tail down, keeping the order.
+        void erase_at(uint32_t index) {
+            if (index >= _size) {
+                return;
+            }
+            std::memmove(_data + index, _data + index + 1, (_size - index - 1) * sizeof(T));
+            _size--;
+        }
+
         void remove_first(const T& value) {
             for (uint32_t i = 0; i < _size; ++i) {
                 if (_data[i] == value) {
@@ -116,6 +337,12 @@ namespace GekkoDS {
 
         void clear() { _size = 0; }
 
+        // Grows or shrinks the size. New elements are left uninitialized.
+        void resize(uint32_t size) {
+            ensure_capacity(size);
+            _size = size;
+        }
+
         T* data() { return _data; }
 
         T* begin() { return _data; }
@@ -125,11 +352,153 @@ namespace GekkoDS {
         const T* end() const { return _data + _size; }
     };
 
+    // Linear allocator for memory that only lives until the next reset().
+    // alloc() bumps an offset into one block. Requests that do not fit get a
+    // block of their own, and the next reset() swaps everything for a single
+    // block that covers the whole frame, so a warmed up arena never allocates.
+    // Memory is handed out uninitialized and never destructed.
+    class FrameArena {
+        // Header of a block that served a request the main block could not.
+        struct Overflow {
+            Overflow* next;
+            uint32_t size;
+        };
+        static constexpr uint32_t MAX_ALIGN = alignof(std::max_align_t);
+        static constexpr uint32_t HEADER_SIZE = (sizeof(Overflow) + MAX_ALIGN - 1) & ~(MAX_ALIGN - 1);
+
+        uint8_t* _block = nullptr;
+        uint32_t _capacity = 0;
+        uint32_t _offset = 0;
+
+        Overflow* _overflow = nullptr;
+        uint32_t _overflow_size = 0;
+
+        Allocator* _allocator = default_allocator();
+
+        void release_overflow() {
+            while (_overflow) {
+                Overflow* next = _overflow->next;
+                _allocator->deallocate(_overflow, HEADER_SIZE + _overflow->size, MAX_ALIGN);
+                _overflow = next;
+            }
+            _overflow_size = 0;
+        }
+
+        void release_block() {
+            if (_block) {
+                _allocator->deallocate(_block, _capacity, MAX_ALIGN);
+            }
+            _block = nullptr;
+            _capacity = 0;
+            _offset = 0;
+        }
+
+    public:
+        FrameArena() = default;
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        ~FrameArena() {
+            release_overflow();
+            release_block();
+        }
+
+        FrameArena(FrameArena&& other) noexcept
+            : _block(other._block), _capacity(other._capacity), _offset(other._offset),
+            _overflow(other._overflow), _overflow_size(other._overflow_size), _allocator(other._allocator) {
+            other._block = nullptr;
+            other._capacity = 0;
+            other._offset = 0;
+            other._overflow = nullptr;
+            other._overflow_size = 0;
+        }
+
+        FrameArena& operator=(FrameArena&& other) noexcept {
+            if (this == &other) return *this;
+            release_overflow();
+            release_block();
+            _block = other._block;
+            _capacity = other._capacity;
+            _offset = other._offset;
+            _overflow = other._overflow;
+            _overflow_size = other._overflow_size;
+            _allocator = other._allocator;
+            other._block = nullptr;
+            other._capacity = 0;
+            other._offset = 0;
+            other._overflow = nullptr;
+            other._overflow_size = 0;
+            return *this;
+        }
+
+        // Drops all memory and takes future blocks from another allocator.
+        void set_allocator(Allocator* allocator) {
+            release_overflow();
+            release_block();
+            _allocator = allocator ? allocator : default_allocator();
+        }
+
+        void* alloc_bytes(uint32_t size, uint32_t align) {
+            if (align > MAX_ALIGN) {
+                throw std::invalid_argument("FrameArena alignment too large");
+            }
+
+            const uint32_t start = (_offset + align - 1) & ~(align - 1);
+            if (start + size <= _capacity) {
+                _offset = start + size;
+                return _block + start;
+            }
+
+            // did not fit, serve it separately and remember to grow on reset
+            uint8_t* raw = static_cast<uint8_t*>(_allocator->allocate(HEADER_SIZE + size, MAX_ALIGN));
+            Overflow* overflow = reinterpret_cast<Overflow*>(raw);
+            overflow->next = _overflow;
+            overflow->size = size;
+            _overflow = overflow;
+            _overflow_size += size + align;
+            return raw + HEADER_SIZE;
+        }
+
+        template <typename T>
+        T* alloc(uint32_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "DS::FrameArena only supports trivially copyable types");
+            return static_cast<T*>(alloc_bytes(count * sizeof(T), alignof(T)));
+        }
+
+        // Invalidates everything handed out since the last reset.
+        void reset() {
+            if (_overflow) {
+                uint32_t needed = _offset + _overflow_size;
+                uint32_t new_capacity = _capacity ? _capacity : 1024;
+                while (new_capacity < needed) {
+                    new_capacity *= 2;
+                }
+                release_overflow();
+                release_block();
+                _block = static_cast<uint8_t*>(_allocator->allocate(new_capacity, MAX_ALIGN));
+                _capacity = new_capacity;
+            }
+            _offset = 0;
+        }
+
+        uint32_t capacity() const { return _capacity; }
+        uint32_t used() const { return _offset + _overflow_size; }
+    };
+
     // Simple memory stream. Mostly used for saving and loading state of a component.
     class MemStream {
         bool _own_buffer;
         size_t _offset = 0;
         Vec<uint8_t>* _buffer;
+        // Read-only view over memory the stream does not own, e.g. a mapped file.
+        const uint8_t* _view = nullptr;
+        size_t _view_size = 0;
+
+        void check_writable() const {
+            if (!_buffer) {
+                throw std::invalid_argument("MemStream is read-only");
+            }
+        }
 
     public:
         // gives you the option top pass your own buffer
@@ -144,6 +513,14 @@ namespace GekkoDS {
             }
         }
 
+        // Reads in place from memory that has to outlive the stream, writes throw.
+        MemStream(const uint8_t* data, size_t size) {
+            _buffer = nullptr;
+            _own_buffer = false;
+            _view = data;
+            _view_size = size;
+        }
+
         ~MemStream() {
             if (_own_buffer) {
                 delete _buffer;
@@ -152,6 +529,7 @@ namespace GekkoDS {
 
 
         void write_chunk(const void* data, uint32_t size) {
+            check_writable();
             _buffer->push_back_range(reinterpret_cast<const uint8_t*>(&size), sizeof(size));
             _offset += sizeof(size);
             _buffer->push_back_range(reinterpret_cast<const uint8_t*>(data), size);
@@ -161,55 +539,105 @@ namespace GekkoDS {
         // Read size-prefixed chunk and advance offset past size+data automatically
         // Returns nullptr if not enough data
         const uint8_t* read_chunk(uint32_t& out_size) {
-            if (_offset + sizeof(uint32_t) > _buffer->size())
+            if (_offset + sizeof(uint32_t) > size())
                 return nullptr;
 
-            uint32_t size;
-            std::memcpy(&size, _buffer->data() + _offset, sizeof(uint32_t));
+            uint32_t chunk_size;
+            std::memcpy(&chunk_size, data() + _offset, sizeof(uint32_t));
 
-            if (_offset + sizeof(uint32_t) + size > _buffer->size())
+            if (_offset + sizeof(uint32_t) + chunk_size > size())
                 return nullptr;
 
             _offset += sizeof(uint32_t); // move past size prefix
 
-            const uint8_t* ptr = _buffer->data() + _offset;
+            const uint8_t* ptr = data() + _offset;
 
-            _offset += size; // move past the chunk data
+            _offset += chunk_size; // move past the chunk data
 
-            out_size = size;
+            out_size = chunk_size;
             return ptr;
         }
 
+        // Raw bytes without a size prefix, for encodings that keep sizes in a header.
+        void write_bytes(const void* data, uint32_t size) {
+            check_writable();
+            _buffer->push_back_range(reinterpret_cast<const uint8_t*>(data), size);
+            _offset += size;
+        }
+
+        // Returns nullptr if not enough data
+        const uint8_t* read_bytes(uint32_t count) {
+            if (_offset + count > size())
+                return nullptr;
+
+            const uint8_t* ptr = data() + _offset;
+            _offset += count;
+            return ptr;
+        }
+
+        template <typename T>
+        void write_value(const T& value) {
+            write_bytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void read_value(T& value) {
+            const uint8_t* data = read_bytes(sizeof(T));
+            if (!data) {
+                throw std::out_of_range("Snapshot too short");
+            }
+            std::memcpy(&value, data, sizeof(T));
+        }
+
         void rewind() { _offset = 0; }
-        void seek(size_t offset) { _offset = (offset <= _buffer->size()) ? offset : _buffer->size(); }
+        // Drops the contents but keeps the buffer, so refilling does not allocate.
+        void clear() { check_writable(); _buffer->clear(); _offset = 0; }
+        void seek(size_t offset) { _offset = (offset <= size()) ? offset : size(); }
         size_t tell() const { return _offset; }
+        bool read_only() const { return _buffer == nullptr; }
 
-        const uint8_t* data() { return _buffer->data(); }
-        size_t size() const { return _buffer->size(); }
+        const uint8_t* data() const { return _buffer ? _buffer->data() : _view; }
+        size_t size() const { return _buffer ? _buffer->size() : _view_size; }
     };
 
-    // SparseSet manages a collection of entities and their associated data.
+    // SparseIndex is the id bookkeeping shared by SparseSet and SoASparseSet.
     // It uses a signed integer type for IDs, with -1 representing an invalid ID.
-    // Active entities are stored contiguously at the beginning of the dense vector.
-    // Removed IDs are stored in free_ids for reuse.
-    template <typename Q, typename T>
-    class SparseSet {
-        static_assert(std::is_integral_v<Q>, "DS::SparseSet<Q, T> requires Q to be an integral type");
-        static_assert(std::is_signed_v<Q>, "DS::SparseSet<Q, T> requires Q to be signed because -1 is used as INVALID_ID");
-        static_assert(std::is_trivially_copyable_v<T>, "DS::SparseSet<Q, T> requires T to be trivially copyable");
-
-        Vec<T> _dense;       // Stores the actual data.
-
-        Vec<Q> _sparse;      // Maps entity ID to its index in the dense vector.
+    // Active entities are stored contiguously at the beginning of the dense range.
+    // Removed IDs are stored in free_ids for reuse, the generation of an ID
+    // counts how often it has been removed so stale references can be told apart.
+    // The sets own the dense values and pass in how to push, pop and swap them,
+    // so both keep the same ordering and snapshot layout.
+    template <typename Q>
+    class SparseIndex {
+        static_assert(std::is_integral_v<Q>, "DS::SparseIndex<Q> requires Q to be an integral type");
+        static_assert(std::is_signed_v<Q>, "DS::SparseIndex<Q> requires Q to be signed because -1 is used as INVALID_ID");
+
+        Vec<Q> _sparse;      // Maps entity ID to its dense index.
         Vec<Q> _entities;    // Maps dense index back to its entity ID.
         Vec<Q> _free_ids;    // List of IDs available for reuse.
+        Vec<uint16_t> _generations; // Maps entity ID to its generation.
+        // One past the highest generation ever handed out per ID. Not part of
+        // save/load, so ids reused after rolling back still get a fresh generation.
+        Vec<uint16_t> _issued_generations;
 
         Q _next_id = 0;      // Next new ID to assign.
         Q _active_count = 0; // Number of active (enabled) entities.
 
-        // Swap the entries at two indices in the _dense vector (and update the mapping).
-        void swap_dense(Q index1, Q index2) {
-            std::swap(_dense[index1], _dense[index2]);
+        // Gives a slot a generation no earlier handle to it can carry.
+        void issue_generation(Q id) {
+            while (static_cast<uint32_t>(id) >= _issued_generations.size()) {
+                _issued_generations.push_back(0);
+            }
+            if (_generations[id] < _issued_generations[id]) {
+                _generations[id] = _issued_generations[id];
+            }
+            _issued_generations[id] = _generations[id] + 1;
+        }
+
+        // Swap the entries at two dense indices (and update the mapping).
+        template <typename SwapValues>
+        void swap_dense(Q index1, Q index2, SwapValues& swap_values) {
+            swap_values(index1, index2);
             std::swap(_entities[index1], _entities[index2]);
             _sparse[_entities[index1]] = index1;
             _sparse[_entities[index2]] = index2;
@@ -229,13 +657,10 @@ namespace GekkoDS {
             return is_valid(id) && (_sparse[id] < _active_count);
         }
 
-        // Returns true if the set contains the given entity (i.e. if it is valid).
-        bool contains(Q id) const {
-            return is_valid(id);
-        }
-
-        // Inserts a new element; new elements start as active.
-        Q insert(const T& value) {
+        // Picks an id, has push_values append its values and moves them into the
+        // active region; new elements start as active.
+        template <typename PushValues, typename SwapValues>
+        Q insert(PushValues push_values, SwapValues swap_values) {
             Q id;
             if (!_free_ids.empty()) {
                 id = _free_ids.back();
@@ -252,23 +677,27 @@ namespace GekkoDS {
             // Ensure the sparse vector is large enough.
             while (static_cast<uint32_t>(id) >= _sparse.size()) {
                 _sparse.push_back(INVALID_ID);
+                _generations.push_back(0);
             }
 
+            issue_generation(id);
+
             // Map the new entity to its dense index.
-            _sparse[id] = _dense.size();
-            _dense.push_back(value);
+            _sparse[id] = _entities.size();
+            push_values();
             _entities.push_back(id);
 
             // Swap the new element into the active region.
             if (_sparse[id] != _active_count) {
-                swap_dense(_sparse[id], _active_count);
+                swap_dense(_sparse[id], _active_count, swap_values);
             }
             _active_count++;
             return id;
         }
 
-        // Removes an entity from the set.
-        void remove(Q id) {
+        // Moves the entity to the last dense index, then has pop_values drop it.
+        template <typename PopValues, typename SwapValues>
+        void remove(Q id, PopValues pop_values, SwapValues swap_values) {
             if (!is_valid(id)) {
                 return;
             }
@@ -278,78 +707,86 @@ namespace GekkoDS {
                 Q index = _sparse[id];
                 Q last_active = _active_count - 1;
                 if (index != last_active) {
-                    swap_dense(index, last_active);
+                    swap_dense(index, last_active, swap_values);
                 }
                 _active_count--;
             }
 
             // Now the element is in the disabled region. Swap with last and pop.
             Q index = _sparse[id];
-            Q last_index = _dense.size() - 1;
+            Q last_index = _entities.size() - 1;
 
             if (index != last_index) {
-                swap_dense(index, last_index);
+                swap_dense(index, last_index, swap_values);
             }
 
-            _dense.pop_back();
+            pop_values();
             _entities.pop_back();
 
             _sparse[id] = INVALID_ID;
+            _generations[id]++;
 
             _free_ids.push_back(id);
         }
 
         // Disables an active entity
-        void disable(Q id) {
+        template <typename SwapValues>
+        void disable(Q id, SwapValues swap_values) {
             if (is_valid(id) && is_enabled(id)) {
                 Q index = _sparse[id];
                 Q last_active = _active_count - 1;
-                swap_dense(index, last_active);
+                swap_dense(index, last_active, swap_values);
                 _active_count--;
             }
         }
 
         // Enables a disabled entity
-        void enable(Q id) {
+        template <typename SwapValues>
+        void enable(Q id, SwapValues swap_values) {
             if (is_valid(id) && !is_enabled(id)) {
                 Q index = _sparse[id];
-                swap_dense(index, _active_count);
+                swap_dense(index, _active_count, swap_values);
                 _active_count++;
             }
         }
 
-        // Retrieves an entity by its ID.
-        T& get(Q id) {
-            if (!is_valid(id)) {
-                throw std::out_of_range("Invalid ID");
-            }
-            return _dense[_sparse[id]];
+        // Dense index of an ID that is known to be valid.
+        Q index_unchecked(Q id) const { return _sparse[id]; }
+
+        // Generation of an ID that has been allocated at least once.
+        uint16_t generation(Q id) const { return _generations[id]; }
+
+        // True if the ID is valid and has not been removed since the generation was read.
+        bool is_current(Q id, uint16_t generation) const {
+            return is_valid(id) && _generations[id] == generation;
         }
 
-        const T& get(Q id) const {
-            if (!is_valid(id)) {
-                throw std::out_of_range("Invalid ID");
-            }
-            return _dense[_sparse[id]];
+        void set_allocator(Allocator* allocator) {
+            _sparse.set_allocator(allocator);
+            _entities.set_allocator(allocator);
+            _free_ids.set_allocator(allocator);
+            _generations.set_allocator(allocator);
+            _issued_generations.set_allocator(allocator);
         }
 
-        // Clears all entities.
         void clear() {
-            _dense.clear();
             _entities.clear();
             _sparse.clear();
             _free_ids.clear();
+            _generations.clear();
+            _issued_generations.clear();
             _next_id = 0;
             _active_count = 0;
         }
 
+        // Written ahead of the dense values of the owning set.
         void save(MemStream& stream) {
             stream.write_chunk(&_active_count, sizeof(Q));
             stream.write_chunk(&_next_id, sizeof(Q));
-            save_vec(_free_ids,stream);
+            save_vec(_free_ids, stream);
+            save_vec(_generations, stream);
             save_vec(_sparse, stream);
             save_vec(_entities, stream);
-            save_vec(_dense, stream);
         }
 
         void load(MemStream& stream) {
@@ -362,39 +799,361 @@ namespace GekkoDS {
             std::memcpy(&_next_id, data, out_size);
             // load the vecs
             load_vec(_free_ids, stream);
+            load_vec(_generations, stream);
             load_vec(_sparse, stream);
             load_vec(_entities, stream);
+        }
+
+        // Compact encoding: one fixed header with every count, then the live elements only.
+        // The owning set writes its dense values right after.
+        void save_compact(MemStream& stream) const {
+            stream.write_value(_active_count);
+            stream.write_value(_next_id);
+            stream.write_value(_free_ids.size());
+            stream.write_value(_sparse.size());
+            stream.write_value(_entities.size());
+            write_elements(_free_ids, stream);
+            write_elements(_generations, stream);
+            write_elements(_sparse, stream);
+            write_elements(_entities, stream);
+        }
+
+        // Returns the number of dense values that follow.
+        uint32_t load_compact(MemStream& stream) {
+            uint32_t free_count = 0, id_count = 0, dense_count = 0;
+            stream.read_value(_active_count);
+            stream.read_value(_next_id);
+            stream.read_value(free_count);
+            stream.read_value(id_count);
+            stream.read_value(dense_count);
+            read_elements(_free_ids, free_count, stream);
+            read_elements(_generations, id_count, stream);
+            read_elements(_sparse, id_count, stream);
+            read_elements(_entities, dense_count, stream);
+            return dense_count;
+        }
+
+        // Returns the total number of entities (active(enabled) + active(disabled)).
+        uint32_t size() const { return _entities.size(); }
+
+        // Returns the number of active (enabled) entities.
+        uint32_t active_size() const { return _active_count; }
+
+        // Returns the number of active (disabled) entities.
+        uint32_t disabled_size() const { return _entities.size() - _active_count; }
+
+        // Returns the entity ID for a given dense index.
+        Q entity_id(uint32_t dense_index) const { return _entities[dense_index]; }
+
+        // Reusable ids and the next new id, which decide the ids handed out next.
+        const Vec<Q>& free_ids() const { return _free_ids; }
+        Q next_id() const { return _next_id; }
+    };
+
+    // SparseSet manages a collection of entities and their associated data,
+    // one value per entity in a dense vector ordered by a SparseIndex.
+    template <typename Q, typename T>
+    class SparseSet {
+        static_assert(std::is_trivially_copyable_v<T>, "DS::SparseSet<Q, T> requires T to be trivially copyable");
+
+        Vec<T> _dense;         // Stores the actual data.
+        SparseIndex<Q> _index; // Maps entity IDs to dense indices.
+
+        auto swap_values() {
+            return [this](Q index1, Q index2) { std::swap(_dense[index1], _dense[index2]); };
+        }
+
+    public:
+        static constexpr Q INVALID_ID = SparseIndex<Q>::INVALID_ID;
+
+        // Checks if the given id is valid (allocated and not removed).
+        bool is_valid(Q id) const { return _index.is_valid(id); }
+
+        bool is_enabled(Q id) const { return _index.is_enabled(id); }
+
+        // Returns true if the set contains the given entity (i.e. if it is valid).
+        bool contains(Q id) const { return _index.is_valid(id); }
+
+        // Inserts a new element; new elements start as active.
+        Q insert(const T& value) {
+            return _index.insert([&] { _dense.push_back(value); }, swap_values());
+        }
+
+        // Removes an entity from the set.
+        void remove(Q id) {
+            _index.remove(id, [this] { _dense.pop_back(); }, swap_values());
+        }
+
+        // Disables an active entity
+        void disable(Q id) { _index.disable(id, swap_values()); }
+
+        // Enables a disabled entity
+        void enable(Q id) { _index.enable(id, swap_values()); }
+
+        // Retrieves an entity by its ID.
+        T& get(Q id) {
+            if (!is_valid(id)) {
+                throw std::out_of_range("Invalid ID");
+            }
+            return _dense[_index.index_unchecked(id)];
+        }
+
+        const T& get(Q id) const {
+            if (!is_valid(id)) {
+                throw std::out_of_range("Invalid ID");
+            }
+            return _dense[_index.index_unchecked(id)];
+        }
+
+        // Retrieves an entity without validating the ID, for IDs that are known to be valid.
+        T& get_unchecked(Q id) { return _dense[_index.index_unchecked(id)]; }
+        const T& get_unchecked(Q id) const { return _dense[_index.index_unchecked(id)]; }
+
+        // Generation of an ID that has been allocated at least once.
+        uint16_t generation(Q id) const { return _index.generation(id); }
+
+        // True if the ID is valid and has not been removed since the generation was read.
+        bool is_current(Q id, uint16_t generation) const { return _index.is_current(id, generation); }
+
+        void set_allocator(Allocator* allocator) {
+            _dense.set_allocator(allocator);
+            _index.set_allocator(allocator);
+        }
+
+        // Clears all entities.
+        void clear() {
+            _dense.clear();
+            _index.clear();
+        }
+
+        void save(MemStream& stream) {
+            _index.save(stream);
+            save_vec(_dense, stream);
+        }
+
+        void load(MemStream& stream) {
+            _index.load(stream);
             load_vec(_dense, stream);
         }
 
+        // Compact encoding, see SparseIndex::save_compact.
+        void save_compact(MemStream& stream) const {
+            _index.save_compact(stream);
+            write_elements(_dense, stream);
+        }
+
+        void load_compact(MemStream& stream) {
+            const uint32_t dense_count = _index.load_compact(stream);
+            read_elements(_dense, dense_count, stream);
+        }
+
         void print_kv() const {
             for (uint32_t i = 0; i < size(); ++i) {
-                Q id = _entities[i];
+                Q id = _index.entity_id(i);
                 const T& value = _dense[i];
                 std::cout << "ID: " << id << ", Value: " << value << "\n";
             }
         }
 
         // Returns the total number of entities (active(enabled) + active(disabled)).
-        uint32_t size() const { return static_cast<Q>(_dense.size()); }
+        uint32_t size() const { return _index.size(); }
 
         // Returns the number of active (enabled) entities.
-        uint32_t active_size() const { return _active_count; }
+        uint32_t active_size() const { return _index.active_size(); }
 
         // Returns the number of active (disabled) entities.
-        uint32_t disabled_size() const { return static_cast<Q>(_dense.size()) - _active_count; }
+        uint32_t disabled_size() const { return _index.disabled_size(); }
 
         // Iterators over active entities.
         T* begin() { return _dense.begin(); }
-        T* end() { return _dense.begin() + _active_count; }
+        T* end() { return _dense.begin() + active_size(); }
 
         const T* begin() const { return _dense.begin(); }
-        const T* end() const { return _dense.begin() + _active_count; }
+        const T* end() const { return _dense.begin() + active_size(); }
 
         const T* end_set() const { return _dense.begin() + size(); }
 
         // Returns the entity ID for a given dense index.
-        Q entity_id(uint32_t dense_index) const { return _entities[dense_index]; }
+        Q entity_id(uint32_t dense_index) const { return _index.entity_id(dense_index); }
+
+        // Reusable ids and the next new id, which decide the ids handed out next.
+        const Vec<Q>& free_ids() const { return _index.free_ids(); }
+        Q next_id() const { return _index.next_id(); }
+    };
+
+    // Structure-of-arrays SparseSet. Every value type is kept in its own dense column,
+    // all columns share one SparseIndex and follow the same ordering rules
+    // as SparseSet: active entities first, disabled ones after.
+    // A loop over one column only streams the bytes of that column.
+    template <typename Q, typename... Ts>
+    class SoASparseSet {
+        static_assert(sizeof...(Ts) > 0, "DS::SoASparseSet<Q, Ts...> requires at least one column");
+        static_assert((std::is_trivially_copyable_v<Ts> && ...), "DS::SoASparseSet<Q, Ts...> requires trivially copyable columns");
+
+        using Columns = std::index_sequence_for<Ts...>;
+
+        std::tuple<Vec<Ts>...> _columns; // One dense vector per value type.
+        SparseIndex<Q> _index;           // Maps entity IDs to dense indices.
+
+        template <size_t... Is>
+        void swap_columns(Q index1, Q index2, std::index_sequence<Is...>) {
+            (std::swap(std::get<Is>(_columns)[index1], std::get<Is>(_columns)[index2]), ...);
+        }
+
+        template <size_t... Is>
+        void push_columns(std::index_sequence<Is...>, const Ts&... values) {
+            (std::get<Is>(_columns).push_back(values), ...);
+        }
+
+        template <size_t... Is>
+        void pop_columns(std::index_sequence<Is...>) {
+            (std::get<Is>(_columns).pop_back(), ...);
+        }
+
+        template <size_t... Is>
+        void clear_columns(std::index_sequence<Is...>) {
+            (std::get<Is>(_columns).clear(), ...);
+        }
+
+        template <size_t... Is>
+        void set_column_allocator(Allocator* allocator, std::index_sequence<Is...>) {
+            (std::get<Is>(_columns).set_allocator(allocator), ...);
+        }
+
+        template <size_t... Is>
+        void save_columns(MemStream& stream, std::index_sequence<Is...>) {
+            (save_vec(std::get<Is>(_columns), stream), ...);
+        }
+
+        template <size_t... Is>
+        void load_columns(MemStream& stream, std::index_sequence<Is...>) {
+            (load_vec(std::get<Is>(_columns), stream), ...);
+        }
+
+        template <size_t... Is>
+        void write_columns(MemStream& stream, std::index_sequence<Is...>) const {
+            (write_elements(std::get<Is>(_columns), stream), ...);
+        }
+
+        template <size_t... Is>
+        void read_columns(MemStream& stream, uint32_t count, std::index_sequence<Is...>) {
+            (read_elements(std::get<Is>(_columns), count, stream), ...);
+        }
+
+        auto swap_values() {
+            return [this](Q index1, Q index2) { swap_columns(index1, index2, Columns{}); };
+        }
+
+    public:
+        static constexpr Q INVALID_ID = SparseIndex<Q>::INVALID_ID;
+
+        template <size_t I>
+        using column_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        bool is_valid(Q id) const { return _index.is_valid(id); }
+        bool is_enabled(Q id) const { return _index.is_enabled(id); }
+        bool contains(Q id) const { return _index.is_valid(id); }
+
+        // Inserts a new element, one value per column; new elements start as active.
+        Q insert(const Ts&... values) {
+            return _index.insert([&] { push_columns(Columns{}, values...); }, swap_values());
+        }
+
+        void remove(Q id) {
+            _index.remove(id, [this] { pop_columns(Columns{}); }, swap_values());
+        }
+
+        void disable(Q id) { _index.disable(id, swap_values()); }
+        void enable(Q id) { _index.enable(id, swap_values()); }
+
+        // Dense index of an entity, the same in every column.
+        uint32_t index_of(Q id) const {
+            if (!is_valid(id)) {
+                throw std::out_of_range("Invalid ID");
+            }
+            return static_cast<uint32_t>(_index.index_unchecked(id));
+        }
+
+        // Dense index of an ID that is known to be valid.
+        uint32_t index_unchecked(Q id) const {
+            return static_cast<uint32_t>(_index.index_unchecked(id));
+        }
+
+        template <size_t I>
+        column_type<I>& get(Q id) {
+            return std::get<I>(_columns)[index_of(id)];
+        }
+
+        template <size_t I>
+        const column_type<I>& get(Q id) const {
+            return std::get<I>(_columns)[index_of(id)];
+        }
+
+        template <size_t I>
+        column_type<I>& get_unchecked(Q id) {
+            return std::get<I>(_columns)[index_unchecked(id)];
+        }
+
+        template <size_t I>
+        const column_type<I>& get_unchecked(Q id) const {
+            return std::get<I>(_columns)[index_unchecked(id)];
+        }
+
+        uint16_t generation(Q id) const { return _index.generation(id); }
+
+        bool is_current(Q id, uint16_t generation) const { return _index.is_current(id, generation); }
+
+        // Dense column, the first active_size() entries are the active entities.
+        template <size_t I>
+        Vec<column_type<I>>& column() {
+            return std::get<I>(_columns);
+        }
+
+        template <size_t I>
+        const Vec<column_type<I>>& column() const {
+            return std::get<I>(_columns);
+        }
+
+        void set_allocator(Allocator* allocator) {
+            set_column_allocator(allocator, Columns{});
+            _index.set_allocator(allocator);
+        }
+
+        void clear() {
+            clear_columns(Columns{});
+            _index.clear();
+        }
+
+        void save(MemStream& stream) {
+            _index.save(stream);
+            save_columns(stream, Columns{});
+        }
+
+        void load(MemStream& stream) {
+            _index.load(stream);
+            load_columns(stream, Columns{});
+        }
+
+        // Compact encoding, see SparseIndex::save_compact.
+        void save_compact(MemStream& stream) const {
+            _index.save_compact(stream);
+            write_columns(stream, Columns{});
+        }
+
+        void load_compact(MemStream& stream) {
+            const uint32_t dense_count = _index.load_compact(stream);
+            read_columns(stream, dense_count, Columns{});
+        }
+
+        uint32_t size() const { return _index.size(); }
+        uint32_t active_size() const { return _index.active_size(); }
+        uint32_t disabled_size() const { return _index.disabled_size(); }
+
+        Q entity_id(uint32_t dense_index) const { return _index.entity_id(dense_index); }
+
+        // Reusable ids and the next new id, which decide the ids handed out next.
+        const Vec<Q>& free_ids() const { return _index.free_ids(); }
+        Q next_id() const { return _index.next_id(); }
     };
 
     template <typename T>
@@ -411,7 +1170,165 @@ namespace GekkoDS {
         std::memcpy(&vec._size, data, out_size);
         // load _data and _capacity
         data = stream.read_chunk(out_size);
+        if (out_size == 0) return;
         vec.ensure_capacity(out_size / sizeof(T));
         std::memcpy(vec._data, data, out_size);
     }
+
+    // Live elements only, the count is stored by the caller.
+    template <typename T>
+    void write_elements(const Vec<T>& vec, MemStream& stream) {
+        stream.write_bytes(vec.begin(), vec.size() * sizeof(T));
+    }
+
+    template <typename T>
+    void read_elements(Vec<T>& vec, uint32_t count, MemStream& stream) {
+        // an empty vec may have no storage to copy into
+        if (count == 0) {
+            vec.clear();
+            return;
+        }
+        const uint8_t* data = stream.read_bytes(count * sizeof(T));
+        if (!data) {
+            throw std::out_of_range("Snapshot too short");
+        }
+        vec.resize(count);
+        std::memcpy(vec.data(), data, count * sizeof(T));
+    }
+
+    // Compact counterpart of save_vec, writes the size and the live elements only.
+    template <typename T>
+    void save_vec_compact(const Vec<T>& vec, MemStream& stream) {
+        stream.write_value(vec.size());
+        write_elements(vec, stream);
+    }
+
+    template <typename T>
+    void load_vec_compact(Vec<T>& vec, MemStream& stream) {
+        uint32_t count = 0;
+        stream.read_value(count);
+        read_elements(vec, count, stream);
+    }
+
+    // Array of T borrowed from a serialized buffer. Elements come back by value,
+    // the buffer gives no alignment guarantee.
+    template <typename T>
+    class PackedSpan {
+        static_assert(std::is_trivially_copyable_v<T>, "DS::PackedSpan<T> requires T to be trivially copyable");
+
+        const uint8_t* _data = nullptr;
+        uint32_t _size = 0;
+
+    public:
+        class iterator {
+            const uint8_t* _at;
+
+        public:
+            explicit iterator(const uint8_t* at) : _at(at) {}
+
+            T operator*() const {
+                T value;
+                std::memcpy(&value, _at, sizeof(T));
+                return value;
+            }
+
+            iterator& operator++() { _at += sizeof(T); return *this; }
+            bool operator!=(const iterator& other) const { return _at != other._at; }
+        };
+
+        PackedSpan() = default;
+        PackedSpan(const uint8_t* data, uint32_t size) : _data(data), _size(size) {}
+
+        T operator[](uint32_t index) const {
+            T value;
+            std::memcpy(&value, _data + size_t(index) * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        uint32_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        const uint8_t* data() const { return _data; }
+
+        iterator begin() const { return iterator(_data); }
+        iterator end() const { return iterator(_data + size_t(_size) * sizeof(T)); }
+    };
+
+    // Borrowing counterpart of read_elements.
+    template <typename T>
+    PackedSpan<T> view_elements(uint32_t count, MemStream& stream) {
+        const uint64_t bytes = uint64_t(count) * sizeof(T);
+        if (bytes > stream.size() - stream.tell()) {
+            throw std::out_of_range("Snapshot too short");
+        }
+        return PackedSpan<T>(stream.read_bytes(static_cast<uint32_t>(bytes)), count);
+    }
+
+    // Read-only view of a set written by save_compact, every array is borrowed
+    // from the stream. CompactSetView<Q, T> reads a SparseSet<Q, T>,
+    // CompactSetView<Q, Ts...> a SoASparseSet<Q, Ts...> with the same columns.
+    template <typename Q, typename... Ts>
+    class CompactSetView {
+        static_assert(std::is_integral_v<Q> && std::is_signed_v<Q>, "DS::CompactSetView<Q, Ts...> requires a signed integral Q");
+
+        PackedSpan<Q> _sparse;
+        PackedSpan<Q> _entities;
+        std::tuple<PackedSpan<Ts>...> _columns;
+        uint32_t _active_count = 0;
+
+        template <size_t... Is>
+        void view_columns(MemStream& stream, uint32_t count, std::index_sequence<Is...>) {
+            ((std::get<Is>(_columns) = view_elements<Ts>(count, stream)), ...);
+        }
+
+    public:
+        static constexpr Q INVALID_ID = -1;
+
+        template <size_t I>
+        using column_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        // Checks the id mapping once, so lookups afterwards can trust it.
+        // Throws std::out_of_range if the stream ends early or the mapping points outside the set.
+        void view_compact(MemStream& stream) {
+            Q active_count = 0, next_id = 0;
+            uint32_t free_count = 0, id_count = 0, dense_count = 0;
+            stream.read_value(active_count);
+            stream.read_value(next_id);
+            stream.read_value(free_count);
+            stream.read_value(id_count);
+            stream.read_value(dense_count);
+            view_elements<Q>(free_count, stream);
+            view_elements<uint16_t>(id_count, stream);
+            _sparse = view_elements<Q>(id_count, stream);
+            _entities = view_elements<Q>(dense_count, stream);
+            view_columns(stream, dense_count, std::index_sequence_for<Ts...>{});
+
+            if (active_count < 0 || static_cast<uint32_t>(active_count) > dense_count) {
+                throw std::out_of_range("Snapshot corrupt");
+            }
+            _active_count = static_cast<uint32_t>(active_count);
+            for (Q index : _sparse) {
+                if (index != INVALID_ID && (index < 0 || static_cast<uint32_t>(index) >= dense_count)) {
+                    throw std::out_of_range("Snapshot corrupt");
+                }
+            }
+        }
+
+        bool contains(Q id) const {
+            return id >= 0 && static_cast<uint32_t>(id) < _sparse.size() && _sparse[id] != INVALID_ID;
+        }
+
+        // Dense index of an id, INVALID_ID if the set does not hold it.
+        Q dense_index(Q id) const {
+            return contains(id) ? _sparse[id] : INVALID_ID;
+        }
+
+        uint32_t size() const { return _entities.size(); }
+        uint32_t active_size() const { return _active_count; }
+
+        const PackedSpan<Q>& entities() const { return _entities; }
+        Q entity_id(uint32_t dense_index) const { return _entities[dense_index]; }
+
+        template <size_t I>
+        const PackedSpan<column_type<I>>& column() const { return std::get<I>(_columns); }
+    };
 } // namespace Gekko::DS
\ No newline at end of file
@@ -1,16 +1,51 @@
 #pragma once
 
+#include <cstdio>
+#include <memory>
+
 #include "gekko_ds.h"
 #include "gekko_shapes.h"
 #include "gekko_debug_draw.h"
 
 namespace GekkoPhysics {
+	// Ids of bodies, groups, shapes and tree nodes. The compact 16 bit default
+	// caps each kind at 32767, define GEKKO_LARGE_IDS for 32 bit ids in large worlds.
+	// The define has to match between the library and everything that links it,
+	// GekkoPhysics.props sets it for both. Everything below lives in an inline
+	// namespace named after the width, so a mismatch fails to link instead of
+	// reading every layout wrong at runtime.
+#ifdef GEKKO_LARGE_IDS
+inline namespace Ids32 {
+	using Identifier = int32_t;
+#else
+inline namespace Ids16 {
 	using Identifier = int16_t;
+#endif
 	using namespace GekkoDS;
 	using namespace GekkoMath;
 
 	static const Identifier INVALID_ID = -1;
 
+	// Identifier plus the generation of its slot, returned when bodies, groups
+	// and shapes are created. Removing the entity, or loading a state in which the
+	// slot holds a different one, makes the handle stale even after the id is reused.
+	// Converts to a plain Identifier, which skips the generation check.
+	// Generations depend on the rollbacks a world has been through, so they
+	// are not simulation state and StateHash and BodyHash leave them out.
+	template <typename Tag>
+	struct Handle {
+		Identifier id = INVALID_ID;
+		uint16_t generation = 0;
+
+		operator Identifier() const { return id; }
+		bool operator==(const Handle& other) const { return id == other.id && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	using BodyHandle = Handle<struct BodyTag>;
+	using ShapeGroupHandle = Handle<struct ShapeGroupTag>;
+	using ShapeHandle = Handle<struct ShapeTag>;
+
 	struct Shape {
 		Identifier shape_type_id = INVALID_ID;
 		enum Type : uint8_t {
@@ -23,27 +58,75 @@ namespace GekkoPhysics {
 
 	struct ShapeGroup {
 		Identifier owner_body = INVALID_ID;
-		Identifier link_shapes = INVALID_ID;
+		// range of this group's shapes in the world's packed shape list
+		uint32_t shape_start = 0;
+		uint32_t shape_count = 0;
 		uint32_t layer = 0, mask = 0;
 		bool is_trigger = false;
 	};
 
-	struct Body {
-		Vec3 position;
-		Vec3 velocity;
-		Vec3 acceleration;
+	// Awake dynamic bodies joined by solvable contacts. Rebuilt every step,
+	// the ranges index into World::GetIslandBody and World::GetIslandContact.
+	struct Island {
+		// lowest body id in the island
+		Identifier root = INVALID_ID;
+		uint32_t body_start = 0;
+		uint32_t body_count = 0;
+		uint32_t contact_start = 0;
+		uint32_t contact_count = 0;
+		// position iterations the solver needed last step
+		uint8_t iterations = 0;
+	};
+
+	// Wall clock time of each Update stage in nanoseconds, filled when profiling is on.
+	struct StepProfile {
+		uint64_t integrate = 0;
+		uint64_t transform = 0;
+		uint64_t broadphase = 0;
+		uint64_t narrowphase = 0;
+		uint64_t islands = 0;
+		uint64_t solve = 0;
+		uint64_t sleep = 0;
+		uint64_t total = 0;
+	};
 
-		Mat3 rotation;
+	// Body fields the hot loops do not stream. Position, velocity, acceleration
+	// and rotation each live in their own column of World's body set.
+	struct BodyInfo {
+		// range of this body's groups in the world's packed group list
+		uint32_t group_start = 0;
+		uint32_t group_count = 0;
 
-		Identifier link_shape_groups = INVALID_ID;
+		// Consecutive frames spent below the sleep velocity.
+		uint16_t idle_frames = 0;
 
 		bool is_static = false;
 	};
 
-	struct Link {
-		static const uint8_t NUM_LINKS = 8;
-		Identifier children[NUM_LINKS];
-		void Reset();
+	// References into the body columns, returned by World::EditBody and World::GetBody.
+	// Creating, removing, waking or sleeping bodies invalidates them.
+	struct BodyRef {
+		Vec3& position;
+		Vec3& velocity;
+		Vec3& acceleration;
+		Mat3& rotation;
+		bool& is_static;
+	};
+
+	// Reference to the writable fields of a shape group, returned by
+	// World::EditShapeGroup. Adding or removing shape groups invalidates it.
+	struct ShapeGroupRef {
+		uint32_t& layer;
+		uint32_t& mask;
+		bool& is_trigger;
+	};
+
+	struct ConstBodyRef {
+		const Vec3& position;
+		const Vec3& velocity;
+		const Vec3& acceleration;
+		const Mat3& rotation;
+		const bool& is_static;
 	};
 
 	struct ContactPair {
@@ -54,36 +137,385 @@ namespace GekkoPhysics {
 		Vec3 normal;
 		Vec3 point;
 		Unit depth;
+		// Total position correction applied along the normal this frame.
+		// Carried over between frames to warm start the solver.
+		Unit correction { 0 };
 		bool is_trigger = false;
+		// Fills what would be padding, so copies and snapshots carry no
+		// uninitialized bytes and equal contacts compare equal byte for byte.
+		uint8_t reserved[3] = {};
+	};
+
+	struct GroupAABB {
+		Identifier group_id = INVALID_ID;
+		AABB aabb;
+	};
+
+	// Candidate pair produced by the broadphase.
+	// a and b index into the GroupAABB list that was passed in, with a < b.
+	struct GroupPair {
+		uint32_t a = 0;
+		uint32_t b = 0;
+	};
+
+	// Encoding used by World::Save. Chunked size prefixes every field and writes
+	// every container up to its capacity. Compact packs the scalars into one
+	// header and writes live elements only. Both start with a magic word and the
+	// snapshot version, World::Load reads either of the same version.
+	enum class SnapshotFormat : uint8_t {
+		Chunked,
+		Compact,
+	};
+
+	// Sort-and-sweep broadphase along a single axis.
+	// The sorted entry list persists between updates so that insertion sort
+	// only has to fix up the few entries that moved past each other. When the
+	// axis changes or most entries are new the list is sorted from scratch.
+	// Entries are ordered by (min, group_id) which is a total order, so the
+	// emitted pairs only depend on the input and never on previous frames.
+	class SweepAndPrune {
+		struct Entry {
+			Identifier group_id = INVALID_ID;
+			uint32_t index = 0;
+			Unit min, max;
+		};
+
+		Vec<Entry> _entries;
+		// group id -> index into the current GroupAABB list (UINT32_MAX if absent)
+		Vec<uint32_t> _lookup;
+		uint8_t _axis = 0;
+
+		uint8_t SelectAxis(const Vec<GroupAABB>& aabbs) const;
+		// Returns the number of entries appended for groups not seen last update.
+		uint32_t SyncEntries(const Vec<GroupAABB>& aabbs);
+		void InsertionSort();
+		void FullSort();
+
+	public:
+		void Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs);
+		void Clear();
+		void SetAllocator(Allocator* allocator);
+
+		uint8_t GetAxis() const;
+	};
+
+	// Tree nodes are indexed with 32 bits whatever the width of Identifier,
+	// a tree over N groups holds 2N - 1 nodes.
+	using TreeNodeId = int32_t;
+	static const TreeNodeId INVALID_NODE = -1;
+
+	struct TreeNode {
+		AABB aabb;
+		TreeNodeId parent = INVALID_NODE;
+		TreeNodeId left = INVALID_NODE;
+		TreeNodeId right = INVALID_NODE;
+		// only set on leaves, widened so the node has no padding with either id width
+		int32_t group_id = INVALID_ID;
+		// leaves have height 0
+		int16_t height = 0;
+		int16_t reserved = 0;
+
+		bool IsLeaf() const { return left == INVALID_NODE; }
+	};
+
+	// Incremental dynamic AABB tree with one proxy per shape group.
+	// Leaves store an enlarged ("fat") AABB and are only re-inserted once the
+	// tight AABB escapes it, so idle groups cost a single containment test.
+	// All state lives in trivially copyable containers and is part of Save/Load,
+	// which keeps the traversal order (and thus the pair order) deterministic.
+	class DynamicTree {
+		SparseSet<TreeNodeId, TreeNode> _nodes;
+		// group id -> leaf node id
+		Vec<TreeNodeId> _proxies;
+		TreeNodeId _root = INVALID_NODE;
+		Unit _margin = Unit{1} / Unit{10};
+
+		// scratch, rebuilt every update
+		Vec<uint32_t> _lookup;
+		Vec<TreeNodeId> _stack;
+		Vec<Identifier> _hits;
+
+		AABB Fatten(const AABB& aabb) const;
+		void InsertLeaf(TreeNodeId leaf);
+		void RemoveLeaf(TreeNodeId leaf);
+		TreeNodeId Balance(TreeNodeId index);
+		void Refit(TreeNodeId index);
+
+	public:
+		// Returns the leaf node id of the new proxy, INVALID_NODE for a negative group id.
+		TreeNodeId CreateProxy(Identifier group_id, const AABB& aabb);
+		void DestroyProxy(Identifier group_id);
+		// Returns true when the proxy had to be re-inserted.
+		bool MoveProxy(Identifier group_id, const AABB& aabb);
+		bool HasProxy(Identifier group_id) const;
+		const AABB& GetFatAABB(Identifier group_id) const;
+
+		// Appends the group id of every proxy whose fat AABB overlaps the given AABB.
+		void Query(const AABB& aabb, Vec<Identifier>& out_groups);
+
+		void Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs);
+		void Clear();
+		void SetAllocator(Allocator* allocator);
+
+		void SetMargin(const Unit& margin);
+		uint32_t GetProxyCount() const;
+		int16_t GetHeight() const;
+
+		void Save(MemStream& stream, SnapshotFormat format = SnapshotFormat::Chunked);
+		void Load(MemStream& stream, SnapshotFormat format = SnapshotFormat::Chunked);
+	};
+
+	// Uniform hashed grid broadphase for bounded worlds with similarly sized groups.
+	// Every group is binned into each cell its AABB touches and only groups that
+	// share a cell are tested. A pair touching several shared cells is only
+	// reported from the lowest one. A group covering more than MAX_GROUP_CELLS
+	// cells, such as a floor or a fast body, skips the grid and is tested against
+	// every other group instead. Buffers are reused, so once the grid has seen
+	// its largest frame it no longer allocates.
+	class HashGrid {
+	public:
+		static const uint32_t MAX_GROUP_CELLS = 64;
+
+	private:
+		struct CellEntry {
+			int32_t x = 0, y = 0, z = 0;
+			uint32_t index = 0;
+			uint32_t bucket = 0;
+		};
+
+		struct CellRange {
+			int32_t min[3];
+			int32_t max[3];
+		};
+
+		Unit _cell_size { 4 };
+
+		// scratch, rebuilt every update
+		Vec<CellEntry> _entries;
+		Vec<CellEntry> _sorted;
+		Vec<CellRange> _ranges;
+		Vec<uint32_t> _bucket_starts;
+		// groups over MAX_GROUP_CELLS, in index order, and a flag per group
+		Vec<uint32_t> _overflow;
+		Vec<uint8_t> _is_overflow;
+
+		CellRange ComputeRange(const AABB& aabb) const;
+		static uint32_t HashCell(int32_t x, int32_t y, int32_t z);
+
+	public:
+		void Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs);
+		void Clear();
+		void SetAllocator(Allocator* allocator);
+
+		// Throws std::invalid_argument for a size of zero or less.
+		void SetCellSize(const Unit& cell_size);
+		const Unit& GetCellSize() const;
+
+		void Save(MemStream& stream, SnapshotFormat format = SnapshotFormat::Chunked);
+		void Load(MemStream& stream, SnapshotFormat format = SnapshotFormat::Chunked);
+	};
+
+	enum class BroadphaseType : uint8_t {
+		SweepAndPrune,
+		DynamicTree,
+		Grid,
 	};
 
 	class World {
-		SparseSet<Identifier, Body> _bodies;
+	public:
+		static const uint8_t MAX_THREADS = 8;
+
+	private:
+		// Reads the compact snapshot layout in place.
+		friend class WorldView;
+
+		// Bodies are stored column by column, integration only touches the motion columns.
+		enum BodyColumn : size_t { Position, Velocity, Acceleration, Rotation, Info };
+		SoASparseSet<Identifier, Vec3, Vec3, Vec3, Mat3, BodyInfo> _bodies;
 		SparseSet<Identifier, ShapeGroup> _shape_groups;
 		SparseSet<Identifier, Shape> _shapes;
 
-		SparseSet<Identifier, Link> _links;
+		// Groups of every body and shapes of every group, stored back to back.
+		// BodyInfo and ShapeGroup hold (start, count) ranges into these lists.
+		// Edits stay inside one range: a range that grows moves to the end of
+		// the list and removals close the gap within the range, both leave holes
+		// that the next Update compacts away in one pass.
+		// Shapes are copied next to their id so walking a group never touches _shapes.
+		struct GroupShape {
+			Identifier shape_id = INVALID_ID;
+			Shape shape;
+		};
+
+		Vec<Identifier> _body_groups;
+		Vec<GroupShape> _group_shapes;
+		uint32_t _body_group_holes = 0;
+		uint32_t _group_shape_holes = 0;
+		// Owner starting at each slot, scratch of the compaction.
+		Vec<uint32_t> _range_owners;
 
 		SparseSet<Identifier, OBB> _obbs;
 		SparseSet<Identifier, Sphere> _spheres;
 		SparseSet<Identifier, Capsule> _capsules;
 
 		Vec<ContactPair> _contacts;
+		// Narrowphase output of worker threads, merged into _contacts in chunk order.
+		// Slot 0 is unused, the calling thread writes to _contacts directly.
+		Vec<ContactPair> _thread_contacts[MAX_THREADS];
+		uint8_t _thread_count = 1;
+		// Narrowphase threads, defined in gekko_physics.cpp so the header needs no
+		// threading headers. Created by the first SetThreadCount above one.
+		class WorkerPool;
+		std::unique_ptr<WorkerPool> _workers;
+
+		// Shape pairs of the narrowphase, sorted into one bucket per shape type pair
+		// so every collision routine runs over a contiguous list of its own pairs.
+		// Contacts are emitted afterwards in the order the pairs were gathered.
+		enum PairBucket : uint8_t {
+			OBBOBB,
+			OBBSphere,
+			OBBCapsule,
+			SphereSphere,
+			SphereCapsule,
+			CapsuleCapsule,
+			PairBucketCount,
+		};
+
+		struct ShapePairCandidate {
+			Identifier body_a = INVALID_ID;
+			Identifier body_b = INVALID_ID;
+			Identifier shape_a = INVALID_ID;
+			Identifier shape_b = INVALID_ID;
+			bool is_trigger = false;
+			// neither body can move, the cached contact is replayed instead
+			bool resting = false;
+		};
+
+		// Typed shape ids in the argument order of the bucket's Algo routine.
+		struct ShapePairTask {
+			uint32_t candidate = 0;
+			Identifier first = INVALID_ID;
+			Identifier second = INVALID_ID;
+			// the routine's normal points from second to first of the candidate
+			bool flip = false;
+		};
+
+		struct NarrowphaseBatch {
+			Vec<ShapePairCandidate> candidates;
+			Vec<CollisionResult> results;
+			Vec<ShapePairTask> buckets[PairBucketCount];
+		};
+
+		// One batch per narrowphase thread.
+		NarrowphaseBatch _batches[MAX_THREADS];
+		// Last frame's solved contacts sorted by shape pair, used for warm starting.
+		Vec<ContactPair> _contact_cache;
+
+		// Full compact snapshot built by SaveDelta and LoadDelta, kept between calls.
+		Vec<uint8_t> _delta_target;
+
+		// Compact snapshots store the world as these sections, each with the
+		// version it had when saved. Changing a section stamps it with a new
+		// version from a clock that never runs backwards, so a section whose
+		// version matches a keyframe is unchanged since that keyframe.
+		enum SnapshotSection : uint8_t {
+			SectionSettings,
+			SectionBodies,
+			SectionBodyGroups,
+			SectionShapeGroups,
+			SectionGroupShapes,
+			SectionShapes,
+			SectionOBBs,
+			SectionSpheres,
+			SectionCapsules,
+			// contact cache and broadphase, rewritten every frame
+			SectionContacts,
+			SectionCount,
+		};
+
+		uint64_t _section_versions[SectionCount] = {};
+		uint64_t _version_clock = 0;
+
+		// StateHash caches. Bodies are kept as a sum of per-body hashes so single
+		// bodies can be swapped out, the other sections by the version they had.
+		Vec<uint64_t> _body_hashes;
+		Vec<Identifier> _hash_dirty_bodies;
+		Vec<uint8_t> _hash_dirty_flags;
+		uint64_t _body_hash_sum = 0;
+		bool _hash_all_bodies = true;
+		uint64_t _section_hashes[SectionCount] = {};
+		uint64_t _hashed_versions[SectionCount] = {};
+		bool _section_hashed[SectionCount] = {};
 
 		Vec3 _origin, _up;
 		Unit _update_rate { 60 };
 		uint8_t _solver_iterations = 4;
 
-		struct GroupAABB {
-			Identifier group_id = INVALID_ID;
+		// Sleeping bodies are disabled in _bodies, which keeps them out of integration.
+		bool _sleep_enabled = true;
+		Unit _sleep_velocity = Unit{1} / Unit{20};
+		uint16_t _sleep_frames = 60;
+
+		// Union-find over body ids, rebuilt every step after collision detection.
+		// Bodies and contact indices are stored grouped by island. Before that,
+		// WakeTouchedBodies borrows them to join sleeping bodies into islands.
+		Vec<Identifier> _island_parent;
+		Vec<uint32_t> _island_index;
+		Vec<Island> _islands;
+		Vec<Identifier> _island_bodies;
+		Vec<uint32_t> _island_contacts;
+
+		Vec<GroupAABB> _group_aabbs;
+		Vec<GroupPair> _group_pairs;
+		BroadphaseType _broadphase = BroadphaseType::SweepAndPrune;
+		SweepAndPrune _sweep_and_prune;
+		DynamicTree _tree;
+		HashGrid _grid;
+
+		// Static groups are kept out of the per-frame broadphase. They live in
+		// their own tree that is only rebuilt when static geometry changes.
+		Vec<GroupAABB> _static_aabbs;
+		Vec<uint32_t> _static_lookup;
+		Vec<Identifier> _static_hits;
+		DynamicTree _static_tree;
+		bool _statics_dirty = true;
+		// Static groups whose shapes were handed out for writing, refit one by
+		// one by the next Update instead of rebuilding the whole static tree.
+		// The flags are indexed by group id and keep every group queued once.
+		Vec<Identifier> _touched_static_groups;
+		Vec<uint8_t> _touched_static_flags;
+		// Group that owns each typed shape, indexed by Shape::Type and then by
+		// shape_type_id. Derived from the groups, rebuilt on Load.
+		Vec<Identifier> _typed_shape_groups[Shape::Capsule + 1];
+
+		// World-space shapes written once per frame by the transform pass.
+		// _shape_cache is indexed by shape id, the typed arrays by shape_type_id.
+		struct ShapeCacheEntry {
 			AABB aabb;
+			bool valid = false;
 		};
 
-		Vec<GroupAABB> _group_aabbs;
+		Vec<ShapeCacheEntry> _shape_cache;
+		Vec<OBB> _world_obbs;
+		Vec<Sphere> _world_spheres;
+		Vec<Capsule> _world_capsules;
+
+		// Scratch memory for buffers that only live through one Update.
+		FrameArena _frame_arena;
+
+		bool _profiling = false;
+		uint64_t _profile_mark = 0;
+		StepProfile _profile;
 
 		DebugDraw* _debug_draw = nullptr;
 
 	public:
+		World();
+		// Every container of the world draws from the given allocator, which must
+		// outlive the world. A LinearAllocator lets the whole world be dropped at once.
+		explicit World(Allocator* allocator);
+		World(World&& other) noexcept;
+		World& operator=(World&& other) noexcept;
+		~World();
 
 		void SetOrientation(const Vec3& up);
 		void SetOrigin(const Vec3& origin);
@@ -91,50 +523,351 @@ namespace GekkoPhysics {
 		// Sets the expected number of iterations per second (default 60)
 		void SetUpdateRate(const Unit& rate);
 		void SetSolverIterations(uint8_t iterations);
+		// Number of threads used by the narrowphase, clamped to [1, MAX_THREADS].
+		// The contact list is identical for every thread count.
+		void SetThreadCount(uint8_t count);
+		// Bodies whose velocity stays below the threshold for the given number of
+		// frames fall asleep together with every body they touch.
+		void SetSleeping(bool enabled);
+		void SetSleepThreshold(const Unit& velocity, uint16_t frames);
+		void WakeBody(Identifier id);
+		void WakeBody(BodyHandle handle);
+		bool IsAwake(Identifier id) const;
+		bool IsAwake(BodyHandle handle) const;
+		// Selects the broadphase backend (default SweepAndPrune).
+		// A non-zero size sets the fat AABB margin for DynamicTree
+		// and the cell size for Grid.
+		void SetBroadphase(BroadphaseType type, const Unit& size = Unit{0});
 
-		Identifier CreateBody();
+		BodyHandle CreateBody();
 		// Adds a shapegroup to a body.
-		// Currently limited to NUM_LINK shapegroups per body.
-		// And NUM_LINK shapes per shapegroup.
-		Identifier AddShapeGroup(Identifier body_id);
+		ShapeGroupHandle AddShapeGroup(Identifier body_id);
+		ShapeGroupHandle AddShapeGroup(BodyHandle body);
 		// Returns a shape containing the selected shape.
-		Identifier AddShape(Identifier shape_group_id, Shape::Type shape_type);
+		// The type of a shape is fixed once it has been added.
+		ShapeHandle AddShape(Identifier shape_group_id, Shape::Type shape_type);
+		ShapeHandle AddShape(ShapeGroupHandle shape_group, Shape::Type shape_type);
 
 		void RemoveBody(Identifier id);
+		void RemoveBody(BodyHandle body);
 		void RemoveShapeGroup(Identifier body_id, Identifier shape_group_id);
+		void RemoveShapeGroup(BodyHandle body, ShapeGroupHandle shape_group);
 		void RemoveShape(Identifier shape_group_id, Identifier shape_id);
+		void RemoveShape(ShapeGroupHandle shape_group, ShapeHandle shape);
 
-		void Save(MemStream& stream);
+		// False once the entity behind the handle has been removed.
+		bool IsValid(BodyHandle handle) const;
+		bool IsValid(ShapeGroupHandle handle) const;
+		bool IsValid(ShapeHandle handle) const;
+
+		void Save(MemStream& stream, SnapshotFormat format = SnapshotFormat::Chunked);
+		// Detects the format on its own. Throws std::out_of_range without touching
+		// the world for a snapshot of another version or identifier width.
 		void Load(MemStream& stream);
 
+		// Writes only the byte ranges in which the current compact snapshot differs
+		// from base, which must itself be a compact snapshot.
+		void SaveDelta(MemStream& base, MemStream& stream);
+		// Applies a delta written by SaveDelta on top of the same base.
+		// Throws std::out_of_range if the delta does not belong to base.
+		void LoadDelta(MemStream& base, MemStream& stream);
+
+		// Writes a snapshot that refers to the sections of key for every container
+		// not changed since key was saved or loaded by this world. Key must be a
+		// compact snapshot; anything else makes every section inline.
+		void SaveIncremental(MemStream& key, MemStream& stream);
+		// Restores a snapshot written by SaveIncremental against the same key.
+		// Throws std::out_of_range if the snapshot does not belong to key.
+		void LoadIncremental(MemStream& key, MemStream& stream);
+
+		// 64-bit digest of the simulation state for desync checks. Equal on every
+		// platform, thread count and rollback history for equal states, handle
+		// generations are not part of it. Only awake dynamic bodies,
+		// bodies touched since the last call and changed containers are rehashed.
+		// Storage order inside the containers and the broadphase are not covered.
+		uint64_t StateHash();
+		// Hash of a single body, to find which bodies differ after a desync.
+		// Throws std::out_of_range for an invalid id or stale handle.
+		uint64_t BodyHash(Identifier id) const;
+		uint64_t BodyHash(BodyHandle handle) const;
+		// Walks every body in storage order, which changes when bodies are
+		// added, removed or fall asleep. Throws std::out_of_range past the end.
+		uint32_t GetBodyCount() const;
+		Identifier GetBodyId(uint32_t index) const;
+
 		void Update();
 
-		Body& GetBody(Identifier id);
-		ShapeGroup& GetShapeGroup(Identifier id);
-		Shape& GetShape(Identifier id);
+		// EditBody is for writes, it wakes a sleeping body and on a static body
+		// queues its groups for a refit instead. GetBody only reads.
+		// EditShapeGroup and mutable shape access only wake the owning body,
+		// or refit the owning group if that body is static. Either way
+		// SaveIncremental writes the container out again. Const access marks
+		// nothing. Handle overloads throw std::out_of_range on a stale handle.
+		BodyRef EditBody(Identifier id);
+		BodyRef EditBody(BodyHandle handle);
+		ConstBodyRef GetBody(Identifier id) const;
+		ConstBodyRef GetBody(BodyHandle handle) const;
+		ShapeGroupRef EditShapeGroup(Identifier id);
+		ShapeGroupRef EditShapeGroup(ShapeGroupHandle handle);
+		const ShapeGroup& GetShapeGroup(Identifier id) const;
+		const ShapeGroup& GetShapeGroup(ShapeGroupHandle handle) const;
+		const Shape& GetShape(Identifier id) const;
+		const Shape& GetShape(ShapeHandle handle) const;
 		Sphere& GetSphere(Identifier id);
 		OBB& GetOBB(Identifier id);
 		Capsule& GetCapsule(Identifier id);
+		const Sphere& GetSphere(Identifier id) const;
+		const OBB& GetOBB(Identifier id) const;
+		const Capsule& GetCapsule(Identifier id) const;
 		const Vec<ContactPair>& GetContacts() const;
+		// Islands solved in the last Update, ordered by root id.
+		const Vec<Island>& GetIslands() const;
+		Identifier GetIslandBody(const Island& island, uint32_t index) const;
+		const ContactPair& GetIslandContact(const Island& island, uint32_t index) const;
+		// World-space AABB of a shape as of the last Update.
+		const AABB& GetShapeAABB(Identifier shape_id) const;
+
+		// Times every stage of Update, off by default.
+		void SetProfiling(bool enabled);
+		const StepProfile& GetProfile() const;
 
 		void SetDebugDraw(DebugDraw* dd);
 		void DrawDebug() const;
 
 	private:
-		// Create a link between entites.
-		Identifier CreateLink();
+		void SetAllocator(Allocator* allocator);
+		void LoadCompact(MemStream& stream);
+		void LoadChunked(MemStream& stream);
+		void WriteSection(SnapshotSection section, MemStream& stream);
+		void ReadSection(SnapshotSection section, MemStream& stream);
+		void MarkDirty(SnapshotSection section);
+		// Queues a body for rehashing by the next StateHash.
+		void MarkBodyHash(Identifier id);
+		void UpdateBodyHash(Identifier id, uint64_t hash);
+		uint64_t HashBodyAt(uint32_t index) const;
+		uint64_t SectionHash(SnapshotSection section) const;
+
+		// Identifier behind a handle, INVALID_ID if the handle is stale.
+		Identifier Resolve(BodyHandle handle) const;
+		Identifier Resolve(ShapeGroupHandle handle) const;
+		Identifier Resolve(ShapeHandle handle) const;
+
+		// Body access without the wake and static bookkeeping of EditBody,
+		// and without validating the id. Only for ids known to be alive.
+		BodyRef AccessBody(Identifier id);
+		ConstBodyRef ReadBody(Identifier id) const;
 
 		// Transform body-local shapes to world space.
-		Sphere WorldSphere(const Sphere& local, const Body& body) const;
-		OBB WorldOBB(const OBB& local, const Body& body) const;
-		Capsule WorldCapsule(const Capsule& local, const Body& body) const;
+		Sphere WorldSphere(const Sphere& local, const ConstBodyRef& body) const;
+		OBB WorldOBB(const OBB& local, const ConstBodyRef& body) const;
+		Capsule WorldCapsule(const Capsule& local, const ConstBodyRef& body) const;
 
 		void CheckCollisions();
+		void ProfileStage(uint64_t& stage_ns);
+		void BuildIslands();
 		void ResolveCollisions();
+		void SolveIsland(Island& island, const Unit* targets);
+		void WarmStartContacts();
+		void StoreContactCache();
+		const ContactPair* FindCachedContact(Identifier shape_a, Identifier shape_b) const;
 		void BuildGroupAABBs();
-		bool BroadphaseFilter(const ShapeGroup& group_a, const ShapeGroup& group_b, const AABB& aabb_a, const AABB& aabb_b) const;
-		void NarrowphaseGroupPair(const ShapeGroup& group_a, const ShapeGroup& group_b);
-		CollisionResult CollideShapes(const Shape& a, const Body& body_a, const Shape& b, const Body& body_b) const;
-		AABB ComputeShapeGroupAABB(const ShapeGroup& group, const Body& body) const;
+		void RebuildStaticGroups(bool wake_bodies);
+		bool IsStaticGroupCached(Identifier group_id) const;
+		void MarkStaticsDirty(Identifier body_id);
+		// Wakes the owner of a group, or queues the group for a refit if the owner is static.
+		void TouchShapeGroup(Identifier group_id);
+		void TouchShape(Shape::Type type, Identifier shape_type_id);
+		void SetShapeGroupOwner(const Shape& shape, Identifier group_id);
+		void RebuildShapeGroupOwners();
+		void CompactBodyGroups();
+		void CompactGroupShapes();
+		void RefitTouchedStaticGroups();
+		void CollideStaticGroups();
+		bool CachedShapeGroupAABB(const ShapeGroup& group, AABB& out_aabb) const;
+		// Wakes every sleeping island that an awake body touches.
+		void WakeTouchedBodies();
+		void WakeBodiesOverlapping(const AABB& aabb);
+		void WakeAllBodies();
+		void UpdateSleep();
+		Identifier FindIsland(Identifier body_id);
+		bool IsMoving(Identifier body_id) const;
+		bool IsSolvable(const ContactPair& contact) const;
+		bool IsSleeping(Identifier body_id) const;
+		bool BroadphaseFilter(const ShapeGroup& group_a, const ShapeGroup& group_b) const;
+		void NarrowphasePairs(uint32_t begin, uint32_t end, NarrowphaseBatch& batch, Vec<ContactPair>& out_contacts) const;
+		void NarrowphasePairsParallel(uint8_t thread_count);
+		static void NarrowphaseJob(void* world, uint32_t slot, uint32_t count);
+		void GatherShapePairs(const ShapeGroup& group_a, const ShapeGroup& group_b, NarrowphaseBatch& batch) const;
+		// Runs every bucket through its collision routine and emits the contacts in gather order.
+		void RunNarrowphaseBatch(NarrowphaseBatch& batch, Vec<ContactPair>& out_contacts) const;
+		// Writes the world-space shapes of a group to the cache and returns their union.
+		AABB TransformShapeGroup(const ShapeGroup& group, const ConstBodyRef& body);
+		bool IsShapeCached(Identifier shape_id) const;
+		void InvalidateShapeCache(Identifier shape_id);
+	};
+
+	// The last few world states for rollback, as compact snapshots in buffers
+	// that are reused frame after frame. Once every slot has held a snapshot of
+	// the usual size, Push and Restore no longer allocate.
+	class SnapshotRing {
+	public:
+		static constexpr uint32_t MAX_FRAMES = 32;
+
+		// Capacity is clamped to 1..MAX_FRAMES.
+		explicit SnapshotRing(uint32_t capacity = 8, Allocator* allocator = nullptr);
+
+		// Saves world as the newest frame, dropping the oldest once full.
+		// Returns the frame number, counted up from 0 by every Push.
+		uint32_t Push(World& world);
+
+		// Loads the state frames_back frames before the newest (0 is the newest)
+		// and drops every frame after it, so the next Push follows on from it.
+		// Throws std::out_of_range if that frame is no longer held.
+		void Restore(World& world, uint32_t frames_back = 0);
+
+		// Read-only stream over a held frame, e.g. for World::Load or SaveDelta.
+		// Throws std::out_of_range if that frame is no longer held.
+		MemStream Peek(uint32_t frame);
+		bool Contains(uint32_t frame) const;
+
+		uint32_t Size() const { return _count; }
+		uint32_t Capacity() const { return _capacity; }
+		// Frame number of the newest snapshot, only meaningful when Size() > 0.
+		uint32_t Newest() const { return _next_frame - 1; }
+
+	private:
+		uint32_t Slot(uint32_t frame) const { return frame % _capacity; }
+
+		Vec<uint8_t> _buffers[MAX_FRAMES];
+		uint32_t _capacity;
+		uint32_t _count = 0;
+		uint32_t _next_frame = 0;
+	};
+
+	// Read-only access to a compact snapshot without loading it into a World,
+	// e.g. for services that only look at body positions. Every container is
+	// borrowed from the snapshot bytes, nothing is allocated or copied, so the
+	// bytes have to outlive the view. Body spans are in dense order, awake
+	// bodies first. Contacts are those of the Update before the snapshot.
+	class WorldView {
+	public:
+		using BodySet = CompactSetView<Identifier, Vec3, Vec3, Vec3, Mat3, BodyInfo>;
+
+		// The whole stream has to be one compact snapshot, e.g. from Save,
+		// SnapshotRing::Peek or ReplayReader::Snapshot of a keyframe. Every
+		// section is bounds checked here. Throws std::out_of_range otherwise.
+		explicit WorldView(const MemStream& stream);
+
+		uint32_t BodyCount() const { return _bodies.size(); }
+		uint32_t AwakeBodyCount() const { return _bodies.active_size(); }
+		const PackedSpan<Identifier>& BodyIds() const { return _bodies.entities(); }
+		const PackedSpan<Vec3>& BodyPositions() const { return _bodies.column<World::Position>(); }
+		const PackedSpan<Vec3>& BodyVelocities() const { return _bodies.column<World::Velocity>(); }
+		const PackedSpan<Mat3>& BodyRotations() const { return _bodies.column<World::Rotation>(); }
+		const PackedSpan<BodyInfo>& BodyInfos() const { return _bodies.column<World::Info>(); }
+		// Index of a body into the spans above.
+		// Throws std::out_of_range for an invalid id.
+		uint32_t BodyIndex(Identifier id) const;
+
+		const BodySet& Bodies() const { return _bodies; }
+		const CompactSetView<Identifier, ShapeGroup>& ShapeGroups() const { return _shape_groups; }
+		const CompactSetView<Identifier, Shape>& Shapes() const { return _shapes; }
+		const CompactSetView<Identifier, OBB>& OBBs() const { return _obbs; }
+		const CompactSetView<Identifier, Sphere>& Spheres() const { return _spheres; }
+		const CompactSetView<Identifier, Capsule>& Capsules() const { return _capsules; }
+		const PackedSpan<ContactPair>& Contacts() const { return _contacts; }
+
+	private:
+		BodySet _bodies;
+		CompactSetView<Identifier, ShapeGroup> _shape_groups;
+		CompactSetView<Identifier, Shape> _shapes;
+		CompactSetView<Identifier, OBB> _obbs;
+		CompactSetView<Identifier, Sphere> _spheres;
+		CompactSetView<Identifier, Capsule> _capsules;
+		PackedSpan<ContactPair> _contacts;
+	};
+
+	// Index entry of one recorded frame, offsets count from the start of the file.
+	struct ReplayFrame {
+		uint64_t offset = 0;    // snapshot bytes of the frame
+		uint64_t hash = 0;      // StateHash of the recorded state
+		uint32_t size = 0;
+		uint32_t keyframe = 0;  // frame number of its keyframe, its own for keyframes
+	};
+
+	// Records a simulation into an append-only file. Every keyframe_interval
+	// frames a compact snapshot is stored, the frames in between as a delta
+	// against the last keyframe, so any frame is at most two loads away.
+	// Each record is a MemStream chunk padded to 8 bytes. Close appends the
+	// frame index that lets ReplayReader seek without touching the records.
+	class ReplayWriter {
+	public:
+		ReplayWriter() = default;
+		ReplayWriter(const ReplayWriter&) = delete;
+		ReplayWriter& operator=(const ReplayWriter&) = delete;
+		~ReplayWriter();
+
+		// Creates or truncates the file. Returns false if it cannot be opened.
+		bool Open(const char* path, uint32_t keyframe_interval = 60);
+		// Appends the state of world as the next frame.
+		// Returns false if no file is open or the write failed.
+		bool Record(World& world);
+		// Writes the frame index and closes the file. Returns false if no file
+		// is open or a write failed, the file is then only good for a scan.
+		bool Close();
+
+		bool IsOpen() const { return _file != nullptr; }
+		uint32_t FrameCount() const { return _frames.size(); }
+
+	private:
+		std::FILE* _file = nullptr;
+		uint32_t _keyframe_interval = 0;
+		uint64_t _file_size = 0;
+		Vec<uint8_t> _key;
+		Vec<uint8_t> _record;
+		Vec<ReplayFrame> _frames;
+	};
+
+	// Read-only replay file mapped into memory. Seeking only touches the pages
+	// of one keyframe and one delta, and keyframes load straight from the
+	// mapping. A file whose writer never closed it is indexed by hopping over
+	// the record headers, a torn last record is dropped.
+	class ReplayReader {
+	public:
+		ReplayReader() = default;
+		ReplayReader(const ReplayReader&) = delete;
+		ReplayReader& operator=(const ReplayReader&) = delete;
+		~ReplayReader();
+
+		// Returns false if the file cannot be mapped or is no replay.
+		bool Open(const char* path);
+		void Close();
+
+		bool IsOpen() const { return _data != nullptr; }
+		uint32_t FrameCount() const { return _frame_count; }
+		uint32_t KeyframeInterval() const { return _keyframe_interval; }
+
+		// Loads the recorded state of frame into world.
+		// Throws std::out_of_range for a frame outside the recording.
+		void Seek(World& world, uint32_t frame);
+		// Throws std::out_of_range for a frame outside the recording.
+		const ReplayFrame& GetFrame(uint32_t frame) const;
+		// Stream over the mapped snapshot bytes of a frame: a compact snapshot
+		// for keyframes, otherwise a delta against its keyframe.
+		// Throws std::out_of_range for a frame outside the recording.
+		MemStream Snapshot(uint32_t frame) const;
+
+	private:
+		bool ReadIndex();
+		void ScanRecords();
+
+		const uint8_t* _data = nullptr;
+		size_t _size = 0;
+		uint32_t _keyframe_interval = 0;
+		// Points into the mapping when the index is aligned, else at _scanned.
+		const ReplayFrame* _frames = nullptr;
+		uint32_t _frame_count = 0;
+		Vec<ReplayFrame> _scanned;
 	};
-}
\ No newline at end of file
+} // inline namespace Ids16 / Ids32
+}
@@ -0,0 +1,784 @@
+#include "gekko_physics.h"
+#include "algo.h"
+
+#include <algorithm>
+
+namespace GekkoPhysics {
+	static const uint32_t NO_INDEX = UINT32_MAX;
+	static const uint32_t MATCHED_INDEX = UINT32_MAX - 1;
+
+	static Unit AxisValue(const Vec3& v, uint8_t axis) {
+		switch (axis) {
+		case 0: return v.x;
+		case 1: return v.y;
+		default: return v.z;
+		}
+	}
+
+	void SweepAndPrune::Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs) {
+		const uint8_t axis = SelectAxis(aabbs);
+		const bool axis_changed = axis != _axis;
+		_axis = axis;
+		const uint32_t appended = SyncEntries(aabbs);
+
+		// entries sorted along another axis, or mostly new ones, are close to
+		// random and would take insertion sort quadratic time
+		if (axis_changed || appended > _entries.size() / 2) {
+			FullSort();
+		} else {
+			InsertionSort();
+		}
+
+		const uint32_t count = _entries.size();
+		for (uint32_t i = 0; i < count; i++) {
+			const Entry& entry_a = _entries[i];
+			const AABB& aabb_a = aabbs[entry_a.index].aabb;
+
+			for (uint32_t j = i + 1; j < count && _entries[j].min <= entry_a.max; j++) {
+				const Entry& entry_b = _entries[j];
+				if (!Algo::OverlapAABB(aabb_a, aabbs[entry_b.index].aabb)) continue;
+
+				// keep the lower dense index first so contact order of a/b stays stable
+				GroupPair pair;
+				pair.a = entry_a.index < entry_b.index ? entry_a.index : entry_b.index;
+				pair.b = entry_a.index < entry_b.index ? entry_b.index : entry_a.index;
+				out_pairs.push_back(pair);
+			}
+		}
+	}
+
+	void SweepAndPrune::Clear() {
+		_entries.clear();
+		_lookup.clear();
+		_axis = 0;
+	}
+
+	void SweepAndPrune::SetAllocator(Allocator* allocator) {
+		_entries.set_allocator(allocator);
+		_lookup.set_allocator(allocator);
+	}
+
+	uint8_t SweepAndPrune::GetAxis() const {
+		return _axis;
+	}
+
+	uint8_t SweepAndPrune::SelectAxis(const Vec<GroupAABB>& aabbs) const {
+		const uint32_t count = aabbs.size();
+		if (count < 2) return 0;
+
+		// Variance is computed on integers at 1/16 unit precision so that the
+		// sums can not overflow and the chosen axis is bit-exact on every platform.
+		int64_t sum[3] = { 0, 0, 0 };
+		for (uint32_t i = 0; i < count; i++) {
+			const AABB& aabb = aabbs[i].aabb;
+			for (uint8_t axis = 0; axis < 3; axis++) {
+				int64_t lo = AxisValue(aabb.min, axis).raw_value();
+				int64_t hi = AxisValue(aabb.max, axis).raw_value();
+				sum[axis] += (lo + hi) >> 13;
+			}
+		}
+
+		int64_t variance[3] = { 0, 0, 0 };
+		for (uint32_t i = 0; i < count; i++) {
+			const AABB& aabb = aabbs[i].aabb;
+			for (uint8_t axis = 0; axis < 3; axis++) {
+				int64_t lo = AxisValue(aabb.min, axis).raw_value();
+				int64_t hi = AxisValue(aabb.max, axis).raw_value();
+				int64_t delta = ((lo + hi) >> 13) - sum[axis] / count;
+				variance[axis] += delta * delta;
+			}
+		}
+
+		uint8_t best = 0;
+		for (uint8_t axis = 1; axis < 3; axis++) {
+			if (variance[axis] > variance[best]) best = axis;
+		}
+		return best;
+	}
+
+	uint32_t SweepAndPrune::SyncEntries(const Vec<GroupAABB>& aabbs) {
+		for (uint32_t i = 0; i < _lookup.size(); i++) {
+			_lookup[i] = NO_INDEX;
+		}
+
+		const uint32_t count = aabbs.size();
+		for (uint32_t i = 0; i < count; i++) {
+			const uint32_t id = static_cast<uint32_t>(aabbs[i].group_id);
+			while (id >= _lookup.size()) {
+				_lookup.push_back(NO_INDEX);
+			}
+			_lookup[id] = i;
+		}
+
+		// refresh surviving entries in place, dropping groups that are gone.
+		// the compaction is stable so the previous order is kept as a warm start.
+		uint32_t write = 0;
+		for (uint32_t i = 0; i < _entries.size(); i++) {
+			Entry entry = _entries[i];
+			const uint32_t id = static_cast<uint32_t>(entry.group_id);
+			if (id >= _lookup.size() || _lookup[id] >= MATCHED_INDEX) continue;
+
+			entry.index = _lookup[id];
+			entry.min = AxisValue(aabbs[entry.index].aabb.min, _axis);
+			entry.max = AxisValue(aabbs[entry.index].aabb.max, _axis);
+			_entries[write++] = entry;
+			_lookup[id] = MATCHED_INDEX;
+		}
+		_entries.resize(write);
+
+		// append groups that were not seen last update
+		const uint32_t kept = _entries.size();
+		for (uint32_t i = 0; i < count; i++) {
+			const uint32_t id = static_cast<uint32_t>(aabbs[i].group_id);
+			if (_lookup[id] == MATCHED_INDEX) continue;
+
+			Entry entry;
+			entry.group_id = aabbs[i].group_id;
+			entry.index = i;
+			entry.min = AxisValue(aabbs[i].aabb.min, _axis);
+			entry.max = AxisValue(aabbs[i].aabb.max, _axis);
+			_entries.push_back(entry);
+		}
+		return _entries.size() - kept;
+	}
+
+	static bool EntryLess(Unit min_a, Identifier group_a, Unit min_b, Identifier group_b) {
+		return min_a < min_b || (min_a == min_b && group_a < group_b);
+	}
+
+	void SweepAndPrune::InsertionSort() {
+		const uint32_t count = _entries.size();
+		for (uint32_t i = 1; i < count; i++) {
+			Entry entry = _entries[i];
+			uint32_t j = i;
+			while (j > 0) {
+				const Entry& prev = _entries[j - 1];
+				if (EntryLess(prev.min, prev.group_id, entry.min, entry.group_id)) break;
+				_entries[j] = prev;
+				j--;
+			}
+			_entries[j] = entry;
+		}
+	}
+
+	void SweepAndPrune::FullSort() {
+		// same total order as InsertionSort, so both give the same entry list
+		std::sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) {
+			return EntryLess(a.min, a.group_id, b.min, b.group_id);
+		});
+	}
+
+	static Unit Perimeter(const AABB& aabb) {
+		Vec3 size = aabb.max - aabb.min;
+		return (size.x + size.y + size.z) * Unit{2};
+	}
+
+	static bool ContainsAABB(const AABB& outer, const AABB& inner) {
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+			inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+	}
+
+	static int16_t MaxHeight(int16_t a, int16_t b) {
+		return a > b ? a : b;
+	}
+
+	TreeNodeId DynamicTree::CreateProxy(Identifier group_id, const AABB& aabb) {
+		if (group_id < 0) return INVALID_NODE;
+		if (HasProxy(group_id)) {
+			MoveProxy(group_id, aabb);
+			return _proxies[group_id];
+		}
+
+		TreeNode node;
+		node.aabb = Fatten(aabb);
+		node.group_id = group_id;
+		const TreeNodeId leaf = _nodes.insert(node);
+		if (leaf == INVALID_NODE) {
+			throw std::out_of_range("Tree node pool exhausted");
+		}
+
+		while (static_cast<uint32_t>(group_id) >= _proxies.size()) {
+			_proxies.push_back(INVALID_NODE);
+		}
+		_proxies[group_id] = leaf;
+
+		InsertLeaf(leaf);
+		return leaf;
+	}
+
+	void DynamicTree::DestroyProxy(Identifier group_id) {
+		if (!HasProxy(group_id)) return;
+
+		const TreeNodeId leaf = _proxies[group_id];
+		RemoveLeaf(leaf);
+		_nodes.remove(leaf);
+		_proxies[group_id] = INVALID_NODE;
+	}
+
+	bool DynamicTree::MoveProxy(Identifier group_id, const AABB& aabb) {
+		if (!HasProxy(group_id)) return false;
+
+		const TreeNodeId leaf = _proxies[group_id];
+		if (ContainsAABB(_nodes.get(leaf).aabb, aabb)) return false;
+
+		RemoveLeaf(leaf);
+		_nodes.get(leaf).aabb = Fatten(aabb);
+		InsertLeaf(leaf);
+		return true;
+	}
+
+	bool DynamicTree::HasProxy(Identifier group_id) const {
+		return group_id >= 0 &&
+			static_cast<uint32_t>(group_id) < _proxies.size() &&
+			_proxies[group_id] != INVALID_NODE;
+	}
+
+	const AABB& DynamicTree::GetFatAABB(Identifier group_id) const {
+		if (!HasProxy(group_id)) {
+			throw std::out_of_range("Invalid ID");
+		}
+		return _nodes.get(_proxies[group_id]).aabb;
+	}
+
+	void DynamicTree::Query(const AABB& aabb, Vec<Identifier>& out_groups) {
+		if (_root == INVALID_NODE) return;
+
+		_stack.clear();
+		_stack.push_back(_root);
+		while (!_stack.empty()) {
+			const TreeNodeId index = _stack.back();
+			_stack.pop_back();
+
+			const TreeNode& node = _nodes.get(index);
+			if (!Algo::OverlapAABB(node.aabb, aabb)) continue;
+
+			if (node.IsLeaf()) {
+				out_groups.push_back(static_cast<Identifier>(node.group_id));
+			} else {
+				_stack.push_back(node.right);
+				_stack.push_back(node.left);
+			}
+		}
+	}
+
+	void DynamicTree::Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs) {
+		const uint32_t count = aabbs.size();
+
+		for (uint32_t i = 0; i < _lookup.size(); i++) {
+			_lookup[i] = NO_INDEX;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			const GroupAABB& ga = aabbs[i];
+			if (HasProxy(ga.group_id)) {
+				MoveProxy(ga.group_id, ga.aabb);
+			} else {
+				CreateProxy(ga.group_id, ga.aabb);
+			}
+
+			const uint32_t id = static_cast<uint32_t>(ga.group_id);
+			while (id >= _lookup.size()) {
+				_lookup.push_back(NO_INDEX);
+			}
+			_lookup[id] = i;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			const AABB& aabb_a = aabbs[i].aabb;
+
+			// query on the tight box, leaves report on their fat box
+			_hits.clear();
+			Query(aabb_a, _hits);
+
+			for (uint32_t h = 0; h < _hits.size(); h++) {
+				const uint32_t id = static_cast<uint32_t>(_hits[h]);
+				if (id >= _lookup.size()) continue;
+				const uint32_t j = _lookup[id];
+				// each pair is reported by its lower index only
+				if (j == NO_INDEX || j <= i) continue;
+				if (!Algo::OverlapAABB(aabb_a, aabbs[j].aabb)) continue;
+
+				GroupPair pair;
+				pair.a = i;
+				pair.b = j;
+				out_pairs.push_back(pair);
+			}
+		}
+	}
+
+	void DynamicTree::Clear() {
+		_nodes.clear();
+		_proxies.clear();
+		_root = INVALID_NODE;
+	}
+
+	void DynamicTree::SetAllocator(Allocator* allocator) {
+		_nodes.set_allocator(allocator);
+		_proxies.set_allocator(allocator);
+		_lookup.set_allocator(allocator);
+		_stack.set_allocator(allocator);
+		_hits.set_allocator(allocator);
+	}
+
+	void DynamicTree::SetMargin(const Unit& margin) {
+		_margin = margin;
+	}
+
+	uint32_t DynamicTree::GetProxyCount() const {
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < _proxies.size(); i++) {
+			if (_proxies[i] != INVALID_NODE) count++;
+		}
+		return count;
+	}
+
+	int16_t DynamicTree::GetHeight() const {
+		if (_root == INVALID_NODE) return 0;
+		return _nodes.get(_root).height;
+	}
+
+	void DynamicTree::Save(MemStream& stream, SnapshotFormat format) {
+		if (format == SnapshotFormat::Compact) {
+			_nodes.save_compact(stream);
+			save_vec_compact(_proxies, stream);
+			stream.write_value(_root);
+			stream.write_value(_margin);
+			return;
+		}
+
+		_nodes.save(stream);
+		save_vec(_proxies, stream);
+		stream.write_chunk(&_root, sizeof(TreeNodeId));
+		stream.write_chunk(&_margin, sizeof(Unit));
+	}
+
+	void DynamicTree::Load(MemStream& stream, SnapshotFormat format) {
+		if (format == SnapshotFormat::Compact) {
+			_nodes.load_compact(stream);
+			load_vec_compact(_proxies, stream);
+			stream.read_value(_root);
+			stream.read_value(_margin);
+			return;
+		}
+
+		_nodes.load(stream);
+		load_vec(_proxies, stream);
+
+		uint32_t chunk_size = 0;
+		auto chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_root, chunk_data, chunk_size);
+
+		chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_margin, chunk_data, chunk_size);
+	}
+
+	AABB DynamicTree::Fatten(const AABB& aabb) const {
+		AABB fat;
+		fat.min = aabb.min - _margin;
+		fat.max = aabb.max + _margin;
+		return fat;
+	}
+
+	void DynamicTree::InsertLeaf(TreeNodeId leaf) {
+		if (_root == INVALID_NODE) {
+			_root = leaf;
+			_nodes.get(leaf).parent = INVALID_NODE;
+			return;
+		}
+
+		// find the best sibling using the perimeter heuristic
+		const AABB leaf_aabb = _nodes.get(leaf).aabb;
+		TreeNodeId index = _root;
+		while (!_nodes.get(index).IsLeaf()) {
+			const TreeNode& node = _nodes.get(index);
+			const TreeNode& left = _nodes.get(node.left);
+			const TreeNode& right = _nodes.get(node.right);
+
+			Unit area = Perimeter(node.aabb);
+			Unit combined_area = Perimeter(Algo::UnionAABB(node.aabb, leaf_aabb));
+
+			// cost of creating a new parent for this node and the new leaf
+			Unit cost = combined_area * Unit{2};
+			// minimum cost of pushing the leaf further down the tree
+			Unit inheritance_cost = (combined_area - area) * Unit{2};
+
+			Unit cost_left = Perimeter(Algo::UnionAABB(leaf_aabb, left.aabb)) + inheritance_cost;
+			if (!left.IsLeaf()) cost_left -= Perimeter(left.aabb);
+
+			Unit cost_right = Perimeter(Algo::UnionAABB(leaf_aabb, right.aabb)) + inheritance_cost;
+			if (!right.IsLeaf()) cost_right -= Perimeter(right.aabb);
+
+			if (cost < cost_left && cost < cost_right) break;
+
+			index = cost_left <= cost_right ? node.left : node.right;
+		}
+
+		const TreeNodeId sibling = index;
+		const TreeNodeId old_parent = _nodes.get(sibling).parent;
+
+		TreeNode parent_node;
+		parent_node.parent = old_parent;
+		parent_node.aabb = Algo::UnionAABB(leaf_aabb, _nodes.get(sibling).aabb);
+		parent_node.height = _nodes.get(sibling).height + 1;
+		parent_node.left = sibling;
+		parent_node.right = leaf;
+		// insert may move the dense storage, so no references are held across it
+		const TreeNodeId new_parent = _nodes.insert(parent_node);
+		if (new_parent == INVALID_NODE) {
+			throw std::out_of_range("Tree node pool exhausted");
+		}
+
+		if (old_parent != INVALID_NODE) {
+			TreeNode& old = _nodes.get(old_parent);
+			if (old.left == sibling) {
+				old.left = new_parent;
+			} else {
+				old.right = new_parent;
+			}
+		} else {
+			_root = new_parent;
+		}
+		_nodes.get(sibling).parent = new_parent;
+		_nodes.get(leaf).parent = new_parent;
+
+		Refit(new_parent);
+	}
+
+	void DynamicTree::RemoveLeaf(TreeNodeId leaf) {
+		if (leaf == _root) {
+			_root = INVALID_NODE;
+			return;
+		}
+
+		const TreeNodeId parent = _nodes.get(leaf).parent;
+		const TreeNode& parent_node = _nodes.get(parent);
+		const TreeNodeId grand_parent = parent_node.parent;
+		const TreeNodeId sibling = parent_node.left == leaf ? parent_node.right : parent_node.left;
+
+		if (grand_parent != INVALID_NODE) {
+			TreeNode& grand = _nodes.get(grand_parent);
+			if (grand.left == parent) {
+				grand.left = sibling;
+			} else {
+				grand.right = sibling;
+			}
+			_nodes.get(sibling).parent = grand_parent;
+			_nodes.remove(parent);
+
+			Refit(grand_parent);
+		} else {
+			_root = sibling;
+			_nodes.get(sibling).parent = INVALID_NODE;
+			_nodes.remove(parent);
+		}
+		_nodes.get(leaf).parent = INVALID_NODE;
+	}
+
+	void DynamicTree::Refit(TreeNodeId index) {
+		while (index != INVALID_NODE) {
+			index = Balance(index);
+
+			TreeNode& node = _nodes.get(index);
+			const TreeNode& left = _nodes.get(node.left);
+			const TreeNode& right = _nodes.get(node.right);
+
+			node.height = 1 + MaxHeight(left.height, right.height);
+			node.aabb = Algo::UnionAABB(left.aabb, right.aabb);
+
+			index = node.parent;
+		}
+	}
+
+	// Performs a left or right rotation if node A is imbalanced.
+	// Returns the new root of the subtree.
+	TreeNodeId DynamicTree::Balance(TreeNodeId index_a) {
+		TreeNode& a = _nodes.get(index_a);
+		if (a.IsLeaf() || a.height < 2) return index_a;
+
+		const TreeNodeId index_b = a.left;
+		const TreeNodeId index_c = a.right;
+		TreeNode& b = _nodes.get(index_b);
+		TreeNode& c = _nodes.get(index_c);
+
+		const int16_t balance = c.height - b.height;
+
+		// rotate C up
+		if (balance > 1) {
+			const TreeNodeId index_f = c.left;
+			const TreeNodeId index_g = c.right;
+			TreeNode& f = _nodes.get(index_f);
+			TreeNode& g = _nodes.get(index_g);
+
+			c.left = index_a;
+			c.parent = a.parent;
+			a.parent = index_c;
+
+			if (c.parent != INVALID_NODE) {
+				TreeNode& c_parent = _nodes.get(c.parent);
+				if (c_parent.left == index_a) {
+					c_parent.left = index_c;
+				} else {
+					c_parent.right = index_c;
+				}
+			} else {
+				_root = index_c;
+			}
+
+			if (f.height > g.height) {
+				c.right = index_f;
+				a.right = index_g;
+				g.parent = index_a;
+				a.aabb = Algo::UnionAABB(b.aabb, g.aabb);
+				c.aabb = Algo::UnionAABB(a.aabb, f.aabb);
+				a.height = 1 + MaxHeight(b.height, g.height);
+				c.height = 1 + MaxHeight(a.height, f.height);
+			} else {
+				c.right = index_g;
+				a.right = index_f;
+				f.parent = index_a;
+				a.aabb = Algo::UnionAABB(b.aabb, f.aabb);
+				c.aabb = Algo::UnionAABB(a.aabb, g.aabb);
+				a.height = 1 + MaxHeight(b.height, f.height);
+				c.height = 1 + MaxHeight(a.height, g.height);
+			}
+			return index_c;
+		}
+
+		// rotate B up
+		if (balance < -1) {
+			const TreeNodeId index_d = b.left;
+			const TreeNodeId index_e = b.right;
+			TreeNode& d = _nodes.get(index_d);
+			TreeNode& e = _nodes.get(index_e);
+
+			b.left = index_a;
+			b.parent = a.parent;
+			a.parent = index_b;
+
+			if (b.parent != INVALID_NODE) {
+				TreeNode& b_parent = _nodes.get(b.parent);
+				if (b_parent.left == index_a) {
+					b_parent.left = index_b;
+				} else {
+					b_parent.right = index_b;
+				}
+			} else {
+				_root = index_b;
+			}
+
+			if (d.height > e.height) {
+				b.right = index_d;
+				a.left = index_e;
+				e.parent = index_a;
+				a.aabb = Algo::UnionAABB(c.aabb, e.aabb);
+				b.aabb = Algo::UnionAABB(a.aabb, d.aabb);
+				a.height = 1 + MaxHeight(c.height, e.height);
+				b.height = 1 + MaxHeight(a.height, d.height);
+			} else {
+				b.right = index_e;
+				a.left = index_d;
+				d.parent = index_a;
+				a.aabb = Algo::UnionAABB(c.aabb, d.aabb);
+				b.aabb = Algo::UnionAABB(a.aabb, e.aabb);
+				a.height = 1 + MaxHeight(c.height, d.height);
+				b.height = 1 + MaxHeight(a.height, e.height);
+			}
+			return index_b;
+		}
+
+		return index_a;
+	}
+
+	// floor(value / cell) on raw fixed point values
+	static int32_t CellCoord(const Unit& value, const Unit& cell) {
+		int64_t raw = value.raw_value();
+		int64_t size = cell.raw_value();
+		int64_t coord = raw / size;
+		if (raw % size != 0 && raw < 0) coord--;
+		return static_cast<int32_t>(coord);
+	}
+
+	HashGrid::CellRange HashGrid::ComputeRange(const AABB& aabb) const {
+		CellRange range;
+		for (uint8_t axis = 0; axis < 3; axis++) {
+			range.min[axis] = CellCoord(AxisValue(aabb.min, axis), _cell_size);
+			range.max[axis] = CellCoord(AxisValue(aabb.max, axis), _cell_size);
+		}
+		return range;
+	}
+
+	uint32_t HashGrid::HashCell(int32_t x, int32_t y, int32_t z) {
+		return (static_cast<uint32_t>(x) * 73856093u) ^
+			(static_cast<uint32_t>(y) * 19349663u) ^
+			(static_cast<uint32_t>(z) * 83492791u);
+	}
+
+	void HashGrid::Update(const Vec<GroupAABB>& aabbs, Vec<GroupPair>& out_pairs) {
+		const uint32_t count = aabbs.size();
+
+		_entries.clear();
+		_overflow.clear();
+		_ranges.resize(count);
+		_is_overflow.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			const CellRange range = ComputeRange(aabbs[i].aabb);
+			_ranges[i] = range;
+
+			// cell counts in 64 bits, a range can reach INT32_MAX or span all of it.
+			// Each axis is checked alone first so the product cannot overflow.
+			int64_t extent[3];
+			bool overflow = false;
+			for (uint8_t axis = 0; axis < 3; axis++) {
+				extent[axis] = int64_t{ range.max[axis] } - range.min[axis] + 1;
+				overflow = overflow || extent[axis] > MAX_GROUP_CELLS;
+			}
+			overflow = overflow || extent[0] * extent[1] * extent[2] > MAX_GROUP_CELLS;
+			_is_overflow[i] = overflow;
+			if (overflow) {
+				_overflow.push_back(i);
+				continue;
+			}
+
+			for (int64_t dx = 0; dx < extent[0]; dx++) {
+				for (int64_t dy = 0; dy < extent[1]; dy++) {
+					for (int64_t dz = 0; dz < extent[2]; dz++) {
+						CellEntry entry;
+						entry.x = static_cast<int32_t>(range.min[0] + dx);
+						entry.y = static_cast<int32_t>(range.min[1] + dy);
+						entry.z = static_cast<int32_t>(range.min[2] + dz);
+						entry.index = i;
+						_entries.push_back(entry);
+					}
+				}
+			}
+		}
+
+		// each overflow group against every other, overflow pairs only from the lower index
+		for (uint32_t o = 0; o < _overflow.size(); o++) {
+			const uint32_t a = _overflow[o];
+			for (uint32_t i = 0; i < count; i++) {
+				if (i == a || (_is_overflow[i] && i < a)) continue;
+				if (!Algo::OverlapAABB(aabbs[a].aabb, aabbs[i].aabb)) continue;
+
+				GroupPair pair;
+				pair.a = a < i ? a : i;
+				pair.b = a < i ? i : a;
+				out_pairs.push_back(pair);
+			}
+		}
+
+		const uint32_t entry_count = _entries.size();
+		if (entry_count < 2) return;
+
+		// power of two bucket count with a load factor of at most one half
+		uint32_t bucket_count = 16;
+		while (bucket_count < entry_count * 2) {
+			bucket_count *= 2;
+		}
+		const uint32_t mask = bucket_count - 1;
+
+		// counting sort entries by bucket, stable so each bucket stays in index order
+		_bucket_starts.resize(bucket_count + 1);
+		for (uint32_t b = 0; b <= bucket_count; b++) {
+			_bucket_starts[b] = 0;
+		}
+		for (uint32_t e = 0; e < entry_count; e++) {
+			CellEntry& entry = _entries[e];
+			entry.bucket = HashCell(entry.x, entry.y, entry.z) & mask;
+			_bucket_starts[entry.bucket + 1]++;
+		}
+		for (uint32_t b = 0; b < bucket_count; b++) {
+			_bucket_starts[b + 1] += _bucket_starts[b];
+		}
+
+		_sorted.resize(entry_count);
+		for (uint32_t e = 0; e < entry_count; e++) {
+			const CellEntry& entry = _entries[e];
+			// bucket_starts[b] doubles as the write cursor and ends up at the bucket end
+			_sorted[_bucket_starts[entry.bucket]++] = entry;
+		}
+
+		// after the fill pass every start has moved to its bucket end
+		uint32_t begin = 0;
+		for (uint32_t b = 0; b < bucket_count; b++) {
+			const uint32_t end = _bucket_starts[b];
+			for (uint32_t p = begin; p < end; p++) {
+				const CellEntry& entry_a = _sorted[p];
+				const CellRange& range_a = _ranges[entry_a.index];
+
+				for (uint32_t q = p + 1; q < end; q++) {
+					const CellEntry& entry_b = _sorted[q];
+					// different cells that hashed to the same bucket
+					if (entry_a.x != entry_b.x || entry_a.y != entry_b.y || entry_a.z != entry_b.z) continue;
+
+					// only report from the lowest cell both groups share
+					const CellRange& range_b = _ranges[entry_b.index];
+					const int32_t first_x = range_a.min[0] > range_b.min[0] ? range_a.min[0] : range_b.min[0];
+					const int32_t first_y = range_a.min[1] > range_b.min[1] ? range_a.min[1] : range_b.min[1];
+					const int32_t first_z = range_a.min[2] > range_b.min[2] ? range_a.min[2] : range_b.min[2];
+					if (entry_a.x != first_x || entry_a.y != first_y || entry_a.z != first_z) continue;
+
+					if (!Algo::OverlapAABB(aabbs[entry_a.index].aabb, aabbs[entry_b.index].aabb)) continue;
+
+					GroupPair pair;
+					pair.a = entry_a.index < entry_b.index ? entry_a.index : entry_b.index;
+					pair.b = entry_a.index < entry_b.index ? entry_b.index : entry_a.index;
+					out_pairs.push_back(pair);
+				}
+			}
+			begin = end;
+		}
+	}
+
+	void HashGrid::Clear() {
+		_entries.clear();
+		_sorted.clear();
+		_ranges.clear();
+		_bucket_starts.clear();
+		_overflow.clear();
+		_is_overflow.clear();
+	}
+
+	void HashGrid::SetAllocator(Allocator* allocator) {
+		_entries.set_allocator(allocator);
+		_sorted.set_allocator(allocator);
+		_ranges.set_allocator(allocator);
+		_bucket_starts.set_allocator(allocator);
+		_overflow.set_allocator(allocator);
+		_is_overflow.set_allocator(allocator);
+	}
+
+	void HashGrid::SetCellSize(const Unit& cell_size) {
+		if (cell_size <= Unit{0}) {
+			throw std::invalid_argument("Cell size must be positive");
+		}
+		_cell_size = cell_size;
+	}
+
+	const Unit& HashGrid::GetCellSize() const {
+		return _cell_size;
+	}
+
+	void HashGrid::Save(MemStream& stream, SnapshotFormat format) {
+		if (format == SnapshotFormat::Compact) {
+			stream.write_value(_cell_size);
+			return;
+		}
+		stream.write_chunk(&_cell_size, sizeof(Unit));
+	}
+
+	void HashGrid::Load(MemStream& stream, SnapshotFormat format) {
+		if (format == SnapshotFormat::Compact) {
+			stream.read_value(_cell_size);
+		} else {
+			uint32_t chunk_size = 0;
+			auto chunk_data = stream.read_chunk(chunk_size);
+			std::memcpy(&_cell_size, chunk_data, chunk_size);
+		}
+
+		// every cell coordinate divides by it
+		if (_cell_size <= Unit{0}) {
+			throw std::out_of_range("Snapshot corrupt");
+		}
+	}
+}
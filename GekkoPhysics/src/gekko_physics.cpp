@@ -1,7 +1,124 @@
 #include "gekko_physics.h"
 #include "algo.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace GekkoPhysics {
+	static const uint32_t NO_INDEX = UINT32_MAX;
+	// below this many pairs per thread spawning workers costs more than it saves
+	static const uint32_t MIN_PAIRS_PER_THREAD = 64;
+
+	// Threads kept alive from step to step, so a threaded Update neither spawns
+	// nor allocates. Run hands a job to the first count - 1 workers, the caller
+	// takes slot 0 itself, and Wait blocks until every worker is done.
+	class World::WorkerPool {
+	public:
+		using Job = void (*)(void* context, uint32_t slot, uint32_t count);
+
+	private:
+		// slot 0 is the calling thread and has no worker
+		std::thread _threads[World::MAX_THREADS];
+		uint8_t _size = 1;
+
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		Job _job = nullptr;
+		void* _context = nullptr;
+		uint32_t _count = 0;
+		uint32_t _pending = 0;
+		uint64_t _round = 0;
+		bool _stop = false;
+
+		void WorkerLoop(uint32_t slot);
+		void Stop();
+
+	public:
+		WorkerPool() = default;
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+		~WorkerPool();
+
+		// Joins the current workers and starts size - 1 new ones.
+		void Resize(uint8_t size);
+		uint8_t Size() const;
+		// count must not exceed Size().
+		void Run(Job job, void* context, uint32_t count);
+		void Wait();
+	};
+
+	World::World() = default;
+
+	World::World(Allocator* allocator) {
+		SetAllocator(allocator);
+	}
+
+	World::World(World&& other) noexcept = default;
+	World& World::operator=(World&& other) noexcept = default;
+	World::~World() = default;
+
+	void World::SetAllocator(Allocator* allocator) {
+		_bodies.set_allocator(allocator);
+		_shape_groups.set_allocator(allocator);
+		_shapes.set_allocator(allocator);
+		_body_groups.set_allocator(allocator);
+		_group_shapes.set_allocator(allocator);
+		_range_owners.set_allocator(allocator);
+		_obbs.set_allocator(allocator);
+		_spheres.set_allocator(allocator);
+		_capsules.set_allocator(allocator);
+
+		_contacts.set_allocator(allocator);
+		for (auto& thread_contacts : _thread_contacts) {
+			thread_contacts.set_allocator(allocator);
+		}
+		for (auto& batch : _batches) {
+			batch.candidates.set_allocator(allocator);
+			batch.results.set_allocator(allocator);
+			for (auto& bucket : batch.buckets) {
+				bucket.set_allocator(allocator);
+			}
+		}
+		_contact_cache.set_allocator(allocator);
+		_delta_target.set_allocator(allocator);
+		_body_hashes.set_allocator(allocator);
+		_hash_dirty_bodies.set_allocator(allocator);
+		_hash_dirty_flags.set_allocator(allocator);
+
+		_island_parent.set_allocator(allocator);
+		_island_index.set_allocator(allocator);
+		_islands.set_allocator(allocator);
+		_island_bodies.set_allocator(allocator);
+		_island_contacts.set_allocator(allocator);
+
+		_group_aabbs.set_allocator(allocator);
+		_group_pairs.set_allocator(allocator);
+		_sweep_and_prune.SetAllocator(allocator);
+		_tree.SetAllocator(allocator);
+		_grid.SetAllocator(allocator);
+
+		_static_aabbs.set_allocator(allocator);
+		_static_lookup.set_allocator(allocator);
+		_static_hits.set_allocator(allocator);
+		_touched_static_groups.set_allocator(allocator);
+		_touched_static_flags.set_allocator(allocator);
+		for (auto& owners : _typed_shape_groups) {
+			owners.set_allocator(allocator);
+		}
+		_static_tree.SetAllocator(allocator);
+
+		_shape_cache.set_allocator(allocator);
+		_world_obbs.set_allocator(allocator);
+		_world_spheres.set_allocator(allocator);
+		_world_capsules.set_allocator(allocator);
+
+		_frame_arena.set_allocator(allocator);
+	}
+
 	void World::SetOrientation(const Vec3& up) {
 		_up = up;
 	}
@@ -18,130 +135,344 @@ namespace GekkoPhysics {
 		_solver_iterations = iterations;
 	}
 
-	Identifier World::CreateBody() {
-		return _bodies.insert({});
+	void World::SetThreadCount(uint8_t count) {
+		if (count < 1) count = 1;
+		if (count > MAX_THREADS) count = MAX_THREADS;
+		_thread_count = count;
+		if (!_workers) {
+			if (count == 1) return;
+			_workers = std::make_unique<WorkerPool>();
+		}
+		if (_workers->Size() != count) _workers->Resize(count);
+	}
+
+	void World::SetSleeping(bool enabled) {
+		_sleep_enabled = enabled;
+		if (!enabled) WakeAllBodies();
+	}
+
+	void World::SetSleepThreshold(const Unit& velocity, uint16_t frames) {
+		_sleep_velocity = velocity;
+		_sleep_frames = frames;
 	}
 
-	Identifier World::AddShapeGroup(Identifier body_id) {
-		if (!_bodies.contains(body_id)) return INVALID_ID;
+	void World::WakeBody(Identifier id) {
+		if (!_bodies.contains(id)) return;
+		MarkDirty(SectionBodies);
+		MarkBodyHash(id);
+		_bodies.get<Info>(id).idle_frames = 0;
+		_bodies.enable(id);
+	}
 
-		// no shapegroups? create a link.
-		auto& body = _bodies.get(body_id);
-		if (body.link_shape_groups == INVALID_ID) {
-			body.link_shape_groups = CreateLink();
-			// still invalid? return.
-			if (body.link_shape_groups == INVALID_ID) {
-				return INVALID_ID;
+	void World::WakeBody(BodyHandle handle) {
+		WakeBody(Resolve(handle));
+	}
+
+	bool World::IsAwake(Identifier id) const {
+		return _bodies.is_enabled(id);
+	}
+
+	bool World::IsAwake(BodyHandle handle) const {
+		return IsAwake(Resolve(handle));
+	}
+
+	void World::SetBroadphase(BroadphaseType type, const Unit& size) {
+		if (type != _broadphase) {
+			// proxies are created lazily on the next update
+			_tree.Clear();
+			_sweep_and_prune.Clear();
+			_grid.Clear();
+		}
+		_broadphase = type;
+
+		if (size > Unit{0}) {
+			if (type == BroadphaseType::DynamicTree) {
+				_tree.SetMargin(size);
+			} else if (type == BroadphaseType::Grid) {
+				_grid.SetCellSize(size);
 			}
 		}
+	}
 
-		Identifier group_id = INVALID_ID;
-		auto& link = _links.get(body.link_shape_groups);
-		for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-			if (link.children[i] == INVALID_ID) {
-				group_id = _shape_groups.insert({});
-				_shape_groups.get(group_id).owner_body = body_id;
-				link.children[i] = group_id;
-				break;
+	BodyHandle World::CreateBody() {
+		const Identifier id = _bodies.insert(Vec3(), Vec3(), Vec3(), Mat3(), BodyInfo());
+		if (id == INVALID_ID) return {};
+		MarkDirty(SectionBodies);
+		MarkBodyHash(id);
+		return { id, _bodies.generation(id) };
+	}
+
+	// Appends a value to the owner's range in a packed list. A range that does
+	// not end the list is moved to the end first and leaves holes behind, so an
+	// insert never touches other ranges. Building a world in order only appends.
+	template <typename Owner, typename T>
+	static void InsertIntoRange(Vec<T>& list, Owner& owner, uint32_t Owner::* start, uint32_t Owner::* count,
+		uint32_t& holes, const T& value) {
+		if (owner.*count == 0) {
+			owner.*start = list.size();
+		} else if (owner.*start + owner.*count != list.size()) {
+			const uint32_t from = owner.*start;
+			owner.*start = list.size();
+			for (uint32_t i = 0; i < owner.*count; i++) {
+				// copied out first, the push can move the list
+				const T moved = list[from + i];
+				list.push_back(moved);
+			}
+			holes += owner.*count;
+		}
+
+		list.push_back(value);
+		owner.*count += 1;
+	}
+
+	// Closes a slot of the owner's range within the range, the freed slot at its
+	// end becomes a hole unless it ends the list.
+	template <typename Owner, typename T>
+	static void EraseFromRange(Vec<T>& list, Owner& owner, uint32_t Owner::* start, uint32_t Owner::* count,
+		uint32_t& holes, uint32_t slot) {
+		const uint32_t end = owner.*start + owner.*count;
+		for (uint32_t i = slot; i + 1 < end; i++) {
+			list[i] = list[i + 1];
+		}
+		owner.*count -= 1;
+
+		if (end == list.size()) {
+			list.pop_back();
+		} else {
+			holes += 1;
+		}
+	}
+
+	// Closes every hole of a packed list, keeping the ranges in list order.
+	// One pass over the owners and one over the list.
+	template <typename Owner, typename T>
+	static void CompactRanges(Vec<T>& list, uint32_t Owner::* start, uint32_t Owner::* count,
+		Owner* owners_begin, Owner* owners_end, Vec<uint32_t>& range_owners) {
+		range_owners.resize(list.size());
+		for (uint32_t i = 0; i < range_owners.size(); i++) {
+			range_owners[i] = NO_INDEX;
+		}
+		for (Owner* owner = owners_begin; owner != owners_end; owner++) {
+			if (owner->*count > 0) range_owners[owner->*start] = static_cast<uint32_t>(owner - owners_begin);
+		}
+
+		uint32_t write = 0;
+		for (uint32_t read = 0; read < list.size();) {
+			if (range_owners[read] == NO_INDEX) {
+				read++;
+				continue;
+			}
+			Owner& owner = owners_begin[range_owners[read]];
+			owner.*start = write;
+			for (uint32_t i = 0; i < owner.*count; i++) {
+				list[write++] = list[read++];
 			}
 		}
+		list.resize(write);
+	}
 
-		return group_id;
+	// Slots of a packed list not covered by any range.
+	template <typename Owner, typename T>
+	static uint32_t CountRangeHoles(const Vec<T>& list, uint32_t Owner::* count,
+		const Owner* owners_begin, const Owner* owners_end) {
+		uint32_t used = 0;
+		for (const Owner* owner = owners_begin; owner != owners_end; owner++) {
+			used += owner->*count;
+		}
+		return list.size() - used;
 	}
 
-	Identifier World::AddShape(Identifier shape_group_id, Shape::Type shape_type) {
+	void World::CompactBodyGroups() {
+		auto& infos = _bodies.column<Info>();
+		CompactRanges(_body_groups, &BodyInfo::group_start, &BodyInfo::group_count,
+			infos.begin(), infos.end(), _range_owners);
+		_body_group_holes = 0;
+		MarkDirty(SectionBodies);
+		MarkDirty(SectionBodyGroups);
+	}
+
+	void World::CompactGroupShapes() {
+		CompactRanges(_group_shapes, &ShapeGroup::shape_start, &ShapeGroup::shape_count,
+			_shape_groups.begin(), _shape_groups.end(), _range_owners);
+		_group_shape_holes = 0;
+		MarkDirty(SectionShapeGroups);
+		MarkDirty(SectionGroupShapes);
+	}
+
+	ShapeGroupHandle World::AddShapeGroup(Identifier body_id) {
+		if (!_bodies.contains(body_id)) return {};
+
+		const Identifier group_id = _shape_groups.insert({});
+		if (group_id == INVALID_ID) return {};
+		MarkDirty(SectionBodies);
+		MarkDirty(SectionBodyGroups);
+		MarkDirty(SectionShapeGroups);
+		MarkBodyHash(body_id);
+		_shape_groups.get(group_id).owner_body = body_id;
+
+		InsertIntoRange(_body_groups, _bodies.get<Info>(body_id), &BodyInfo::group_start, &BodyInfo::group_count,
+			_body_group_holes, group_id);
+		// Update compacts too, this only bounds a world built without stepping
+		if (_body_group_holes > _body_groups.size() / 2) CompactBodyGroups();
+
+		MarkStaticsDirty(body_id);
+		if (_broadphase == BroadphaseType::DynamicTree) {
+			// start as a point at the body origin, the first update re-inserts it.
+			const Vec3& origin = _bodies.get<Position>(body_id);
+			_tree.CreateProxy(group_id, { origin, origin });
+		}
+
+		return { group_id, _shape_groups.generation(group_id) };
+	}
+
+	ShapeGroupHandle World::AddShapeGroup(BodyHandle body) {
+		return AddShapeGroup(Resolve(body));
+	}
+
+	ShapeHandle World::AddShape(Identifier shape_group_id, Shape::Type shape_type) {
 		if (shape_type == Shape::None || !_shape_groups.contains(shape_group_id)) {
-			return INVALID_ID;
+			return {};
 		}
 
-		// no shapes? create a link.
-		auto& shape_group = _shape_groups.get(shape_group_id);
-		if (shape_group.link_shapes == INVALID_ID) {
-			shape_group.link_shapes = CreateLink();
-			// still invalid? return.
-			if (shape_group.link_shapes == INVALID_ID) {
-				return INVALID_ID;
-			}
-		}
-
-		Identifier shape_id = INVALID_ID;
-		auto& link = _links.get(shape_group.link_shapes);
-		for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-			if (link.children[i] == INVALID_ID) {
-				auto shape = Shape();
-				shape.type = shape_type;
-
-				switch (shape.type) {
-				case Shape::OBB:
-					shape.shape_type_id = _obbs.insert({});
-					break;
-				case Shape::Sphere:
-					shape.shape_type_id = _spheres.insert({});
-					break;
-				case Shape::Capsule:
-					shape.shape_type_id = _capsules.insert({});
-					break;
-				}
+		auto shape = Shape();
+		shape.type = shape_type;
 
-				link.children[i] = _shapes.insert(shape);
-				shape_id = link.children[i];
-				break;
+		switch (shape.type) {
+		case Shape::OBB:
+			shape.shape_type_id = _obbs.insert({});
+			break;
+		case Shape::Sphere:
+			shape.shape_type_id = _spheres.insert({});
+			break;
+		case Shape::Capsule:
+			shape.shape_type_id = _capsules.insert({});
+			break;
+		}
+
+		if (shape.shape_type_id == INVALID_ID) return {};
+
+		const Identifier shape_id = _shapes.insert(shape);
+		if (shape_id == INVALID_ID) {
+			switch (shape.type) {
+			case Shape::OBB: _obbs.remove(shape.shape_type_id); break;
+			case Shape::Sphere: _spheres.remove(shape.shape_type_id); break;
+			case Shape::Capsule: _capsules.remove(shape.shape_type_id); break;
+			default: break;
 			}
+			return {};
 		}
 
-		return shape_id;
+		MarkDirty(SectionShapeGroups);
+		MarkDirty(SectionGroupShapes);
+		MarkDirty(SectionShapes);
+		MarkDirty(shape.type == Shape::OBB ? SectionOBBs : shape.type == Shape::Sphere ? SectionSpheres : SectionCapsules);
+
+		auto& shape_group = _shape_groups.get(shape_group_id);
+		InsertIntoRange(_group_shapes, shape_group, &ShapeGroup::shape_start, &ShapeGroup::shape_count,
+			_group_shape_holes, GroupShape{ shape_id, shape });
+		if (_group_shape_holes > _group_shapes.size() / 2) CompactGroupShapes();
+
+		SetShapeGroupOwner(shape, shape_group_id);
+		InvalidateShapeCache(shape_id);
+		MarkStaticsDirty(shape_group.owner_body);
+
+		return { shape_id, _shapes.generation(shape_id) };
+	}
+
+	ShapeHandle World::AddShape(ShapeGroupHandle shape_group, Shape::Type shape_type) {
+		return AddShape(Resolve(shape_group), shape_type);
 	}
 
 	void World::RemoveBody(Identifier id) {
-		// when removing a body also remove all its links, shapegroups and shapes
+		// when removing a body also remove all its shapegroups and shapes
 		if (!_bodies.contains(id)) return;
 
-		auto& body = _bodies.get(id);
-		// cleanup shapegroups
-		if (body.link_shape_groups != INVALID_ID) {
-			auto& link = _links.get(body.link_shape_groups);
-			for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-				RemoveShapeGroup(id, link.children[i]);
-			}
-			_links.remove(body.link_shape_groups);
+		// looked up every time, removing groups can wake other bodies which reorders the body columns
+		while (_bodies.get<Info>(id).group_count > 0) {
+			const BodyInfo& info = _bodies.get<Info>(id);
+			RemoveShapeGroup(id, _body_groups[info.group_start + info.group_count - 1]);
 		}
 
 		// cleanup body
+		MarkDirty(SectionBodies);
+		MarkBodyHash(id);
 		_bodies.remove(id);
 	}
 
+	void World::RemoveBody(BodyHandle body) {
+		RemoveBody(Resolve(body));
+	}
+
+	void World::RemoveShapeGroup(BodyHandle body, ShapeGroupHandle shape_group) {
+		RemoveShapeGroup(Resolve(body), Resolve(shape_group));
+	}
+
+	void World::RemoveShape(ShapeGroupHandle shape_group, ShapeHandle shape) {
+		RemoveShape(Resolve(shape_group), Resolve(shape));
+	}
+
+	bool World::IsValid(BodyHandle handle) const {
+		return _bodies.is_current(handle.id, handle.generation);
+	}
+
+	bool World::IsValid(ShapeGroupHandle handle) const {
+		return _shape_groups.is_current(handle.id, handle.generation);
+	}
+
+	bool World::IsValid(ShapeHandle handle) const {
+		return _shapes.is_current(handle.id, handle.generation);
+	}
+
+	Identifier World::Resolve(BodyHandle handle) const {
+		return IsValid(handle) ? handle.id : INVALID_ID;
+	}
+
+	Identifier World::Resolve(ShapeGroupHandle handle) const {
+		return IsValid(handle) ? handle.id : INVALID_ID;
+	}
+
+	Identifier World::Resolve(ShapeHandle handle) const {
+		return IsValid(handle) ? handle.id : INVALID_ID;
+	}
+
 	void World::RemoveShapeGroup(Identifier body_id, Identifier shape_group_id) {
 		if (body_id == INVALID_ID ||
+			!_bodies.contains(body_id) ||
 			shape_group_id == INVALID_ID ||
 			!_shape_groups.contains(shape_group_id)) return;
 
-		// cleanup shapegroup link in body
-		auto& body = _bodies.get(body_id);
-		auto& shapegroup_link = _links.get(body.link_shape_groups);
-		bool found_group = false;
-		for (size_t i = 0; i < Link::NUM_LINKS; i++){
-			if (shapegroup_link.children[i] == shape_group_id) {
-				// mark link as free/open
-				shapegroup_link.children[i] = INVALID_ID;
-				found_group = true;
-				break;
-			}
-		}
+		// cleanup shapegroup slot in body
+		auto& info = _bodies.get<Info>(body_id);
+		uint32_t slot = info.group_start;
+		const uint32_t group_end = info.group_start + info.group_count;
+		while (slot < group_end && _body_groups[slot] != shape_group_id) slot++;
 
 		// no group found in the right body? dont process
-		if (!found_group) return;
+		if (slot == group_end) return;
+
+		MarkDirty(SectionBodies);
+		MarkDirty(SectionBodyGroups);
+		MarkDirty(SectionShapeGroups);
+		MarkBodyHash(body_id);
+
+		EraseFromRange(_body_groups, info, &BodyInfo::group_start, &BodyInfo::group_count,
+			_body_group_holes, slot);
+
+		// bodies resting on this group lose their support
+		AABB group_aabb;
+		if (CachedShapeGroupAABB(_shape_groups.get(shape_group_id), group_aabb)) {
+			WakeBodiesOverlapping(group_aabb);
+		}
 
 		// remove shapes within the group
-		auto& group = _shape_groups.get(shape_group_id);
-		if (group.link_shapes != INVALID_ID) {
-			auto& shapes_link = _links.get(group.link_shapes);
-			for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-				RemoveShape(shape_group_id, shapes_link.children[i]);
-			}
-			_links.remove(group.link_shapes);
+		while (_shape_groups.get(shape_group_id).shape_count > 0) {
+			const auto& group = _shape_groups.get(shape_group_id);
+			RemoveShape(shape_group_id, _group_shapes[group.shape_start + group.shape_count - 1].shape_id);
 		}
 
 		// remove shapegroup
+		MarkStaticsDirty(body_id);
+		_tree.DestroyProxy(shape_group_id);
 		_shape_groups.remove(shape_group_id);
 	}
 
@@ -151,26 +482,26 @@ namespace GekkoPhysics {
 			!_shapes.contains(shape_id) ||
 			!_shape_groups.contains(shape_group_id)) return;
 
-		// cleanup shapes link in shapegroup
+		// cleanup shape slot in shapegroup
 		auto& shape_group = _shape_groups.get(shape_group_id);
-		if (shape_group.link_shapes == INVALID_ID) return;
-		auto& shapes_link = _links.get(shape_group.link_shapes);
-		bool found_shape = false;
-		for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-			if (shapes_link.children[i] == shape_id) {
-				// mark link as free/open
-				shapes_link.children[i] = INVALID_ID;
-				found_shape = true;
-				break;
-			}
-		}
+		uint32_t slot = shape_group.shape_start;
+		const uint32_t shape_end = shape_group.shape_start + shape_group.shape_count;
+		while (slot < shape_end && _group_shapes[slot].shape_id != shape_id) slot++;
 
 		// no shape found? return.
-		if (!found_shape) return;
+		if (slot == shape_end) return;
+
+		EraseFromRange(_group_shapes, shape_group, &ShapeGroup::shape_start, &ShapeGroup::shape_count,
+			_group_shape_holes, slot);
 
 		auto& shape = _shapes.get(shape_id);
+		MarkDirty(SectionShapeGroups);
+		MarkDirty(SectionGroupShapes);
+		MarkDirty(SectionShapes);
+		MarkDirty(shape.type == Shape::OBB ? SectionOBBs : shape.type == Shape::Sphere ? SectionSpheres : SectionCapsules);
 
 		// remove collision shape based on shapetype
+		SetShapeGroupOwner(shape, INVALID_ID);
 		switch (shape.type) {
 		case Shape::OBB:
 			_obbs.remove(shape.shape_type_id);
@@ -183,16 +514,167 @@ namespace GekkoPhysics {
 			break;
 		}
 
+		// a shape that reuses the id must not replay contacts of this one
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < _contact_cache.size(); i++) {
+			const ContactPair& cached = _contact_cache[i];
+			if (cached.shape_a == shape_id || cached.shape_b == shape_id) continue;
+			_contact_cache[kept++] = cached;
+		}
+		_contact_cache.resize(kept);
+
 		// cleanup shape
+		MarkStaticsDirty(shape_group.owner_body);
+		InvalidateShapeCache(shape_id);
 		_shapes.remove(shape_id);
 	}
 
-	void World::Save(MemStream& stream) {
+	// Lead the snapshot formats, each followed by SNAPSHOT_VERSION.
+	static const uint32_t CHUNKED_SNAPSHOT_MAGIC = 0x434B4747; // "GGKC"
+	static const uint32_t COMPACT_SNAPSHOT_MAGIC = 0x534B4747; // "GGKS"
+	// An incremental snapshot needs its key to be read.
+	static const uint32_t INCREMENTAL_SNAPSHOT_MAGIC = 0x494B4747; // "GGKI"
+	// Bump whenever the layout of any format changes. The identifier width is
+	// part of it, ids are stored at their native size. Snapshots from before
+	// versioning start with a chunk size and never match a magic.
+	static const uint32_t SNAPSHOT_FORMAT_VERSION = 2;
+	static const uint32_t SNAPSHOT_VERSION = SNAPSHOT_FORMAT_VERSION | uint32_t{ sizeof(Identifier) } << 16;
+	static const uint32_t SNAPSHOT_HEADER_BYTES = 8;
+
+	// Trails compact and incremental snapshots, one entry per section.
+	// Offsets are relative to the start of the snapshot that holds the bytes.
+	struct SnapshotSectionEntry {
+		uint64_t version = 0;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		// 0 if the bytes are in this snapshot, 1 if they are in the key
+		uint8_t source = 0;
+	};
+
+	static const uint32_t SECTION_ENTRY_BYTES = 17;
+
+	static void WriteSectionTable(const SnapshotSectionEntry* entries, uint32_t count, MemStream& stream) {
+		for (uint32_t i = 0; i < count; i++) {
+			stream.write_value(entries[i].version);
+			stream.write_value(entries[i].offset);
+			stream.write_value(entries[i].size);
+			stream.write_value(entries[i].source);
+		}
+	}
+
+	static void ReadSectionTable(const uint8_t* table, SnapshotSectionEntry* entries, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++, table += SECTION_ENTRY_BYTES) {
+			std::memcpy(&entries[i].version, table, 8);
+			std::memcpy(&entries[i].offset, table + 8, 4);
+			std::memcpy(&entries[i].size, table + 12, 4);
+			entries[i].source = table[16];
+		}
+	}
+
+	// Section table of a whole compact snapshot, false if the stream is not one
+	// of this version.
+	static bool ReadKeyTable(MemStream& key, SnapshotSectionEntry* entries, uint32_t count) {
+		const size_t table_bytes = size_t(count) * SECTION_ENTRY_BYTES;
+		if (key.size() < SNAPSHOT_HEADER_BYTES + table_bytes) return false;
+
+		uint32_t magic = 0, version = 0;
+		std::memcpy(&magic, key.data(), sizeof(magic));
+		std::memcpy(&version, key.data() + sizeof(magic), sizeof(version));
+		if (magic != COMPACT_SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) return false;
+
+		ReadSectionTable(key.data() + key.size() - table_bytes, entries, count);
+		for (uint32_t i = 0; i < count; i++) {
+			if (entries[i].source != 0 || size_t(entries[i].offset) + entries[i].size > key.size() - table_bytes) return false;
+		}
+		return true;
+	}
+
+	void World::MarkDirty(SnapshotSection section) {
+		_section_versions[section] = ++_version_clock;
+	}
+
+	void World::WriteSection(SnapshotSection section, MemStream& stream) {
+		switch (section) {
+		case SectionSettings:
+			stream.write_value(_origin);
+			stream.write_value(_up);
+			stream.write_value(_update_rate);
+			stream.write_value(_sleep_velocity);
+			stream.write_value(_sleep_frames);
+			stream.write_value(_solver_iterations);
+			stream.write_value(_broadphase);
+			stream.write_value(_sleep_enabled);
+			break;
+		case SectionBodies: _bodies.save_compact(stream); break;
+		case SectionBodyGroups: save_vec_compact(_body_groups, stream); break;
+		case SectionShapeGroups: _shape_groups.save_compact(stream); break;
+		case SectionGroupShapes: save_vec_compact(_group_shapes, stream); break;
+		case SectionShapes: _shapes.save_compact(stream); break;
+		case SectionOBBs: _obbs.save_compact(stream); break;
+		case SectionSpheres: _spheres.save_compact(stream); break;
+		case SectionCapsules: _capsules.save_compact(stream); break;
+		case SectionContacts:
+			save_vec_compact(_contact_cache, stream);
+			_tree.Save(stream, SnapshotFormat::Compact);
+			_grid.Save(stream, SnapshotFormat::Compact);
+			break;
+		default: break;
+		}
+	}
+
+	void World::ReadSection(SnapshotSection section, MemStream& stream) {
+		switch (section) {
+		case SectionSettings:
+			stream.read_value(_origin);
+			stream.read_value(_up);
+			stream.read_value(_update_rate);
+			stream.read_value(_sleep_velocity);
+			stream.read_value(_sleep_frames);
+			stream.read_value(_solver_iterations);
+			stream.read_value(_broadphase);
+			stream.read_value(_sleep_enabled);
+			break;
+		case SectionBodies: _bodies.load_compact(stream); break;
+		case SectionBodyGroups: load_vec_compact(_body_groups, stream); break;
+		case SectionShapeGroups: _shape_groups.load_compact(stream); break;
+		case SectionGroupShapes: load_vec_compact(_group_shapes, stream); break;
+		case SectionShapes: _shapes.load_compact(stream); break;
+		case SectionOBBs: _obbs.load_compact(stream); break;
+		case SectionSpheres: _spheres.load_compact(stream); break;
+		case SectionCapsules: _capsules.load_compact(stream); break;
+		case SectionContacts:
+			load_vec_compact(_contact_cache, stream);
+			_tree.Load(stream, SnapshotFormat::Compact);
+			_grid.Load(stream, SnapshotFormat::Compact);
+			break;
+		default: break;
+		}
+	}
+
+	void World::Save(MemStream& stream, SnapshotFormat format) {
+		if (format == SnapshotFormat::Compact) {
+			const size_t start = stream.tell();
+			SnapshotSectionEntry entries[SectionCount];
+			stream.write_value(COMPACT_SNAPSHOT_MAGIC);
+			stream.write_value(SNAPSHOT_VERSION);
+			for (uint8_t s = 0; s < SectionCount; s++) {
+				entries[s].version = _section_versions[s];
+				entries[s].offset = static_cast<uint32_t>(stream.tell() - start);
+				WriteSection(static_cast<SnapshotSection>(s), stream);
+				entries[s].size = static_cast<uint32_t>(stream.tell() - start) - entries[s].offset;
+			}
+			WriteSectionTable(entries, SectionCount, stream);
+			return;
+		}
+
+		stream.write_value(CHUNKED_SNAPSHOT_MAGIC);
+		stream.write_value(SNAPSHOT_VERSION);
 		_bodies.save(stream);
 		_shape_groups.save(stream);
 		_shapes.save(stream);
 
-		_links.save(stream);
+		save_vec(_body_groups, stream);
+		save_vec(_group_shapes, stream);
 
 		_obbs.save(stream);
 		_spheres.save(stream);
@@ -202,14 +684,521 @@ namespace GekkoPhysics {
 		stream.write_chunk(&_up, sizeof(Vec3));
 		stream.write_chunk(&_update_rate, sizeof(Unit));
 		stream.write_chunk(&_solver_iterations, sizeof(uint8_t));
+		stream.write_chunk(&_broadphase, sizeof(BroadphaseType));
+		stream.write_chunk(&_sleep_enabled, sizeof(bool));
+		stream.write_chunk(&_sleep_velocity, sizeof(Unit));
+		stream.write_chunk(&_sleep_frames, sizeof(uint16_t));
+		save_vec(_contact_cache, stream);
+
+		_tree.Save(stream);
+		_grid.Save(stream);
 	}
 
 	void World::Load(MemStream& stream) {
+		uint32_t magic = 0, version = 0;
+		if (stream.tell() + SNAPSHOT_HEADER_BYTES <= stream.size()) {
+			std::memcpy(&magic, stream.data() + stream.tell(), sizeof(magic));
+			std::memcpy(&version, stream.data() + stream.tell() + sizeof(magic), sizeof(version));
+		}
+
+		// checked up front, an unknown layout must not touch the world
+		if (magic == INCREMENTAL_SNAPSHOT_MAGIC) {
+			throw std::out_of_range("Incremental snapshot needs its key");
+		} else if ((magic != COMPACT_SNAPSHOT_MAGIC && magic != CHUNKED_SNAPSHOT_MAGIC) || version != SNAPSHOT_VERSION) {
+			throw std::out_of_range("Snapshot format not supported");
+		}
+
+		stream.seek(stream.tell() + SNAPSHOT_HEADER_BYTES);
+		if (magic == COMPACT_SNAPSHOT_MAGIC) {
+			LoadCompact(stream);
+		} else {
+			LoadChunked(stream);
+		}
+
+		// derived state, rebuilt without waking so a rollback keeps sleepers asleep
+		_shape_cache.clear();
+		_islands.clear();
+		RebuildShapeGroupOwners();
+		auto& infos = _bodies.column<Info>();
+		_body_group_holes = CountRangeHoles(_body_groups, &BodyInfo::group_count, infos.begin(), infos.end());
+		_group_shape_holes = CountRangeHoles(_group_shapes, &ShapeGroup::shape_count,
+			_shape_groups.begin(), _shape_groups.end());
+		RebuildStaticGroups(false);
+
+		_hash_all_bodies = true;
+		for (bool& hashed : _section_hashed) hashed = false;
+	}
+
+	// Leads a delta snapshot.
+	static const uint32_t DELTA_SNAPSHOT_MAGIC = 0x444B4747; // "GGKD"
+	// Unchanged bytes between two changes that are still sent as part of one
+	// range, cheaper than the 8 byte header of a new one.
+	static const uint32_t DELTA_MERGE_GAP = 8;
+
+	// Checksum of the base a delta was written against, so one applied to
+	// another base of the same size is caught.
+	static uint64_t HashSnapshotBytes(const uint8_t* data, size_t size);
+
+	void World::SaveDelta(MemStream& base, MemStream& stream) {
+		MemStream target(&_delta_target);
+		target.clear();
+		Save(target, SnapshotFormat::Compact);
+
+		const uint8_t* from = base.data();
+		const uint8_t* to = target.data();
+		const uint32_t base_size = static_cast<uint32_t>(base.size());
+		const uint32_t target_size = static_cast<uint32_t>(target.size());
+		const uint32_t common = std::min(base_size, target_size);
+
+		stream.write_value(DELTA_SNAPSHOT_MAGIC);
+		stream.write_value(base_size);
+		stream.write_value(target_size);
+		stream.write_value(HashSnapshotBytes(from, base_size));
+
+		// Ranges come out in ascending order. Everything past the end of base
+		// counts as changed.
+		uint32_t i = 0;
+		while (i < target_size) {
+			while (i + 8 <= common && std::memcmp(from + i, to + i, 8) == 0) i += 8;
+			if (i < common && from[i] == to[i]) {
+				i++;
+				continue;
+			}
+			if (i >= target_size) break;
+
+			uint32_t end = i + 1;
+			for (uint32_t k = end; k < target_size && k - end < DELTA_MERGE_GAP; k++) {
+				if (k >= common || from[k] != to[k]) end = k + 1;
+			}
+
+			const uint32_t length = end - i;
+			stream.write_value(i);
+			stream.write_value(length);
+			stream.write_bytes(to + i, length);
+			i = end;
+		}
+
+		// an empty range terminates the list
+		stream.write_value(target_size);
+		stream.write_value(uint32_t{ 0 });
+	}
+
+	void World::LoadDelta(MemStream& base, MemStream& stream) {
+		uint32_t magic = 0, base_size = 0, target_size = 0;
+		uint64_t base_hash = 0;
+		stream.read_value(magic);
+		stream.read_value(base_size);
+		stream.read_value(target_size);
+		stream.read_value(base_hash);
+		if (magic != DELTA_SNAPSHOT_MAGIC || base_size != base.size() ||
+			base_hash != HashSnapshotBytes(base.data(), base_size)) {
+			throw std::out_of_range("Delta does not match base snapshot");
+		}
+
+		// Rebuild the full snapshot from base and the changed ranges.
+		MemStream target(&_delta_target);
+		target.clear();
+		const uint8_t* from = base.data();
+		uint32_t copied = 0;
+		for (;;) {
+			uint32_t offset = 0, length = 0;
+			stream.read_value(offset);
+			stream.read_value(length);
+			if (offset < copied || offset > target_size || length > target_size - offset) {
+				throw std::out_of_range("Delta does not match base snapshot");
+			}
+
+			if (offset > copied) {
+				if (offset > base_size) throw std::out_of_range("Delta does not match base snapshot");
+				target.write_bytes(from + copied, offset - copied);
+			}
+			if (length == 0) break;
+
+			const uint8_t* bytes = stream.read_bytes(length);
+			if (!bytes) throw std::out_of_range("Snapshot too short");
+			target.write_bytes(bytes, length);
+			copied = offset + length;
+		}
+
+		target.rewind();
+		Load(target);
+	}
+
+	void World::SaveIncremental(MemStream& key, MemStream& stream) {
+		SnapshotSectionEntry key_entries[SectionCount];
+		const bool has_key = ReadKeyTable(key, key_entries, SectionCount);
+
+		const size_t start = stream.tell();
+		SnapshotSectionEntry entries[SectionCount];
+		stream.write_value(INCREMENTAL_SNAPSHOT_MAGIC);
+		stream.write_value(SNAPSHOT_VERSION);
+		stream.write_value(static_cast<uint32_t>(key.size()));
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			entries[s].version = _section_versions[s];
+			const bool tracked = s != SectionSettings && s != SectionContacts;
+			if (has_key && tracked && key_entries[s].version == _section_versions[s]) {
+				entries[s].offset = key_entries[s].offset;
+				entries[s].size = key_entries[s].size;
+				entries[s].source = 1;
+				continue;
+			}
+
+			entries[s].offset = static_cast<uint32_t>(stream.tell() - start);
+			WriteSection(static_cast<SnapshotSection>(s), stream);
+			entries[s].size = static_cast<uint32_t>(stream.tell() - start) - entries[s].offset;
+		}
+		WriteSectionTable(entries, SectionCount, stream);
+	}
+
+	void World::LoadIncremental(MemStream& key, MemStream& stream) {
+		const size_t start = stream.tell();
+		const size_t table_bytes = size_t(SectionCount) * SECTION_ENTRY_BYTES;
+		uint32_t magic = 0, version = 0, key_size = 0;
+		stream.read_value(magic);
+		stream.read_value(version);
+		stream.read_value(key_size);
+		if (magic != INCREMENTAL_SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || key_size != key.size() ||
+			stream.size() < stream.tell() + table_bytes) {
+			throw std::out_of_range("Incremental snapshot does not match key");
+		}
+
+		const size_t body_size = stream.size() - table_bytes - start;
+		SnapshotSectionEntry entries[SectionCount];
+		ReadSectionTable(stream.data() + stream.size() - table_bytes, entries, SectionCount);
+
+		// Rebuild the full compact snapshot, taking unchanged sections from key.
+		MemStream target(&_delta_target);
+		target.clear();
+		target.write_value(COMPACT_SNAPSHOT_MAGIC);
+		target.write_value(SNAPSHOT_VERSION);
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			SnapshotSectionEntry& entry = entries[s];
+			const uint8_t* from = nullptr;
+			if (entry.source == 0 && size_t(entry.offset) + entry.size <= body_size) {
+				from = stream.data() + start + entry.offset;
+			} else if (entry.source == 1 && size_t(entry.offset) + entry.size <= key.size()) {
+				from = key.data() + entry.offset;
+			}
+			if (!from) throw std::out_of_range("Incremental snapshot does not match key");
+
+			entry.offset = static_cast<uint32_t>(target.tell());
+			entry.source = 0;
+			target.write_bytes(from, entry.size);
+		}
+		WriteSectionTable(entries, SectionCount, target);
+		stream.seek(stream.size());
+
+		target.rewind();
+		Load(target);
+	}
+
+	WorldView::WorldView(const MemStream& stream) {
+		MemStream snapshot(stream.data(), stream.size());
+		SnapshotSectionEntry entries[World::SectionCount];
+		if (!ReadKeyTable(snapshot, entries, World::SectionCount)) {
+			throw std::out_of_range("WorldView needs a compact snapshot");
+		}
+
+		auto section = [&](World::SnapshotSection s) {
+			return MemStream(stream.data() + entries[s].offset, entries[s].size);
+		};
+		MemStream bodies = section(World::SectionBodies);
+		_bodies.view_compact(bodies);
+		MemStream shape_groups = section(World::SectionShapeGroups);
+		_shape_groups.view_compact(shape_groups);
+		MemStream shapes = section(World::SectionShapes);
+		_shapes.view_compact(shapes);
+		MemStream obbs = section(World::SectionOBBs);
+		_obbs.view_compact(obbs);
+		MemStream spheres = section(World::SectionSpheres);
+		_spheres.view_compact(spheres);
+		MemStream capsules = section(World::SectionCapsules);
+		_capsules.view_compact(capsules);
+
+		// the broadphase after the contact cache is of no use to a view
+		MemStream contacts = section(World::SectionContacts);
+		uint32_t contact_count = 0;
+		contacts.read_value(contact_count);
+		_contacts = view_elements<ContactPair>(contact_count, contacts);
+	}
+
+	uint32_t WorldView::BodyIndex(Identifier id) const {
+		const Identifier index = _bodies.dense_index(id);
+		if (index == INVALID_ID) {
+			throw std::out_of_range("Invalid ID");
+		}
+		return static_cast<uint32_t>(index);
+	}
+
+	// Multiply-xorshift over 8 byte words with an FNV-1a tail, fed with
+	// explicitly listed fields so padding never reaches a hash.
+	// Blocks of 32 bytes run through four independent lanes, which keeps the
+	// multiplies from waiting on each other.
+	struct StateHasher {
+		static constexpr uint64_t K = 0x9e3779b97f4a7c15ull;
+		uint64_t value = 14695981039346656037ull;
+
+		static uint64_t Step(uint64_t lane, const uint8_t* bytes) {
+			uint64_t word;
+			std::memcpy(&word, bytes, 8);
+			lane = (lane ^ word) * K;
+			return lane ^ (lane >> 32);
+		}
+
+		void AddBytes(const void* data, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			if (size >= 32) {
+				uint64_t a = value, b = value + 1, c = value + 2, d = value + 3;
+				for (; size >= 32; size -= 32, bytes += 32) {
+					a = Step(a, bytes);
+					b = Step(b, bytes + 8);
+					c = Step(c, bytes + 16);
+					d = Step(d, bytes + 24);
+				}
+				value = (((a * K ^ b) * K ^ c) * K ^ d) * K;
+			}
+			for (; size >= 8; size -= 8, bytes += 8) {
+				value = Step(value, bytes);
+			}
+			for (; size > 0; size--, bytes++) {
+				value = (value ^ *bytes) * 1099511628211ull;
+			}
+		}
+
+		// Only for types without padding.
+		template <typename T>
+		void Add(const T& field) {
+			AddBytes(&field, sizeof(T));
+		}
+	};
+
+	static uint64_t HashSnapshotBytes(const uint8_t* data, size_t size) {
+		StateHasher hasher;
+		if (size > 0) hasher.AddBytes(data, size);
+		return hasher.value;
+	}
+
+	// Spreads a hash over all bits before it is summed with others.
+	static uint64_t MixHash(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x;
+	}
+
+	static void HashShape(StateHasher& hasher, const Shape& shape) {
+		hasher.Add(shape.shape_type_id);
+		hasher.Add(shape.type);
+	}
+
+	// Ids and the free list of a set plus its elements in dense order. Generations
+	// are left out like in HashBodyAt, they differ between peers after a rollback.
+	template <typename T, typename AddElement>
+	static uint64_t HashSparseSet(const SparseSet<Identifier, T>& set, AddElement add_element) {
+		StateHasher hasher;
+		hasher.Add(set.size());
+		hasher.Add(set.active_size());
+		hasher.Add(set.next_id());
+		hasher.AddBytes(set.free_ids().begin(), set.free_ids().size() * sizeof(Identifier));
+		for (uint32_t i = 0; i < set.size(); i++) {
+			const Identifier id = set.entity_id(i);
+			hasher.Add(id);
+			add_element(hasher, *(set.begin() + i));
+		}
+		return hasher.value;
+	}
+
+	void World::MarkBodyHash(Identifier id) {
+		if (id < 0) return;
+		while (static_cast<uint32_t>(id) >= _hash_dirty_flags.size()) {
+			_hash_dirty_flags.push_back(0);
+		}
+		if (_hash_dirty_flags[id]) return;
+		_hash_dirty_flags[id] = 1;
+		_hash_dirty_bodies.push_back(id);
+	}
+
+	// 0 marks a body that is not part of the sum.
+	void World::UpdateBodyHash(Identifier id, uint64_t hash) {
+		while (static_cast<uint32_t>(id) >= _body_hashes.size()) {
+			_body_hashes.push_back(0);
+		}
+		_body_hash_sum += hash - _body_hashes[id];
+		_body_hashes[id] = hash;
+	}
+
+	uint64_t World::SectionHash(SnapshotSection section) const {
+		StateHasher hasher;
+		switch (section) {
+		case SectionSettings:
+			hasher.Add(_origin);
+			hasher.Add(_up);
+			hasher.Add(_update_rate);
+			hasher.Add(_sleep_velocity);
+			hasher.Add(_sleep_frames);
+			hasher.Add(_solver_iterations);
+			hasher.Add(_sleep_enabled);
+			return hasher.value;
+		case SectionBodyGroups:
+			hasher.AddBytes(_body_groups.begin(), _body_groups.size() * sizeof(Identifier));
+			return hasher.value;
+		case SectionGroupShapes:
+			for (const GroupShape& entry : _group_shapes) {
+				hasher.Add(entry.shape_id);
+				HashShape(hasher, entry.shape);
+			}
+			return hasher.value;
+		case SectionShapeGroups:
+			return HashSparseSet(_shape_groups, [](StateHasher& h, const ShapeGroup& group) {
+				h.Add(group.owner_body);
+				h.Add(group.shape_start);
+				h.Add(group.shape_count);
+				h.Add(group.layer);
+				h.Add(group.mask);
+				h.Add(group.is_trigger);
+			});
+		case SectionShapes:
+			return HashSparseSet(_shapes, HashShape);
+		case SectionOBBs:
+			return HashSparseSet(_obbs, [](StateHasher& h, const OBB& obb) { h.Add(obb); });
+		case SectionSpheres:
+			return HashSparseSet(_spheres, [](StateHasher& h, const Sphere& sphere) { h.Add(sphere); });
+		case SectionCapsules:
+			return HashSparseSet(_capsules, [](StateHasher& h, const Capsule& capsule) { h.Add(capsule); });
+		case SectionContacts:
+			// ContactPair spells out its padding, the whole cache goes in at once
+			static_assert(sizeof(ContactPair) == 4 * sizeof(Identifier) + 2 * sizeof(Vec3) + 2 * sizeof(Unit) + 4,
+				"ContactPair must not have implicit padding");
+			hasher.AddBytes(_contact_cache.begin(), _contact_cache.size() * sizeof(ContactPair));
+			return hasher.value;
+		default:
+			return hasher.value;
+		}
+	}
+
+	uint64_t World::BodyHash(Identifier id) const {
+		if (!_bodies.contains(id)) {
+			throw std::out_of_range("Invalid ID");
+		}
+		return HashBodyAt(_bodies.index_unchecked(id));
+	}
+
+	uint64_t World::HashBodyAt(uint32_t index) const {
+		const Identifier id = _bodies.entity_id(index);
+		const BodyInfo& info = _bodies.column<Info>()[index];
+		// packed so the motion state goes through the word loop in one piece.
+		// The generation is left out, it only tells handles apart and a peer
+		// that rolled back hands out different ones for the same state.
+		struct {
+			Vec3 position, velocity, acceleration;
+			Mat3 rotation;
+			int32_t id;
+			uint16_t idle_frames;
+			uint8_t is_static, awake;
+		} motion = {
+			_bodies.column<Position>()[index],
+			_bodies.column<Velocity>()[index],
+			_bodies.column<Acceleration>()[index],
+			_bodies.column<Rotation>()[index],
+			id,
+			info.idle_frames,
+			info.is_static,
+			index < _bodies.active_size(),
+		};
+		static_assert(sizeof(motion) == 3 * sizeof(Vec3) + sizeof(Mat3) + 8, "body hash input must not have padding");
+
+		StateHasher hasher;
+		hasher.Add(motion);
+		hasher.AddBytes(_body_groups.begin() + info.group_start, info.group_count * sizeof(Identifier));
+		// never 0, which stands for a body outside the sum
+		return MixHash(hasher.value) | 1;
+	}
+
+	uint64_t World::BodyHash(BodyHandle handle) const {
+		return BodyHash(Resolve(handle));
+	}
+
+	uint32_t World::GetBodyCount() const {
+		return _bodies.size();
+	}
+
+	Identifier World::GetBodyId(uint32_t index) const {
+		if (index >= _bodies.size()) throw std::out_of_range("Invalid ID");
+		return _bodies.entity_id(index);
+	}
+
+	uint64_t World::StateHash() {
+		if (_hash_all_bodies) {
+			_body_hashes.clear();
+			_body_hash_sum = 0;
+			for (uint32_t i = 0; i < _bodies.size(); i++) {
+				UpdateBodyHash(_bodies.entity_id(i), HashBodyAt(i));
+			}
+			_hash_all_bodies = false;
+		}
+
+		// bodies touched outside of integration, then everything integration moves
+		for (uint32_t i = 0; i < _hash_dirty_bodies.size(); i++) {
+			const Identifier id = _hash_dirty_bodies[i];
+			_hash_dirty_flags[id] = 0;
+			UpdateBodyHash(id, _bodies.contains(id) ? HashBodyAt(_bodies.index_unchecked(id)) : 0);
+		}
+		_hash_dirty_bodies.clear();
+
+		const BodyInfo* infos = _bodies.column<Info>().data();
+		for (uint32_t i = 0; i < _bodies.active_size(); i++) {
+			if (!infos[i].is_static) UpdateBodyHash(_bodies.entity_id(i), HashBodyAt(i));
+		}
+
+		StateHasher hasher;
+		hasher.Add(_body_hash_sum);
+		hasher.Add(_bodies.size());
+		hasher.Add(_bodies.active_size());
+		hasher.Add(_bodies.next_id());
+		hasher.AddBytes(_bodies.free_ids().begin(), _bodies.free_ids().size() * sizeof(Identifier));
+
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			const SnapshotSection section = static_cast<SnapshotSection>(s);
+			if (section == SectionBodies) continue;
+
+			// settings and contacts carry no versions and are cheap to rehash
+			const bool versioned = section != SectionSettings && section != SectionContacts;
+			if (!versioned || !_section_hashed[s] || _hashed_versions[s] != _section_versions[s]) {
+				_section_hashes[s] = SectionHash(section);
+				_hashed_versions[s] = _section_versions[s];
+				_section_hashed[s] = true;
+			}
+			hasher.Add(_section_hashes[s]);
+		}
+		return hasher.value;
+	}
+
+	void World::LoadCompact(MemStream& stream) {
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			ReadSection(static_cast<SnapshotSection>(s), stream);
+		}
+
+		const uint8_t* table = stream.read_bytes(SectionCount * SECTION_ENTRY_BYTES);
+		if (!table) throw std::out_of_range("Snapshot too short");
+		SnapshotSectionEntry entries[SectionCount];
+		ReadSectionTable(table, entries, SectionCount);
+
+		// versions travel with the data, the clock only moves forward
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			_section_versions[s] = entries[s].version;
+			_version_clock = std::max(_version_clock, entries[s].version);
+		}
+	}
+
+	void World::LoadChunked(MemStream& stream) {
 		_bodies.load(stream);
 		_shape_groups.load(stream);
 		_shapes.load(stream);
 
-		_links.load(stream);
+		load_vec(_body_groups, stream);
+		load_vec(_group_shapes, stream);
 
 		_obbs.load(stream);
 		_spheres.load(stream);
@@ -228,129 +1217,452 @@ namespace GekkoPhysics {
 
 		chunk_data = stream.read_chunk(chunk_size);
 		std::memcpy(&_solver_iterations, chunk_data, chunk_size);
+
+		chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_broadphase, chunk_data, chunk_size);
+
+		chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_sleep_enabled, chunk_data, chunk_size);
+
+		chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_sleep_velocity, chunk_data, chunk_size);
+
+		chunk_data = stream.read_chunk(chunk_size);
+		std::memcpy(&_sleep_frames, chunk_data, chunk_size);
+		load_vec(_contact_cache, stream);
+
+		_tree.Load(stream);
+		_grid.Load(stream);
+
+		// chunked snapshots carry no versions
+		for (uint8_t s = 0; s < SectionCount; s++) {
+			MarkDirty(static_cast<SnapshotSection>(s));
+		}
+	}
+
+	static uint64_t ProfileClock() {
+		const auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
 	}
 
 	void World::Update() {
+		if (_profiling) _profile_mark = ProfileClock();
+		const uint64_t start = _profile_mark;
+		_frame_arena.reset();
+
+		if (_body_group_holes > 0) CompactBodyGroups();
+		if (_group_shape_holes > 0) CompactGroupShapes();
+
 		const Unit dt = 1 / _update_rate;
-		for (auto& body : _bodies) {
-			if (body.is_static) continue;
-			body.velocity += body.acceleration * dt;
-			body.position += body.velocity * dt;
+		Vec3* positions = _bodies.column<Position>().data();
+		Vec3* velocities = _bodies.column<Velocity>().data();
+		const Vec3* accelerations = _bodies.column<Acceleration>().data();
+		const BodyInfo* infos = _bodies.column<Info>().data();
+		bool integrated = false;
+		for (uint32_t i = 0; i < _bodies.active_size(); i++) {
+			if (infos[i].is_static) continue;
+			velocities[i] += accelerations[i] * dt;
+			positions[i] += velocities[i] * dt;
+			integrated = true;
 		}
+		// the solver and sleep only touch awake dynamic bodies, so a world that
+		// is all static or asleep keeps referring to the bodies of its key
+		if (integrated) MarkDirty(SectionBodies);
+		ProfileStage(_profile.integrate);
 
 		CheckCollisions();
+		BuildIslands();
+		ProfileStage(_profile.islands);
 		ResolveCollisions();
+		ProfileStage(_profile.solve);
+		UpdateSleep();
+		ProfileStage(_profile.sleep);
+
+		if (_profiling) _profile.total = _profile_mark - start;
+	}
+
+	void World::ProfileStage(uint64_t& stage_ns) {
+		if (!_profiling) return;
+		const uint64_t now = ProfileClock();
+		stage_ns = now - _profile_mark;
+		_profile_mark = now;
+	}
+
+	static void ApplyCorrection(const BodyRef& a, const BodyRef& b, const Vec3& normal, const Unit& correction) {
+		if (a.is_static) {
+			b.position += normal * correction;
+		} else if (b.is_static) {
+			a.position -= normal * correction;
+		} else {
+			Unit half_corr = correction / Unit{2};
+			a.position -= normal * half_corr;
+			b.position += normal * half_corr;
+		}
+	}
+
+	// Order independent key of two shapes in a contact.
+	static uint64_t ContactKey(Identifier shape_a, Identifier shape_b) {
+		uint32_t a = static_cast<uint32_t>(shape_a);
+		uint32_t b = static_cast<uint32_t>(shape_b);
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	static uint64_t ContactKey(const ContactPair& contact) {
+		return ContactKey(contact.shape_a, contact.shape_b);
 	}
 
 	void World::ResolveCollisions() {
 		const Unit zero{0};
-		const Unit two{2};
-		const Unit correction_factor = Unit{2} / Unit{5}; // 0.4
-		const Unit slop = Unit{1} / Unit{100}; // 0.01
+
+		WarmStartContacts();
 
 		// Precompute target separation for each contact so we can
 		// re-evaluate effective depth each iteration as positions change.
 		// target = (b.pos - a.pos).Dot(normal) + depth  (projection at zero-overlap)
-		Vec<Unit> targets;
+		Unit* targets = _frame_arena.alloc<Unit>(_contacts.size());
 		for (uint32_t i = 0; i < _contacts.size(); i++) {
 			const ContactPair& contact = _contacts[i];
-			if (contact.is_trigger) {
-				targets.push_back(zero);
+			if (!IsSolvable(contact)) {
+				targets[i] = zero;
 				continue;
 			}
-			const Body& a = _bodies.get(contact.body_a);
-			const Body& b = _bodies.get(contact.body_b);
+			ConstBodyRef a = ReadBody(contact.body_a);
+			ConstBodyRef b = ReadBody(contact.body_b);
 			Unit proj = (b.position - a.position).Dot(contact.normal);
-			targets.push_back(proj + contact.depth);
+			targets[i] = proj + contact.depth;
+		}
+
+		// islands share no dynamic bodies, each one converges on its own
+		for (uint32_t i = 0; i < _islands.size(); i++) {
+			SolveIsland(_islands[i], targets);
 		}
 
-		// Position correction — multiple iterations for convergence
-		for (uint8_t iter = 0; iter < _solver_iterations; iter++) {
-			for (uint32_t i = 0; i < _contacts.size(); i++) {
-				const ContactPair& contact = _contacts[i];
-				if (contact.is_trigger) continue;
+		StoreContactCache();
+	}
+
+	void World::SolveIsland(Island& island, const Unit* targets) {
+		const Unit zero{0};
+		const Unit two{2};
+		const Unit correction_factor = Unit{2} / Unit{5}; // 0.4
+		const Unit slop = Unit{1} / Unit{100}; // 0.01
+		const uint32_t contact_end = island.contact_start + island.contact_count;
+
+		// Warm start — reapply last frame's correction, clamped so it never
+		// pushes past the current penetration. Resting contacts are mostly
+		// solved here and the iterations below only mop up the remainder.
+		for (uint32_t i = island.contact_start; i < contact_end; i++) {
+			const uint32_t index = _island_contacts[i];
+			ContactPair& contact = _contacts[index];
+
+			Unit warm = contact.correction;
+			contact.correction = zero;
+			if (warm <= zero) continue;
+
+			BodyRef a = AccessBody(contact.body_a);
+			BodyRef b = AccessBody(contact.body_b);
+
+			Unit current_proj = (b.position - a.position).Dot(contact.normal);
+			Unit pen = targets[index] - current_proj - slop;
+			if (pen <= zero) continue;
+
+			Unit correction = warm < pen ? warm : pen;
+			ApplyCorrection(a, b, contact.normal, correction);
+			contact.correction = correction;
+		}
 
-				Body& a = _bodies.get(contact.body_a);
-				Body& b = _bodies.get(contact.body_b);
+		// Position correction — iterate until nothing in the island moves
+		island.iterations = 0;
+		while (island.iterations < _solver_iterations) {
+			island.iterations++;
+			bool corrected = false;
+			for (uint32_t i = island.contact_start; i < contact_end; i++) {
+				const uint32_t index = _island_contacts[i];
+				ContactPair& contact = _contacts[index];
+
+				BodyRef a = AccessBody(contact.body_a);
+				BodyRef b = AccessBody(contact.body_b);
 
 				// Recompute effective depth from current positions
 				Unit current_proj = (b.position - a.position).Dot(contact.normal);
-				Unit effective_depth = targets[i] - current_proj;
+				Unit effective_depth = targets[index] - current_proj;
 
 				Unit pen = effective_depth - slop;
 				if (pen <= zero) continue;
 				Unit correction = pen * correction_factor;
 
-				if (a.is_static) {
-					b.position += contact.normal * correction;
-				} else if (b.is_static) {
-					a.position -= contact.normal * correction;
-				} else {
-					Unit half_corr = correction / two;
-					a.position -= contact.normal * half_corr;
-					b.position += contact.normal * half_corr;
-				}
+				ApplyCorrection(a, b, contact.normal, correction);
+				contact.correction += correction;
+				corrected = true;
+			}
+			if (!corrected) break;
+		}
+
+		// Velocity correction — single pass after position settled
+		// Normal points from a toward b, so positive v_rel_n means approaching
+		for (uint32_t i = island.contact_start; i < contact_end; i++) {
+			const ContactPair& contact = _contacts[_island_contacts[i]];
+
+			BodyRef a = AccessBody(contact.body_a);
+			BodyRef b = AccessBody(contact.body_b);
+
+			Unit v_rel_n = (a.velocity - b.velocity).Dot(contact.normal);
+			if (v_rel_n <= zero) continue; // separating or still
+
+			if (a.is_static) {
+				b.velocity += contact.normal * v_rel_n;
+			} else if (b.is_static) {
+				a.velocity -= contact.normal * v_rel_n;
+			} else {
+				Unit half_v = v_rel_n / two;
+				a.velocity -= contact.normal * half_v;
+				b.velocity += contact.normal * half_v;
+			}
+		}
+	}
+
+	void World::WarmStartContacts() {
+		// a cached correction is only reused while the normal stays roughly the same
+		const Unit min_alignment = Unit{9} / Unit{10};
+
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			ContactPair& contact = _contacts[i];
+			if (contact.is_trigger) continue;
+
+			const ContactPair* cached = FindCachedContact(contact.shape_a, contact.shape_b);
+			if (!cached) continue;
+
+			// same pair reported the other way around has a flipped normal
+			Unit alignment = cached->normal.Dot(contact.normal);
+			if (cached->shape_a != contact.shape_a) alignment = Unit{0} - alignment;
+			if (alignment < min_alignment) continue;
+
+			contact.correction = cached->correction;
+		}
+	}
+
+	const ContactPair* World::FindCachedContact(Identifier shape_a, Identifier shape_b) const {
+		// binary search, the cache is sorted by key
+		const uint64_t key = ContactKey(shape_a, shape_b);
+		uint32_t lo = 0, hi = _contact_cache.size();
+		while (lo < hi) {
+			uint32_t mid = (lo + hi) / 2;
+			if (ContactKey(_contact_cache[mid]) < key) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if (lo == _contact_cache.size() || ContactKey(_contact_cache[lo]) != key) return nullptr;
+		return &_contact_cache[lo];
+	}
+
+	void World::StoreContactCache() {
+		// triggers are kept too, sleeping bodies replay them from here
+		_contact_cache.clear();
+		_contact_cache.push_back_range(_contacts);
+		std::sort(_contact_cache.begin(), _contact_cache.end(), [](const ContactPair& a, const ContactPair& b) {
+			return ContactKey(a) < ContactKey(b);
+		});
+	}
+
+	BodyRef World::EditBody(Identifier id) {
+		if (!_bodies.contains(id)) {
+			throw std::out_of_range("Invalid ID");
+		}
+		MarkDirty(SectionBodies);
+		MarkBodyHash(id);
+		const BodyInfo& info = _bodies.get<Info>(id);
+		if (info.is_static) {
+			// only what rested on the moved groups wakes up, on the next Update
+			for (uint32_t i = 0; i < info.group_count; i++) {
+				TouchShapeGroup(_body_groups[info.group_start + i]);
 			}
+		} else {
+			// waking may move the body inside the dense columns
+			WakeBody(id);
 		}
+		return AccessBody(id);
+	}
 
-		// Velocity correction — single pass after position settled
-		// Normal points from a toward b, so positive v_rel_n means approaching
-		for (uint32_t i = 0; i < _contacts.size(); i++) {
-			const ContactPair& contact = _contacts[i];
-			if (contact.is_trigger) continue;
+	BodyRef World::EditBody(BodyHandle handle) {
+		return EditBody(Resolve(handle));
+	}
 
-			Body& a = _bodies.get(contact.body_a);
-			Body& b = _bodies.get(contact.body_b);
+	ConstBodyRef World::GetBody(Identifier id) const {
+		if (!_bodies.contains(id)) {
+			throw std::out_of_range("Invalid ID");
+		}
+		return ReadBody(id);
+	}
 
-			Unit v_rel_n = (a.velocity - b.velocity).Dot(contact.normal);
-			if (v_rel_n <= zero) continue; // separating or still
+	ConstBodyRef World::GetBody(BodyHandle handle) const {
+		return GetBody(Resolve(handle));
+	}
 
-			if (a.is_static) {
-				b.velocity += contact.normal * v_rel_n;
-			} else if (b.is_static) {
-				a.velocity -= contact.normal * v_rel_n;
-			} else {
-				Unit half_v = v_rel_n / two;
-				a.velocity -= contact.normal * half_v;
-				b.velocity += contact.normal * half_v;
-			}
-		}
+	BodyRef World::AccessBody(Identifier id) {
+		const uint32_t index = _bodies.index_unchecked(id);
+		return {
+			_bodies.column<Position>()[index],
+			_bodies.column<Velocity>()[index],
+			_bodies.column<Acceleration>()[index],
+			_bodies.column<Rotation>()[index],
+			_bodies.column<Info>()[index].is_static,
+		};
+	}
+
+	ConstBodyRef World::ReadBody(Identifier id) const {
+		const uint32_t index = _bodies.index_unchecked(id);
+		return {
+			_bodies.column<Position>()[index],
+			_bodies.column<Velocity>()[index],
+			_bodies.column<Acceleration>()[index],
+			_bodies.column<Rotation>()[index],
+			_bodies.column<Info>()[index].is_static,
+		};
 	}
 
-	Identifier World::CreateLink() {
-		auto link = Link();
-		link.Reset();
-		return _links.insert(link);
+	ShapeGroupRef World::EditShapeGroup(Identifier id) {
+		ShapeGroup& group = _shape_groups.get(id);
+		MarkDirty(SectionShapeGroups);
+		TouchShapeGroup(id);
+		return { group.layer, group.mask, group.is_trigger };
 	}
 
-	Body& World::GetBody(Identifier id) {
-		return _bodies.get(id);
+	ShapeGroupRef World::EditShapeGroup(ShapeGroupHandle handle) {
+		return EditShapeGroup(Resolve(handle));
 	}
 
-	ShapeGroup& World::GetShapeGroup(Identifier id) {
+	const ShapeGroup& World::GetShapeGroup(Identifier id) const {
 		return _shape_groups.get(id);
 	}
 
-	Shape& World::GetShape(Identifier id) {
+	const ShapeGroup& World::GetShapeGroup(ShapeGroupHandle handle) const {
+		return GetShapeGroup(Resolve(handle));
+	}
+
+	const Shape& World::GetShape(Identifier id) const {
 		return _shapes.get(id);
 	}
 
+	const Shape& World::GetShape(ShapeHandle handle) const {
+		return GetShape(Resolve(handle));
+	}
+
 	Sphere& World::GetSphere(Identifier id) {
-		return _spheres.get(id);
+		Sphere& sphere = _spheres.get(id);
+		MarkDirty(SectionSpheres);
+		TouchShape(Shape::Sphere, id);
+		return sphere;
 	}
 
 	OBB& World::GetOBB(Identifier id) {
-		return _obbs.get(id);
+		OBB& obb = _obbs.get(id);
+		MarkDirty(SectionOBBs);
+		TouchShape(Shape::OBB, id);
+		return obb;
 	}
 
 	Capsule& World::GetCapsule(Identifier id) {
+		Capsule& capsule = _capsules.get(id);
+		MarkDirty(SectionCapsules);
+		TouchShape(Shape::Capsule, id);
+		return capsule;
+	}
+
+	const Sphere& World::GetSphere(Identifier id) const {
+		return _spheres.get(id);
+	}
+
+	const OBB& World::GetOBB(Identifier id) const {
+		return _obbs.get(id);
+	}
+
+	const Capsule& World::GetCapsule(Identifier id) const {
 		return _capsules.get(id);
 	}
 
+	void World::TouchShapeGroup(Identifier group_id) {
+		const Identifier owner = _shape_groups.get_unchecked(group_id).owner_body;
+		if (!_bodies.get<Info>(owner).is_static) {
+			WakeBody(owner);
+			return;
+		}
+		// a static group not cached yet is already waiting for the rebuild
+		if (!IsStaticGroupCached(group_id)) return;
+
+		const uint32_t id = static_cast<uint32_t>(group_id);
+		while (id >= _touched_static_flags.size()) {
+			_touched_static_flags.push_back(0);
+		}
+		if (_touched_static_flags[id]) return;
+		_touched_static_flags[id] = 1;
+		_touched_static_groups.push_back(group_id);
+	}
+
+	void World::TouchShape(Shape::Type type, Identifier shape_type_id) {
+		const Vec<Identifier>& owners = _typed_shape_groups[type];
+		const uint32_t id = static_cast<uint32_t>(shape_type_id);
+		if (id >= owners.size() || owners[id] == INVALID_ID) return;
+		TouchShapeGroup(owners[id]);
+	}
+
+	void World::SetShapeGroupOwner(const Shape& shape, Identifier group_id) {
+		Vec<Identifier>& owners = _typed_shape_groups[shape.type];
+		const uint32_t id = static_cast<uint32_t>(shape.shape_type_id);
+		while (id >= owners.size()) {
+			owners.push_back(INVALID_ID);
+		}
+		owners[id] = group_id;
+	}
+
+	void World::RebuildShapeGroupOwners() {
+		for (auto& owners : _typed_shape_groups) {
+			owners.clear();
+		}
+		for (uint32_t i = 0; i < _shape_groups.size(); i++) {
+			const Identifier group_id = _shape_groups.entity_id(i);
+			const ShapeGroup& group = _shape_groups.get_unchecked(group_id);
+			const uint32_t shape_end = group.shape_start + group.shape_count;
+			for (uint32_t s = group.shape_start; s < shape_end; s++) {
+				SetShapeGroupOwner(_group_shapes[s].shape, group_id);
+			}
+		}
+	}
+
 	const Vec<ContactPair>& World::GetContacts() const {
 		return _contacts;
 	}
 
+	const Vec<Island>& World::GetIslands() const {
+		return _islands;
+	}
+
+	Identifier World::GetIslandBody(const Island& island, uint32_t index) const {
+		if (index >= island.body_count) throw std::out_of_range("Invalid ID");
+		return _island_bodies[island.body_start + index];
+	}
+
+	const ContactPair& World::GetIslandContact(const Island& island, uint32_t index) const {
+		if (index >= island.contact_count) throw std::out_of_range("Invalid ID");
+		return _contacts[_island_contacts[island.contact_start + index]];
+	}
+
+	const AABB& World::GetShapeAABB(Identifier shape_id) const {
+		if (!IsShapeCached(shape_id)) {
+			throw std::out_of_range("Invalid ID");
+		}
+		return _shape_cache[shape_id].aabb;
+	}
+
+	void World::SetProfiling(bool enabled) {
+		_profiling = enabled;
+		_profile = StepProfile();
+	}
+
+	const StepProfile& World::GetProfile() const {
+		return _profile;
+	}
+
 	void World::SetDebugDraw(DebugDraw* dd) {
 		_debug_draw = dd;
 	}
@@ -365,13 +1677,18 @@ namespace GekkoPhysics {
 			for (const auto& ga : _group_aabbs) {
 				_debug_draw->DrawAABB(ga.aabb.min.AsFloat(), ga.aabb.max.AsFloat());
 			}
+			for (const auto& ga : _static_aabbs) {
+				_debug_draw->DrawAABB(ga.aabb.min.AsFloat(), ga.aabb.max.AsFloat());
+			}
 		}
 
 		// Iterate bodies
-		const uint32_t body_count = _bodies.active_size();
+		// sleeping bodies sit in the disabled range, draw them too
+		const uint32_t body_count = _bodies.size();
 		for (uint32_t body_idx = 0; body_idx < body_count; body_idx++) {
 			Identifier body_id = _bodies.entity_id(body_idx);
-			const Body& body = _bodies.get(body_id);
+			ConstBodyRef body = ReadBody(body_id);
+			const BodyInfo& info = _bodies.get<Info>(body_id);
 
 			// Body origins
 			if (flags & DrawFlag_BodyOrigins) {
@@ -384,35 +1701,30 @@ namespace GekkoPhysics {
 			}
 
 			// Iterate shape groups
-			if (body.link_shape_groups == INVALID_ID) continue;
-			const auto& group_link = _links.get(body.link_shape_groups);
-
-			for (size_t group_idx = 0; group_idx < Link::NUM_LINKS; group_idx++) {
-				Identifier group_id = group_link.children[group_idx];
-				if (group_id == INVALID_ID || !_shape_groups.contains(group_id)) continue;
-				const ShapeGroup& group = _shape_groups.get(group_id);
+			const uint32_t group_end = info.group_start + info.group_count;
+			for (uint32_t group_idx = info.group_start; group_idx < group_end; group_idx++) {
+				const ShapeGroup& group = _shape_groups.get_unchecked(_body_groups[group_idx]);
 
 				// Shapes
 				if (flags & DrawFlag_Shapes) {
-					if (group.link_shapes == INVALID_ID) continue;
-					const auto& shape_link = _links.get(group.link_shapes);
-
-					for (size_t shape_idx = 0; shape_idx < Link::NUM_LINKS; shape_idx++) {
-						Identifier shape_id = shape_link.children[shape_idx];
-						if (shape_id == INVALID_ID || !_shapes.contains(shape_id)) continue;
-						const Shape& shape = _shapes.get(shape_id);
+					const uint32_t shape_end = group.shape_start + group.shape_count;
+					for (uint32_t shape_idx = group.shape_start; shape_idx < shape_end; shape_idx++) {
+						const Identifier shape_id = _group_shapes[shape_idx].shape_id;
+						const Shape& shape = _group_shapes[shape_idx].shape;
 
+						// prefer the transform cache, fall back for shapes not simulated yet
+						const bool cached = IsShapeCached(shape_id);
 						switch (shape.type) {
 						case Shape::Sphere: {
-							Sphere world_sphere = WorldSphere(_spheres.get(shape.shape_type_id), body);
+							Sphere world_sphere = cached ? _world_spheres[shape.shape_type_id] : WorldSphere(_spheres.get_unchecked(shape.shape_type_id), body);
 							_debug_draw->DrawSphere(world_sphere.center.AsFloat(), static_cast<float>(world_sphere.radius));
 						} break;
 						case Shape::OBB: {
-							OBB world_obb = WorldOBB(_obbs.get(shape.shape_type_id), body);
+							OBB world_obb = cached ? _world_obbs[shape.shape_type_id] : WorldOBB(_obbs.get_unchecked(shape.shape_type_id), body);
 							_debug_draw->DrawBox(world_obb.center.AsFloat(), world_obb.half_extents.AsFloat(), world_obb.rotation.AsFloat());
 						} break;
 						case Shape::Capsule: {
-							Capsule world_capsule = WorldCapsule(_capsules.get(shape.shape_type_id), body);
+							Capsule world_capsule = cached ? _world_capsules[shape.shape_type_id] : WorldCapsule(_capsules.get_unchecked(shape.shape_type_id), body);
 							_debug_draw->DrawCapsule(world_capsule.start.AsFloat(), world_capsule.end.AsFloat(), static_cast<float>(world_capsule.radius));
 						} break;
 						default: break;
@@ -435,14 +1747,14 @@ namespace GekkoPhysics {
 		}
 	}
 
-	Sphere World::WorldSphere(const Sphere& local, const Body& body) const {
+	Sphere World::WorldSphere(const Sphere& local, const ConstBodyRef& body) const {
 		Sphere world;
 		world.center = body.rotation.TransformPoint(local.center, body.position);
 		world.radius = local.radius;
 		return world;
 	}
 
-	OBB World::WorldOBB(const OBB& local, const Body& body) const {
+	OBB World::WorldOBB(const OBB& local, const ConstBodyRef& body) const {
 		OBB world;
 		world.center = body.rotation.TransformPoint(local.center, body.position);
 		world.rotation = body.rotation * local.rotation;
@@ -450,7 +1762,7 @@ namespace GekkoPhysics {
 		return world;
 	}
 
-	Capsule World::WorldCapsule(const Capsule& local, const Body& body) const {
+	Capsule World::WorldCapsule(const Capsule& local, const ConstBodyRef& body) const {
 		Capsule world;
 		world.start = body.rotation.TransformPoint(local.start, body.position);
 		world.end = body.rotation.TransformPoint(local.end, body.position);
@@ -462,84 +1774,112 @@ namespace GekkoPhysics {
 		return (a << 2) | b;
 	}
 
-	CollisionResult World::CollideShapes(const Shape& a, const Body& body_a, const Shape& b, const Body& body_b) const {
-		// normalize order so first.type <= second.type (OBB=1 < Sphere=2 < Capsule=3)
-		bool swapped = a.type > b.type;
-		const Shape& first  = swapped ? b : a;
-		const Shape& second = swapped ? a : b;
-		const Body& first_body  = swapped ? body_b : body_a;
-		const Body& second_body = swapped ? body_a : body_b;
-
-		CollisionResult result;
-		switch (ShapePair(first.type, second.type)) {
-		case ShapePair(Shape::OBB, Shape::OBB): {
-			result = Algo::CollideOBBs(
-				WorldOBB(_obbs.get(first.shape_type_id), first_body),
-				WorldOBB(_obbs.get(second.shape_type_id), second_body));
-		} break;
-		case ShapePair(Shape::OBB, Shape::Sphere): {
-			result = Algo::CollideSphereOBB(
-				WorldSphere(_spheres.get(second.shape_type_id), second_body),
-				WorldOBB(_obbs.get(first.shape_type_id), first_body));
-			swapped = !swapped;
-		} break;
-		case ShapePair(Shape::OBB, Shape::Capsule): {
-			result = Algo::CollideCapsuleOBB(
-				WorldCapsule(_capsules.get(second.shape_type_id), second_body),
-				WorldOBB(_obbs.get(first.shape_type_id), first_body));
-			swapped = !swapped;
-		} break;
-		case ShapePair(Shape::Sphere, Shape::Sphere): {
-			result = Algo::CollideSpheres(
-				WorldSphere(_spheres.get(first.shape_type_id), first_body),
-				WorldSphere(_spheres.get(second.shape_type_id), second_body));
-		} break;
-		case ShapePair(Shape::Sphere, Shape::Capsule): {
-			result = Algo::CollideSphereCapsule(
-				WorldSphere(_spheres.get(first.shape_type_id), first_body),
-				WorldCapsule(_capsules.get(second.shape_type_id), second_body));
-		} break;
-		case ShapePair(Shape::Capsule, Shape::Capsule): {
-			result = Algo::CollideCapsules(
-				WorldCapsule(_capsules.get(first.shape_type_id), first_body),
-				WorldCapsule(_capsules.get(second.shape_type_id), second_body));
-		} break;
-		default: return result;
-		}
-
-		if (swapped) result.normal = Vec3(Unit{0}, Unit{0}, Unit{0}) - result.normal;
-		return result;
+	// Runs one collision routine over every pair of its bucket.
+	template <typename Tasks, typename Collide>
+	static void CollideBucket(const Tasks& tasks, CollisionResult* results, Collide collide) {
+		const Vec3 zero(Unit{0}, Unit{0}, Unit{0});
+		for (const auto& task : tasks) {
+			CollisionResult result = collide(task.first, task.second);
+			if (task.flip) result.normal = zero - result.normal;
+			results[task.candidate] = result;
+		}
 	}
 
-	AABB World::ComputeShapeGroupAABB(const ShapeGroup& group, const Body& body) const {
-		AABB result;
-		bool first = true;
+	void World::RunNarrowphaseBatch(NarrowphaseBatch& batch, Vec<ContactPair>& out_contacts) const {
+		batch.results.resize(batch.candidates.size());
+		CollisionResult* results = batch.results.data();
+
+		CollideBucket(batch.buckets[OBBOBB], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideOBBs(_world_obbs[a], _world_obbs[b]);
+		});
+		CollideBucket(batch.buckets[OBBSphere], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideSphereOBB(_world_spheres[a], _world_obbs[b]);
+		});
+		CollideBucket(batch.buckets[OBBCapsule], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideCapsuleOBB(_world_capsules[a], _world_obbs[b]);
+		});
+		CollideBucket(batch.buckets[SphereSphere], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideSpheres(_world_spheres[a], _world_spheres[b]);
+		});
+		CollideBucket(batch.buckets[SphereCapsule], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideSphereCapsule(_world_spheres[a], _world_capsules[b]);
+		});
+		CollideBucket(batch.buckets[CapsuleCapsule], results, [this](Identifier a, Identifier b) {
+			return Algo::CollideCapsules(_world_capsules[a], _world_capsules[b]);
+		});
+
+		// gather order, which does not depend on how the pairs were bucketed
+		for (uint32_t i = 0; i < batch.candidates.size(); i++) {
+			const ShapePairCandidate& candidate = batch.candidates[i];
+			if (candidate.resting) {
+				const ContactPair* cached = FindCachedContact(candidate.shape_a, candidate.shape_b);
+				if (cached) out_contacts.push_back(*cached);
+				continue;
+			}
+
+			const CollisionResult& result = results[i];
+			if (!result.hit) continue;
+
+			ContactPair contact;
+			contact.body_a = candidate.body_a;
+			contact.body_b = candidate.body_b;
+			contact.shape_a = candidate.shape_a;
+			contact.shape_b = candidate.shape_b;
+			contact.normal = result.normal;
+			contact.point = result.point;
+			contact.depth = result.depth;
+			contact.is_trigger = candidate.is_trigger;
+			out_contacts.push_back(contact);
+		}
+
+		batch.candidates.clear();
+		for (auto& bucket : batch.buckets) {
+			bucket.clear();
+		}
+	}
 
-		if (group.link_shapes == INVALID_ID) return result;
-		const auto& link = _links.get(group.link_shapes);
+	template <typename T>
+	static void GrowTo(Vec<T>& vec, Identifier id) {
+		while (static_cast<uint32_t>(id) >= vec.size()) {
+			vec.push_back({});
+		}
+	}
 
-		for (size_t i = 0; i < Link::NUM_LINKS; i++) {
-			Identifier shape_id = link.children[i];
-			if (shape_id == INVALID_ID) continue;
-			if (!_shapes.contains(shape_id)) continue;
+	AABB World::TransformShapeGroup(const ShapeGroup& group, const ConstBodyRef& body) {
+		AABB result;
+		bool first = true;
 
-			const auto& shape = _shapes.get(shape_id);
+		const uint32_t shape_end = group.shape_start + group.shape_count;
+		for (uint32_t i = group.shape_start; i < shape_end; i++) {
+			const Identifier shape_id = _group_shapes[i].shape_id;
+			const Shape& shape = _group_shapes[i].shape;
+			const Identifier type_id = shape.shape_type_id;
 			AABB shape_aabb;
 
 			switch (shape.type) {
 			case Shape::Sphere:
-				shape_aabb = Algo::ComputeAABB(WorldSphere(_spheres.get(shape.shape_type_id), body));
+				GrowTo(_world_spheres, type_id);
+				_world_spheres[type_id] = WorldSphere(_spheres.get_unchecked(type_id), body);
+				shape_aabb = Algo::ComputeAABB(_world_spheres[type_id]);
 				break;
 			case Shape::Capsule:
-				shape_aabb = Algo::ComputeAABB(WorldCapsule(_capsules.get(shape.shape_type_id), body));
+				GrowTo(_world_capsules, type_id);
+				_world_capsules[type_id] = WorldCapsule(_capsules.get_unchecked(type_id), body);
+				shape_aabb = Algo::ComputeAABB(_world_capsules[type_id]);
 				break;
 			case Shape::OBB:
-				shape_aabb = Algo::ComputeAABB(WorldOBB(_obbs.get(shape.shape_type_id), body));
+				GrowTo(_world_obbs, type_id);
+				_world_obbs[type_id] = WorldOBB(_obbs.get_unchecked(type_id), body);
+				shape_aabb = Algo::ComputeAABB(_world_obbs[type_id]);
 				break;
 			default:
 				continue;
 			}
 
+			GrowTo(_shape_cache, shape_id);
+			_shape_cache[shape_id].aabb = shape_aabb;
+			_shape_cache[shape_id].valid = true;
+
 			if (first) {
 				result = shape_aabb;
 				first = false;
@@ -551,84 +1891,609 @@ namespace GekkoPhysics {
 		return result;
 	}
 
+	bool World::IsShapeCached(Identifier shape_id) const {
+		return shape_id >= 0 &&
+			static_cast<uint32_t>(shape_id) < _shape_cache.size() &&
+			_shape_cache[shape_id].valid;
+	}
+
+	void World::InvalidateShapeCache(Identifier shape_id) {
+		if (shape_id >= 0 && static_cast<uint32_t>(shape_id) < _shape_cache.size()) {
+			_shape_cache[shape_id].valid = false;
+		}
+	}
+
 	void World::CheckCollisions() {
 		_contacts.clear();
 		_group_aabbs.clear();
+		_group_pairs.clear();
 
+		// transform pass: every dynamic shape goes to world space exactly once per frame,
+		// static shapes only when the static geometry is rebuilt.
 		BuildGroupAABBs();
+		ProfileStage(_profile.transform);
 
-		for (uint32_t i = 0; i < _group_aabbs.size(); i++) {
-			const ShapeGroup& group_a = _shape_groups.get(_group_aabbs[i].group_id);
-			for (uint32_t j = i + 1; j < _group_aabbs.size(); j++) {
-				const ShapeGroup& group_b = _shape_groups.get(_group_aabbs[j].group_id);
+		switch (_broadphase) {
+		case BroadphaseType::SweepAndPrune:
+			_sweep_and_prune.Update(_group_aabbs, _group_pairs);
+			break;
+		case BroadphaseType::DynamicTree:
+			_tree.Update(_group_aabbs, _group_pairs);
+			break;
+		case BroadphaseType::Grid:
+			_grid.Update(_group_aabbs, _group_pairs);
+			break;
+		}
+		ProfileStage(_profile.broadphase);
 
-				if (!BroadphaseFilter(group_a, group_b, _group_aabbs[i].aabb, _group_aabbs[j].aabb)) continue;
+		uint32_t thread_count = _group_pairs.size() / MIN_PAIRS_PER_THREAD;
+		if (thread_count > _thread_count) thread_count = _thread_count;
 
-				NarrowphaseGroupPair(group_a, group_b);
-			}
+		if (thread_count <= 1) {
+			NarrowphasePairs(0, _group_pairs.size(), _batches[0], _contacts);
+		} else {
+			NarrowphasePairsParallel(static_cast<uint8_t>(thread_count));
 		}
+
+		CollideStaticGroups();
+		WakeTouchedBodies();
+		ProfileStage(_profile.narrowphase);
 	}
 
 	void World::BuildGroupAABBs() {
+		uint32_t static_count = 0;
+
 		const uint32_t group_count = _shape_groups.active_size();
 		for (uint32_t i = 0; i < group_count; i++) {
 			Identifier group_id = _shape_groups.entity_id(i);
-			const ShapeGroup& group = _shape_groups.get(group_id);
-			const Body& body = _bodies.get(group.owner_body);
+			const ShapeGroup& group = _shape_groups.get_unchecked(group_id);
+			ConstBodyRef body = ReadBody(group.owner_body);
+
+			if (body.is_static) {
+				// catches bodies that were flipped to static since the last rebuild
+				if (!IsStaticGroupCached(group_id)) _statics_dirty = true;
+				_tree.DestroyProxy(group_id);
+				static_count++;
+				continue;
+			}
 
 			GroupAABB group_aabb;
 			group_aabb.group_id = group_id;
-			group_aabb.aabb = ComputeShapeGroupAABB(group, body);
+			// sleeping bodies have not moved, reuse their cached shapes
+			if (_bodies.is_enabled(group.owner_body) || !CachedShapeGroupAABB(group, group_aabb.aabb)) {
+				group_aabb.aabb = TransformShapeGroup(group, body);
+			}
 			_group_aabbs.push_back(group_aabb);
 		}
+
+		// catches bodies that were flipped back to dynamic
+		if (static_count != _static_aabbs.size()) _statics_dirty = true;
+
+		RefitTouchedStaticGroups();
+		if (_statics_dirty) RebuildStaticGroups(true);
+	}
+
+	void World::RefitTouchedStaticGroups() {
+		// a full rebuild is coming anyway and drops the queue
+		if (_statics_dirty) return;
+
+		for (uint32_t i = 0; i < _touched_static_groups.size(); i++) {
+			const Identifier group_id = _touched_static_groups[i];
+			_touched_static_flags[group_id] = 0;
+			if (!_shape_groups.contains(group_id) || !IsStaticGroupCached(group_id)) continue;
+
+			const ShapeGroup& group = _shape_groups.get_unchecked(group_id);
+			GroupAABB& cached = _static_aabbs[_static_lookup[group_id]];
+			const AABB old_aabb = cached.aabb;
+			cached.aabb = TransformShapeGroup(group, ReadBody(group.owner_body));
+			_static_tree.DestroyProxy(group_id);
+			_static_tree.CreateProxy(group_id, cached.aabb);
+
+			// only bodies near the old or the new shape can have been resting on it
+			WakeBodiesOverlapping(old_aabb);
+			WakeBodiesOverlapping(cached.aabb);
+		}
+		_touched_static_groups.clear();
+	}
+
+	void World::RebuildStaticGroups(bool wake_bodies) {
+		_static_aabbs.clear();
+		_static_tree.Clear();
+		_static_tree.SetMargin(Unit{0});
+		for (uint32_t i = 0; i < _static_lookup.size(); i++) {
+			_static_lookup[i] = NO_INDEX;
+		}
+
+		const uint32_t group_count = _shape_groups.active_size();
+		for (uint32_t i = 0; i < group_count; i++) {
+			Identifier group_id = _shape_groups.entity_id(i);
+			const ShapeGroup& group = _shape_groups.get_unchecked(group_id);
+			ConstBodyRef body = ReadBody(group.owner_body);
+			if (!body.is_static) continue;
+
+			GroupAABB group_aabb;
+			group_aabb.group_id = group_id;
+			group_aabb.aabb = TransformShapeGroup(group, body);
+			_static_aabbs.push_back(group_aabb);
+		}
+
+		// build in id order so the tree does not depend on the dense order,
+		// which shifts whenever unrelated groups are removed.
+		std::sort(_static_aabbs.begin(), _static_aabbs.end(), [](const GroupAABB& a, const GroupAABB& b) {
+			return a.group_id < b.group_id;
+		});
+
+		for (uint32_t i = 0; i < _static_aabbs.size(); i++) {
+			const uint32_t id = static_cast<uint32_t>(_static_aabbs[i].group_id);
+			while (id >= _static_lookup.size()) {
+				_static_lookup.push_back(NO_INDEX);
+			}
+			_static_lookup[id] = i;
+			_static_tree.CreateProxy(_static_aabbs[i].group_id, _static_aabbs[i].aabb);
+		}
+
+		_statics_dirty = false;
+		for (uint32_t i = 0; i < _touched_static_groups.size(); i++) {
+			_touched_static_flags[_touched_static_groups[i]] = 0;
+		}
+		_touched_static_groups.clear();
+
+		// static geometry changed under bodies that may be resting on it
+		if (wake_bodies) WakeAllBodies();
+	}
+
+	bool World::IsStaticGroupCached(Identifier group_id) const {
+		const uint32_t id = static_cast<uint32_t>(group_id);
+		return id < _static_lookup.size() && _static_lookup[id] != NO_INDEX;
+	}
+
+	void World::MarkStaticsDirty(Identifier body_id) {
+		if (_bodies.contains(body_id) && _bodies.get<Info>(body_id).is_static) {
+			_statics_dirty = true;
+		}
+	}
+
+	void World::CollideStaticGroups() {
+		if (_static_aabbs.empty()) return;
+
+		for (uint32_t i = 0; i < _group_aabbs.size(); i++) {
+			const GroupAABB& dynamic_aabb = _group_aabbs[i];
+
+			_static_hits.clear();
+			_static_tree.Query(dynamic_aabb.aabb, _static_hits);
+			if (_static_hits.empty()) continue;
+			// refits change the tree layout, a rollback rebuilds it in id order
+			std::sort(_static_hits.begin(), _static_hits.end());
+
+			const ShapeGroup& group_a = _shape_groups.get_unchecked(dynamic_aabb.group_id);
+			for (uint32_t h = 0; h < _static_hits.size(); h++) {
+				const ShapeGroup& group_b = _shape_groups.get_unchecked(_static_hits[h]);
+				if (!BroadphaseFilter(group_a, group_b)) continue;
+
+				GatherShapePairs(group_a, group_b, _batches[0]);
+			}
+		}
+
+		RunNarrowphaseBatch(_batches[0], _contacts);
+	}
+
+	void World::NarrowphasePairs(uint32_t begin, uint32_t end, NarrowphaseBatch& batch, Vec<ContactPair>& out_contacts) const {
+		for (uint32_t i = begin; i < end; i++) {
+			const GroupPair& pair = _group_pairs[i];
+			const ShapeGroup& group_a = _shape_groups.get_unchecked(_group_aabbs[pair.a].group_id);
+			const ShapeGroup& group_b = _shape_groups.get_unchecked(_group_aabbs[pair.b].group_id);
+
+			if (!BroadphaseFilter(group_a, group_b)) continue;
+
+			GatherShapePairs(group_a, group_b, batch);
+		}
+
+		RunNarrowphaseBatch(batch, out_contacts);
+	}
+
+	void World::NarrowphasePairsParallel(uint8_t thread_count) {
+		// The pair list is split into contiguous chunks. Everything the narrowphase
+		// reads was written by the transform pass, so workers share it read-only.
+		for (uint32_t t = 1; t < thread_count; t++) {
+			_thread_contacts[t].clear();
+		}
+
+		_workers->Run(NarrowphaseJob, this, thread_count);
+		NarrowphaseJob(this, 0, thread_count);
+		_workers->Wait();
+
+		// merging in chunk order reproduces the single threaded contact list
+		for (uint32_t t = 1; t < thread_count; t++) {
+			_contacts.push_back_range(_thread_contacts[t]);
+		}
+	}
+
+	void World::NarrowphaseJob(void* world, uint32_t slot, uint32_t count) {
+		World& self = *static_cast<World*>(world);
+		const uint32_t pair_count = self._group_pairs.size();
+		const uint32_t begin = pair_count * slot / count;
+		const uint32_t end = pair_count * (slot + 1) / count;
+		// slot 0 runs on the calling thread and writes the contact list directly
+		Vec<ContactPair>& contacts = slot == 0 ? self._contacts : self._thread_contacts[slot];
+		self.NarrowphasePairs(begin, end, self._batches[slot], contacts);
+	}
+
+	World::WorkerPool::~WorkerPool() {
+		Stop();
+	}
+
+	void World::WorkerPool::Resize(uint8_t size) {
+		Stop();
+		if (size < 1) size = 1;
+		if (size > World::MAX_THREADS) size = World::MAX_THREADS;
+
+		// no worker is left, new ones must not mistake the last round for a new one
+		_stop = false;
+		_round = 0;
+		_pending = 0;
+		_size = size;
+		for (uint32_t slot = 1; slot < _size; slot++) {
+			_threads[slot] = std::thread(&World::WorkerPool::WorkerLoop, this, slot);
+		}
 	}
 
-	bool World::BroadphaseFilter(const ShapeGroup& group_a, const ShapeGroup& group_b, const AABB& aabb_a, const AABB& aabb_b) const {
+	uint8_t World::WorkerPool::Size() const {
+		return _size;
+	}
+
+	void World::WorkerPool::Run(Job job, void* context, uint32_t count) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_job = job;
+			_context = context;
+			_count = count;
+			_pending = count - 1;
+			_round++;
+		}
+		_start.notify_all();
+	}
+
+	void World::WorkerPool::Wait() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this]() { return _pending == 0; });
+	}
+
+	void World::WorkerPool::WorkerLoop(uint32_t slot) {
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true) {
+			_start.wait(lock, [this, seen]() { return _stop || _round != seen; });
+			if (_stop) return;
+			seen = _round;
+			// workers past the requested count sit this round out
+			if (slot >= _count) continue;
+
+			const Job job = _job;
+			void* context = _context;
+			const uint32_t count = _count;
+			lock.unlock();
+			job(context, slot, count);
+			lock.lock();
+
+			if (--_pending == 0) _done.notify_one();
+		}
+	}
+
+	void World::WorkerPool::Stop() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_start.notify_all();
+		for (uint32_t slot = 1; slot < _size; slot++) {
+			_threads[slot].join();
+		}
+		_size = 1;
+	}
+
+	bool World::BroadphaseFilter(const ShapeGroup& group_a, const ShapeGroup& group_b) const {
 		if (group_a.owner_body == group_b.owner_body) return false;
 		if ((group_a.layer & group_b.mask) == 0 || (group_b.layer & group_a.mask) == 0) return false;
-		if (_bodies.get(group_a.owner_body).is_static && _bodies.get(group_b.owner_body).is_static) return false;
-		if (!Algo::OverlapAABB(aabb_a, aabb_b)) return false;
+		if (_bodies.get_unchecked<Info>(group_a.owner_body).is_static && _bodies.get_unchecked<Info>(group_b.owner_body).is_static) return false;
 		return true;
 	}
 
-	void World::NarrowphaseGroupPair(const ShapeGroup& group_a, const ShapeGroup& group_b) {
-		if (group_a.link_shapes == INVALID_ID || group_b.link_shapes == INVALID_ID) return;
-
-		const auto& link_a = _links.get(group_a.link_shapes);
-		const auto& link_b = _links.get(group_b.link_shapes);
-		const Body& body_a = _bodies.get(group_a.owner_body);
-		const Body& body_b = _bodies.get(group_b.owner_body);
-
-		for (size_t shape_idx_a = 0; shape_idx_a < Link::NUM_LINKS; shape_idx_a++) {
-			Identifier shape_a_id = link_a.children[shape_idx_a];
-			if (shape_a_id == INVALID_ID || !_shapes.contains(shape_a_id)) continue;
-			const auto& shape_a = _shapes.get(shape_a_id);
-
-			for (size_t shape_idx_b = 0; shape_idx_b < Link::NUM_LINKS; shape_idx_b++) {
-				Identifier shape_b_id = link_b.children[shape_idx_b];
-				if (shape_b_id == INVALID_ID || !_shapes.contains(shape_b_id)) continue;
-				const auto& shape_b = _shapes.get(shape_b_id);
-
-				auto result = CollideShapes(shape_a, body_a, shape_b, body_b);
-				if (result.hit) {
-					ContactPair contact;
-					contact.body_a = group_a.owner_body;
-					contact.body_b = group_b.owner_body;
-					contact.shape_a = shape_a_id;
-					contact.shape_b = shape_b_id;
-					contact.normal = result.normal;
-					contact.point = result.point;
-					contact.depth = result.depth;
-					contact.is_trigger = group_a.is_trigger || group_b.is_trigger;
-					_contacts.push_back(contact);
+	void World::GatherShapePairs(const ShapeGroup& group_a, const ShapeGroup& group_b, NarrowphaseBatch& batch) const {
+		const GroupShape* shapes_a = _group_shapes.begin() + group_a.shape_start;
+		const GroupShape* shapes_b = _group_shapes.begin() + group_b.shape_start;
+
+		ShapePairCandidate candidate;
+		candidate.body_a = group_a.owner_body;
+		candidate.body_b = group_b.owner_body;
+		candidate.is_trigger = group_a.is_trigger || group_b.is_trigger;
+		// neither side can move, so last frame's contacts are still exact
+		candidate.resting = !IsMoving(group_a.owner_body) && !IsMoving(group_b.owner_body);
+
+		for (uint32_t shape_idx_a = 0; shape_idx_a < group_a.shape_count; shape_idx_a++) {
+			const Shape& shape_a = shapes_a[shape_idx_a].shape;
+			candidate.shape_a = shapes_a[shape_idx_a].shape_id;
+
+			for (uint32_t shape_idx_b = 0; shape_idx_b < group_b.shape_count; shape_idx_b++) {
+				const Shape& shape_b = shapes_b[shape_idx_b].shape;
+				candidate.shape_b = shapes_b[shape_idx_b].shape_id;
+
+				const uint32_t index = batch.candidates.size();
+				batch.candidates.push_back(candidate);
+				if (candidate.resting) continue;
+
+				// normalize order so first.type <= second.type (OBB=1 < Sphere=2 < Capsule=3)
+				const bool swapped = shape_a.type > shape_b.type;
+				const Shape& first = swapped ? shape_b : shape_a;
+				const Shape& second = swapped ? shape_a : shape_b;
+
+				ShapePairTask task;
+				task.candidate = index;
+				task.first = first.shape_type_id;
+				task.second = second.shape_type_id;
+				task.flip = swapped;
+
+				PairBucket bucket;
+				switch (ShapePair(first.type, second.type)) {
+				case ShapePair(Shape::OBB, Shape::OBB): bucket = OBBOBB; break;
+				case ShapePair(Shape::OBB, Shape::Sphere): bucket = OBBSphere; break;
+				case ShapePair(Shape::OBB, Shape::Capsule): bucket = OBBCapsule; break;
+				case ShapePair(Shape::Sphere, Shape::Sphere): bucket = SphereSphere; break;
+				case ShapePair(Shape::Sphere, Shape::Capsule): bucket = SphereCapsule; break;
+				case ShapePair(Shape::Capsule, Shape::Capsule): bucket = CapsuleCapsule; break;
+				default: batch.candidates.pop_back(); continue;
+				}
+
+				// these routines take the OBB second and report the normal the other way around
+				if (bucket == OBBSphere || bucket == OBBCapsule) {
+					task.first = second.shape_type_id;
+					task.second = first.shape_type_id;
+					task.flip = !swapped;
 				}
+				batch.buckets[bucket].push_back(task);
+			}
+		}
+	}
+
+	bool World::CachedShapeGroupAABB(const ShapeGroup& group, AABB& out_aabb) const {
+		bool first = true;
+		const uint32_t shape_end = group.shape_start + group.shape_count;
+		for (uint32_t i = group.shape_start; i < shape_end; i++) {
+			const Identifier shape_id = _group_shapes[i].shape_id;
+			if (!IsShapeCached(shape_id)) return false;
+
+			const AABB& shape_aabb = _shape_cache[shape_id].aabb;
+			out_aabb = first ? shape_aabb : Algo::UnionAABB(out_aabb, shape_aabb);
+			first = false;
+		}
+		return !first;
+	}
+
+	bool World::IsSolvable(const ContactPair& contact) const {
+		// replayed contacts between resting bodies are reported but not solved
+		return !contact.is_trigger && (IsMoving(contact.body_a) || IsMoving(contact.body_b));
+	}
+
+	bool World::IsMoving(Identifier body_id) const {
+		const uint32_t index = _bodies.index_unchecked(body_id);
+		return index < _bodies.active_size() && !_bodies.column<Info>()[index].is_static;
+	}
+
+	bool World::IsSleeping(Identifier body_id) const {
+		const uint32_t index = _bodies.index_unchecked(body_id);
+		return index >= _bodies.active_size() && !_bodies.column<Info>()[index].is_static;
+	}
+
+	void World::WakeTouchedBodies() {
+		bool touched = false;
+		for (uint32_t i = 0; i < _contacts.size() && !touched; i++) {
+			const ContactPair& contact = _contacts[i];
+			touched = !contact.is_trigger &&
+				((IsSleeping(contact.body_a) && IsMoving(contact.body_b)) ||
+				(IsSleeping(contact.body_b) && IsMoving(contact.body_a)));
+		}
+		if (!touched) return;
+
+		// sleepers resting on each other fell asleep as one island and wake as one,
+		// so join them the way BuildIslands joins awake bodies
+		for (uint32_t i = _bodies.active_size(); i < _bodies.size(); i++) {
+			const Identifier id = _bodies.entity_id(i);
+			while (static_cast<uint32_t>(id) >= _island_parent.size()) {
+				_island_parent.push_back(INVALID_ID);
+				_island_index.push_back(NO_INDEX);
 			}
+			_island_parent[id] = id;
+			_island_index[id] = 0;
+		}
+
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			const ContactPair& contact = _contacts[i];
+			if (contact.is_trigger || !IsSleeping(contact.body_a) || !IsSleeping(contact.body_b)) continue;
+
+			const Identifier root_a = FindIsland(contact.body_a);
+			const Identifier root_b = FindIsland(contact.body_b);
+			if (root_a < root_b) {
+				_island_parent[root_b] = root_a;
+			} else if (root_b < root_a) {
+				_island_parent[root_a] = root_b;
+			}
+		}
+
+		// contacts replayed between two resting bodies wake nobody
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			const ContactPair& contact = _contacts[i];
+			if (contact.is_trigger) continue;
+
+			if (IsSleeping(contact.body_a) && IsMoving(contact.body_b)) _island_index[FindIsland(contact.body_a)] = 1;
+			else if (IsSleeping(contact.body_b) && IsMoving(contact.body_a)) _island_index[FindIsland(contact.body_b)] = 1;
+		}
+
+		// collected first, waking reorders the disabled range
+		_island_bodies.clear();
+		for (uint32_t i = _bodies.active_size(); i < _bodies.size(); i++) {
+			const Identifier id = _bodies.entity_id(i);
+			if (_island_index[FindIsland(id)] == 1) _island_bodies.push_back(id);
+		}
+		for (uint32_t i = 0; i < _island_bodies.size(); i++) {
+			WakeBody(_island_bodies[i]);
+		}
+	}
+
+	void World::WakeBodiesOverlapping(const AABB& aabb) {
+		for (uint32_t i = 0; i < _shape_groups.active_size(); i++) {
+			const ShapeGroup& group = _shape_groups.get_unchecked(_shape_groups.entity_id(i));
+			if (!IsSleeping(group.owner_body)) continue;
+
+			AABB group_aabb;
+			if (!CachedShapeGroupAABB(group, group_aabb) || Algo::OverlapAABB(aabb, group_aabb)) {
+				WakeBody(group.owner_body);
+			}
+		}
+	}
+
+	void World::WakeAllBodies() {
+		// enabling reorders the disabled range, so always wake from its end
+		while (_bodies.disabled_size() > 0) {
+			WakeBody(_bodies.entity_id(_bodies.size() - 1));
+		}
+	}
+
+	Identifier World::FindIsland(Identifier body_id) {
+		Identifier root = body_id;
+		while (_island_parent[root] != root) {
+			// path halving
+			_island_parent[root] = _island_parent[_island_parent[root]];
+			root = _island_parent[root];
+		}
+		return root;
+	}
+
+	void World::BuildIslands() {
+		_islands.clear();
+		_island_bodies.clear();
+		_island_contacts.clear();
+
+		// every awake dynamic body starts out alone
+		for (uint32_t i = 0; i < _bodies.active_size(); i++) {
+			const Identifier id = _bodies.entity_id(i);
+			if (_bodies.get_unchecked<Info>(id).is_static) continue;
+
+			while (static_cast<uint32_t>(id) >= _island_parent.size()) {
+				_island_parent.push_back(INVALID_ID);
+				_island_index.push_back(NO_INDEX);
+			}
+			_island_parent[id] = id;
+			_island_bodies.push_back(id);
+		}
+
+		// join bodies that touch, static and resting bodies never link two islands
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			const ContactPair& contact = _contacts[i];
+			if (contact.is_trigger) continue;
+			if (!IsMoving(contact.body_a) || !IsMoving(contact.body_b)) continue;
+
+			Identifier root_a = FindIsland(contact.body_a);
+			Identifier root_b = FindIsland(contact.body_b);
+			if (root_a == root_b) continue;
+			// lower id becomes the root so the result does not depend on contact order
+			if (root_a < root_b) {
+				_island_parent[root_b] = root_a;
+			} else {
+				_island_parent[root_a] = root_b;
+			}
+		}
+
+		// number islands by root id, roots hold the lowest id so they come first
+		std::sort(_island_bodies.begin(), _island_bodies.end());
+		for (uint32_t i = 0; i < _island_bodies.size(); i++) {
+			const Identifier id = _island_bodies[i];
+			const Identifier root = FindIsland(id);
+			_island_parent[id] = root;
+			if (root == id) {
+				Island island;
+				island.root = id;
+				_island_index[id] = _islands.size();
+				_islands.push_back(island);
+			}
+			_islands[_island_index[root]].body_count++;
+		}
+
+		std::sort(_island_bodies.begin(), _island_bodies.end(), [this](Identifier a, Identifier b) {
+			const uint32_t island_a = _island_index[_island_parent[a]];
+			const uint32_t island_b = _island_index[_island_parent[b]];
+			return island_a != island_b ? island_a < island_b : a < b;
+		});
+
+		// a solvable contact has at least one awake body, which names its island
+		uint32_t solvable_count = 0;
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			const ContactPair& contact = _contacts[i];
+			if (!IsSolvable(contact)) continue;
+			const Identifier body = IsMoving(contact.body_a) ? contact.body_a : contact.body_b;
+			_islands[_island_index[_island_parent[body]]].contact_count++;
+			solvable_count++;
+		}
+
+		uint32_t body_offset = 0, contact_offset = 0;
+		for (uint32_t i = 0; i < _islands.size(); i++) {
+			Island& island = _islands[i];
+			island.body_start = body_offset;
+			island.contact_start = contact_offset;
+			body_offset += island.body_count;
+			contact_offset += island.contact_count;
+			island.contact_count = 0;
+		}
+
+		// scatter in contact order so every island solves its contacts in a stable order
+		_island_contacts.resize(solvable_count);
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			const ContactPair& contact = _contacts[i];
+			if (!IsSolvable(contact)) continue;
+			const Identifier body = IsMoving(contact.body_a) ? contact.body_a : contact.body_b;
+			Island& island = _islands[_island_index[_island_parent[body]]];
+			_island_contacts[island.contact_start + island.contact_count] = i;
+			island.contact_count++;
 		}
 	}
 
-	void Link::Reset() {
-		for (size_t i = 0; i < NUM_LINKS; i++) {
-			children[i] = INVALID_ID;
+	void World::UpdateSleep() {
+		if (!_sleep_enabled) return;
+
+		const Unit zero{0};
+
+		// track how long every awake dynamic body has been slow
+		for (uint32_t i = 0; i < _island_bodies.size(); i++) {
+			const uint32_t index = _bodies.index_of(_island_bodies[i]);
+			BodyInfo& body = _bodies.column<Info>()[index];
+
+			const Vec3& v = _bodies.column<Velocity>()[index];
+			const bool slow = GekkoMath::abs(v.x) < _sleep_velocity &&
+				GekkoMath::abs(v.y) < _sleep_velocity &&
+				GekkoMath::abs(v.z) < _sleep_velocity;
+
+			if (!slow) {
+				body.idle_frames = 0;
+			} else if (body.idle_frames < UINT16_MAX) {
+				body.idle_frames++;
+			}
+		}
+
+		// an island is as restless as its most restless body and sleeps as a unit
+		for (uint32_t i = 0; i < _islands.size(); i++) {
+			const Island& island = _islands[i];
+			const uint32_t body_end = island.body_start + island.body_count;
+
+			uint16_t idle = UINT16_MAX;
+			for (uint32_t j = island.body_start; j < body_end; j++) {
+				const uint16_t body_idle = _bodies.get_unchecked<Info>(_island_bodies[j]).idle_frames;
+				if (body_idle < idle) idle = body_idle;
+			}
+			if (idle < _sleep_frames) continue;
+
+			for (uint32_t j = island.body_start; j < body_end; j++) {
+				_bodies.get_unchecked<Velocity>(_island_bodies[j]) = Vec3(zero, zero, zero);
+				_bodies.disable(_island_bodies[j]);
+				MarkBodyHash(_island_bodies[j]);
+			}
 		}
 	}
 }
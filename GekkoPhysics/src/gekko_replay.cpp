@@ -0,0 +1,296 @@
+#include "gekko_physics.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <type_traits>
+
+namespace GekkoPhysics {
+	// Leads the file, followed by the format version and the keyframe interval.
+	static const uint32_t REPLAY_MAGIC = 0x50524B47; // "GKRP"
+	static const uint32_t REPLAY_VERSION = 3;
+	static const uint32_t REPLAY_HEADER_BYTES = 16;
+	// Ends a closed file, after the index offset and the frame count.
+	static const uint32_t REPLAY_INDEX_MAGIC = 0x58524B47; // "GKRX"
+	static const uint32_t REPLAY_FOOTER_BYTES = 16;
+	// Record chunk: size, frame, hash, keyframe and a reserved word, so the
+	// snapshot that follows starts 8 byte aligned.
+	static const uint32_t REPLAY_RECORD_BYTES = 24;
+	static const uint32_t REPLAY_ALIGN = 8;
+
+	static_assert(sizeof(ReplayFrame) == 24 && std::is_trivially_copyable_v<ReplayFrame>,
+		"ReplayFrame is written to disk as is");
+
+	static uint64_t AlignReplay(uint64_t offset) {
+		return (offset + REPLAY_ALIGN - 1) & ~uint64_t{ REPLAY_ALIGN - 1 };
+	}
+
+	// Maps a whole file read-only. The handles can go right away, the view keeps the file alive.
+	static const uint8_t* MapFile(const char* path, size_t& out_size) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping) return nullptr;
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!view) return nullptr;
+
+		out_size = static_cast<size_t>(size.QuadPart);
+		return static_cast<const uint8_t*>(view);
+#else
+		const int fd = open(path, O_RDONLY);
+		if (fd < 0) return nullptr;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			return nullptr;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED) return nullptr;
+
+		out_size = static_cast<size_t>(info.st_size);
+		return static_cast<const uint8_t*>(view);
+#endif
+	}
+
+	static void UnmapFile(const uint8_t* data, size_t size) {
+#ifdef _WIN32
+		(void)size;
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<uint8_t*>(data), size);
+#endif
+	}
+
+	ReplayWriter::~ReplayWriter() {
+		Close();
+	}
+
+	bool ReplayWriter::Open(const char* path, uint32_t keyframe_interval) {
+		Close();
+		_file = std::fopen(path, "wb");
+		if (!_file) return false;
+
+		_keyframe_interval = keyframe_interval == 0 ? 1 : keyframe_interval;
+		_frames.clear();
+		_key.clear();
+
+		const uint32_t header[4] = { REPLAY_MAGIC, REPLAY_VERSION, _keyframe_interval, 0 };
+		if (std::fwrite(header, sizeof(header), 1, _file) != 1) {
+			std::fclose(_file);
+			_file = nullptr;
+			return false;
+		}
+		_file_size = REPLAY_HEADER_BYTES;
+		return true;
+	}
+
+	bool ReplayWriter::Record(World& world) {
+		if (!_file) return false;
+
+		ReplayFrame entry;
+		const uint32_t frame = _frames.size();
+		const bool is_key = frame % _keyframe_interval == 0;
+		entry.hash = world.StateHash();
+		entry.keyframe = is_key ? frame : _frames.back().keyframe;
+
+		MemStream record(&_record);
+		record.clear();
+		record.write_value(uint32_t{ 0 });
+		record.write_value(frame);
+		record.write_value(entry.hash);
+		record.write_value(entry.keyframe);
+		record.write_value(uint32_t{ 0 });
+
+		if (is_key) {
+			MemStream key(&_key);
+			key.clear();
+			world.Save(key, SnapshotFormat::Compact);
+			record.write_bytes(key.data(), static_cast<uint32_t>(key.size()));
+		} else {
+			MemStream key(&_key);
+			world.SaveDelta(key, record);
+		}
+
+		// chunk size covers everything after the size itself
+		const uint32_t chunk_size = static_cast<uint32_t>(record.size()) - sizeof(uint32_t);
+		std::memcpy(_record.data(), &chunk_size, sizeof(chunk_size));
+		entry.offset = _file_size + REPLAY_RECORD_BYTES;
+		entry.size = static_cast<uint32_t>(record.size()) - REPLAY_RECORD_BYTES;
+
+		const uint8_t padding[REPLAY_ALIGN] = {};
+		const uint64_t end = AlignReplay(_file_size + record.size());
+		record.write_bytes(padding, static_cast<uint32_t>(end - _file_size - _record.size()));
+
+		if (std::fwrite(record.data(), 1, record.size(), _file) != record.size()) return false;
+		_file_size = end;
+		_frames.push_back(entry);
+		return true;
+	}
+
+	bool ReplayWriter::Close() {
+		if (!_file) return false;
+
+		// records end aligned, so the index can be used in place once mapped
+		const uint64_t index_offset = _file_size;
+		const uint32_t count = _frames.size();
+		// without the footer a reader scans the records, so a torn index is never trusted
+		bool ok = std::fwrite(_frames.begin(), sizeof(ReplayFrame), count, _file) == count;
+		ok = ok && std::fwrite(&index_offset, sizeof(index_offset), 1, _file) == 1;
+		ok = ok && std::fwrite(&count, sizeof(count), 1, _file) == 1;
+		ok = ok && std::fwrite(&REPLAY_INDEX_MAGIC, sizeof(REPLAY_INDEX_MAGIC), 1, _file) == 1;
+		// buffered writes only fail here when the disk fills up
+		ok = std::fclose(_file) == 0 && ok;
+		_file = nullptr;
+		return ok;
+	}
+
+	ReplayReader::~ReplayReader() {
+		Close();
+	}
+
+	bool ReplayReader::Open(const char* path) {
+		Close();
+		_data = MapFile(path, _size);
+		if (!_data) return false;
+
+		uint32_t header[4] = {};
+		if (_size < REPLAY_HEADER_BYTES) {
+			Close();
+			return false;
+		}
+		std::memcpy(header, _data, sizeof(header));
+		if (header[0] != REPLAY_MAGIC || header[1] != REPLAY_VERSION || header[2] == 0) {
+			Close();
+			return false;
+		}
+		_keyframe_interval = header[2];
+
+		if (!ReadIndex()) {
+			ScanRecords();
+		}
+		return true;
+	}
+
+	void ReplayReader::Close() {
+		if (_data) {
+			UnmapFile(_data, _size);
+		}
+		_data = nullptr;
+		_size = 0;
+		_keyframe_interval = 0;
+		_frames = nullptr;
+		_frame_count = 0;
+		_scanned.clear();
+	}
+
+	bool ReplayReader::ReadIndex() {
+		if (_size < REPLAY_HEADER_BYTES + REPLAY_FOOTER_BYTES) return false;
+
+		uint64_t index_offset = 0;
+		uint32_t count = 0, magic = 0;
+		const uint8_t* footer = _data + _size - REPLAY_FOOTER_BYTES;
+		std::memcpy(&index_offset, footer, sizeof(index_offset));
+		std::memcpy(&count, footer + 8, sizeof(count));
+		std::memcpy(&magic, footer + 12, sizeof(magic));
+		if (magic != REPLAY_INDEX_MAGIC || index_offset < REPLAY_HEADER_BYTES ||
+			index_offset + uint64_t{ count } * sizeof(ReplayFrame) != _size - REPLAY_FOOTER_BYTES) {
+			return false;
+		}
+
+		const uint8_t* index = _data + index_offset;
+		if (count == 0 || reinterpret_cast<uintptr_t>(index) % alignof(ReplayFrame) == 0) {
+			_frames = reinterpret_cast<const ReplayFrame*>(index);
+		} else {
+			_scanned.resize(count);
+			std::memcpy(_scanned.data(), index, count * sizeof(ReplayFrame));
+			_frames = _scanned.begin();
+		}
+		_frame_count = count;
+
+		// validated once here so Seek never reads outside the records
+		for (uint32_t i = 0; i < count; i++) {
+			const ReplayFrame& entry = _frames[i];
+			if (entry.offset < REPLAY_HEADER_BYTES || entry.offset + entry.size > index_offset ||
+				entry.keyframe > i || _frames[entry.keyframe].keyframe != entry.keyframe) {
+				_frames = nullptr;
+				_frame_count = 0;
+				_scanned.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void ReplayReader::ScanRecords() {
+		_scanned.clear();
+		uint64_t offset = REPLAY_HEADER_BYTES;
+		while (offset + REPLAY_RECORD_BYTES <= _size) {
+			uint32_t chunk_size = 0, frame = 0;
+			ReplayFrame entry;
+			const uint8_t* record = _data + offset;
+			std::memcpy(&chunk_size, record, sizeof(chunk_size));
+			std::memcpy(&frame, record + 4, sizeof(frame));
+			std::memcpy(&entry.hash, record + 8, sizeof(entry.hash));
+			std::memcpy(&entry.keyframe, record + 16, sizeof(entry.keyframe));
+
+			const uint64_t end = offset + sizeof(uint32_t) + chunk_size;
+			if (chunk_size < REPLAY_RECORD_BYTES - sizeof(uint32_t) || end > _size ||
+				frame != _scanned.size() || entry.keyframe > frame ||
+				(entry.keyframe != frame && _scanned[entry.keyframe].keyframe != entry.keyframe)) {
+				break;
+			}
+
+			entry.offset = offset + REPLAY_RECORD_BYTES;
+			entry.size = static_cast<uint32_t>(end - entry.offset);
+			_scanned.push_back(entry);
+			offset = AlignReplay(end);
+		}
+		_frames = _scanned.begin();
+		_frame_count = _scanned.size();
+	}
+
+	const ReplayFrame& ReplayReader::GetFrame(uint32_t frame) const {
+		if (frame >= _frame_count) {
+			throw std::out_of_range("Replay frame not recorded");
+		}
+		return _frames[frame];
+	}
+
+	MemStream ReplayReader::Snapshot(uint32_t frame) const {
+		const ReplayFrame& entry = GetFrame(frame);
+		return MemStream(_data + entry.offset, entry.size);
+	}
+
+	void ReplayReader::Seek(World& world, uint32_t frame) {
+		const ReplayFrame& entry = GetFrame(frame);
+		MemStream key = Snapshot(entry.keyframe);
+		if (entry.keyframe == frame) {
+			world.Load(key);
+		} else {
+			MemStream delta = Snapshot(frame);
+			world.LoadDelta(key, delta);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#include "gekko_physics.h"
+
+#include <algorithm>
+
+namespace GekkoPhysics {
+	SnapshotRing::SnapshotRing(uint32_t capacity, Allocator* allocator) {
+		if (capacity > MAX_FRAMES) capacity = MAX_FRAMES;
+		if (capacity == 0) capacity = 1;
+		_capacity = capacity;
+		for (uint32_t i = 0; i < _capacity; i++) {
+			_buffers[i].set_allocator(allocator);
+		}
+	}
+
+	uint32_t SnapshotRing::Push(World& world) {
+		const uint32_t frame = _next_frame++;
+		MemStream stream(&_buffers[Slot(frame)]);
+		stream.clear();
+		world.Save(stream, SnapshotFormat::Compact);
+		_count = std::min(_count + 1, _capacity);
+		return frame;
+	}
+
+	void SnapshotRing::Restore(World& world, uint32_t frames_back) {
+		if (frames_back >= _count) {
+			throw std::out_of_range("Snapshot frame not held");
+		}
+
+		_next_frame -= frames_back;
+		_count -= frames_back;
+		MemStream stream(&_buffers[Slot(Newest())]);
+		world.Load(stream);
+	}
+
+	MemStream SnapshotRing::Peek(uint32_t frame) {
+		if (!Contains(frame)) {
+			throw std::out_of_range("Snapshot frame not held");
+		}
+		return MemStream(&_buffers[Slot(frame)]);
+	}
+
+	bool SnapshotRing::Contains(uint32_t frame) const {
+		return frame < _next_frame && _next_frame - frame <= _count;
+	}
+}
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gekko_physics.h"
+
+using namespace GekkoPhysics;
+using namespace GekkoMath;
+
+// ── Scene helpers ───────────────────────────────────────────────────
+
+// Small LCG so every run builds the exact same scenes.
+struct Random {
+    uint32_t state = 12345;
+
+    int Range(int lo, int hi) {
+        state = state * 1664525u + 1013904223u;
+        return lo + static_cast<int>((state >> 8) % static_cast<uint32_t>(hi - lo + 1));
+    }
+};
+
+static Unit Frac(int num, int den) {
+    return Unit{num} / Unit{den};
+}
+
+static int CubeSide(int count) {
+    int side = 1;
+    while (side * side * side < count) side++;
+    return side;
+}
+
+static int SquareSide(int count) {
+    int side = 1;
+    while (side * side < count) side++;
+    return side;
+}
+
+static Identifier MakeGroup(World& world, const Vec3& position, bool is_static, bool is_trigger = false) {
+    Identifier bid = world.CreateBody();
+    BodyRef body = world.EditBody(bid);
+    body.position = position;
+    body.is_static = is_static;
+    if (!is_static) body.acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+
+    Identifier gid = world.AddShapeGroup(bid);
+    ShapeGroupRef group = world.EditShapeGroup(gid);
+    group.layer = 1;
+    group.mask = 0xFFFFFFFF;
+    group.is_trigger = is_trigger;
+    return gid;
+}
+
+static void AddSphere(World& world, Identifier gid, const Unit& radius) {
+    Identifier sid = world.AddShape(gid, Shape::Sphere);
+    world.GetSphere(world.GetShape(sid).shape_type_id).radius = radius;
+}
+
+static void AddOBB(World& world, Identifier gid, const Vec3& half_extents) {
+    Identifier sid = world.AddShape(gid, Shape::OBB);
+    world.GetOBB(world.GetShape(sid).shape_type_id).half_extents = half_extents;
+}
+
+static void AddCapsule(World& world, Identifier gid, const Vec3& start, const Vec3& end, const Unit& radius) {
+    Identifier sid = world.AddShape(gid, Shape::Capsule);
+    Capsule& capsule = world.GetCapsule(world.GetShape(sid).shape_type_id);
+    capsule.start = start;
+    capsule.end = end;
+    capsule.radius = radius;
+}
+
+static void AddFloor(World& world, int half_size) {
+    Identifier gid = MakeGroup(world, Vec3(Unit{0}, Unit{-1}, Unit{0}), true);
+    AddOBB(world, gid, Vec3(Unit{half_size}, Unit{1}, Unit{half_size}));
+}
+
+// ── Scenes ──────────────────────────────────────────────────────────
+
+// Spheres dropped in a loose grid, settling into a pile on the floor.
+static void BuildSpherePile(World& world, int count) {
+    Random random;
+    const int side = CubeSide(count);
+    const Unit spacing = Frac(5, 2);
+    AddFloor(world, side * 2 + 4);
+
+    for (int i = 0; i < count; i++) {
+        const int x = i % side, z = (i / side) % side, y = i / (side * side);
+        Vec3 position(Unit{x - side / 2} * spacing + Frac(random.Range(-4, 4), 16),
+            Unit{2} + Unit{y} * spacing,
+            Unit{z - side / 2} * spacing + Frac(random.Range(-4, 4), 16));
+        AddSphere(world, MakeGroup(world, position, false), Unit{1});
+    }
+}
+
+// Columns of ten boxes resting on top of each other.
+static void BuildOBBStacks(World& world, int count) {
+    const int height = 10;
+    const int columns = (count + height - 1) / height;
+    const int side = SquareSide(columns);
+    AddFloor(world, side * 2 + 4);
+
+    for (int i = 0; i < count; i++) {
+        const int column = i / height, level = i % height;
+        const int x = column % side, z = column / side;
+        Vec3 position(Unit{(x - side / 2) * 3}, Unit{1 + level * 2}, Unit{(z - side / 2) * 3});
+        AddOBB(world, MakeGroup(world, position, false), Vec3(Unit{1}, Unit{1}, Unit{1}));
+    }
+}
+
+// Clusters of five overlapping capsules shaped like a ragdoll: torso, two arms, two legs.
+static void BuildCapsuleClusters(World& world, int count) {
+    const int parts = 5;
+    const int clusters = (count + parts - 1) / parts;
+    const int side = SquareSide(clusters);
+    const Unit radius = Frac(1, 2);
+    AddFloor(world, side * 3 + 4);
+
+    for (int i = 0; i < count; i++) {
+        const int cluster = i / parts, part = i % parts;
+        const Unit cx = Unit{((cluster % side) - side / 2) * 6};
+        const Unit cz = Unit{((cluster / side) - side / 2) * 6};
+
+        Vec3 position, start, end;
+        switch (part) {
+        case 0: // torso
+            position = Vec3(cx, Unit{4}, cz);
+            start = Vec3(Unit{0}, Unit{-1}, Unit{0});
+            end = Vec3(Unit{0}, Unit{1}, Unit{0});
+            break;
+        case 1: // arms
+        case 2:
+            position = Vec3(cx + (part == 1 ? Unit{-1} : Unit{1}), Unit{5}, cz);
+            start = Vec3(Unit{-1}, Unit{0}, Unit{0});
+            end = Vec3(Unit{1}, Unit{0}, Unit{0});
+            break;
+        default: // legs
+            position = Vec3(cx + (part == 3 ? Frac(-1, 2) : Frac(1, 2)), Unit{2}, cz);
+            start = Vec3(Unit{0}, Unit{-1}, Unit{0});
+            end = Vec3(Unit{0}, Unit{1}, Unit{0});
+            break;
+        }
+        AddCapsule(world, MakeGroup(world, position, false), start, end, radius);
+    }
+}
+
+// Spheres drifting through a large empty volume, rarely touching.
+static void BuildSparseWorld(World& world, int count) {
+    Random random;
+    const int side = CubeSide(count);
+
+    for (int i = 0; i < count; i++) {
+        const int x = i % side, z = (i / side) % side, y = i / (side * side);
+        Vec3 position(Unit{(x - side / 2) * 12}, Unit{(y - side / 2) * 12}, Unit{(z - side / 2) * 12});
+        Identifier gid = MakeGroup(world, position, false);
+        BodyRef body = world.EditBody(world.GetShapeGroup(gid).owner_body);
+        body.acceleration = Vec3();
+        body.velocity = Vec3(Unit{random.Range(-3, 3)}, Unit{random.Range(-3, 3)}, Unit{random.Range(-3, 3)});
+        AddSphere(world, gid, Unit{1});
+    }
+}
+
+// Mostly static level: a terrain of boxes with a fifth of the bodies falling onto it.
+static void BuildStaticLevel(World& world, int count) {
+    Random random;
+    const int dynamic_count = count / 5;
+    const int static_count = count - dynamic_count;
+    const int side = SquareSide(static_count);
+
+    for (int i = 0; i < static_count; i++) {
+        const int x = i % side, z = i / side;
+        const int height = random.Range(1, 3);
+        Vec3 position(Unit{(x - side / 2) * 2}, Unit{height - 4}, Unit{(z - side / 2) * 2});
+        AddOBB(world, MakeGroup(world, position, true), Vec3(Unit{1}, Unit{height}, Unit{1}));
+    }
+
+    const int dynamic_side = SquareSide(dynamic_count);
+    for (int i = 0; i < dynamic_count; i++) {
+        const int x = i % dynamic_side, z = i / dynamic_side;
+        const Unit stride = Unit{side * 2} / Unit{dynamic_side};
+        Vec3 position(Unit{x - dynamic_side / 2} * stride, Unit{3 + random.Range(0, 4)}, Unit{z - dynamic_side / 2} * stride);
+        AddSphere(world, MakeGroup(world, position, false), Frac(3, 4));
+    }
+}
+
+// Static trigger volumes with spheres sliding through them.
+static void BuildTriggerField(World& world, int count) {
+    Random random;
+    const int trigger_count = count / 2;
+    const int side = SquareSide(trigger_count);
+    AddFloor(world, side * 3 + 4);
+
+    for (int i = 0; i < trigger_count; i++) {
+        const int x = i % side, z = i / side;
+        Vec3 position(Unit{(x - side / 2) * 6}, Unit{2}, Unit{(z - side / 2) * 6});
+        AddSphere(world, MakeGroup(world, position, true, true), Unit{2});
+    }
+
+    for (int i = trigger_count; i < count; i++) {
+        const int slot = i - trigger_count;
+        const int x = slot % side, z = slot / side;
+        Vec3 position(Unit{(x - side / 2) * 6 + 3}, Unit{1}, Unit{(z - side / 2) * 6 + 3});
+        Identifier gid = MakeGroup(world, position, false);
+        BodyRef body = world.EditBody(world.GetShapeGroup(gid).owner_body);
+        body.velocity = Vec3(Unit{random.Range(-4, 4)}, Unit{0}, Unit{random.Range(-4, 4)});
+        AddSphere(world, gid, Unit{1});
+    }
+}
+
+struct Scene {
+    const char* name;
+    void (*build)(World& world, int count);
+};
+
+static const Scene SCENES[] = {
+    { "sphere_pile", BuildSpherePile },
+    { "obb_stacks", BuildOBBStacks },
+    { "capsule_clusters", BuildCapsuleClusters },
+    { "sparse_world", BuildSparseWorld },
+    { "static_level", BuildStaticLevel },
+    { "trigger_field", BuildTriggerField },
+};
+
+struct Stage {
+    const char* name;
+    uint64_t StepProfile::* time;
+};
+
+static const Stage STAGES[] = {
+    { "integrate", &StepProfile::integrate },
+    { "transform", &StepProfile::transform },
+    { "broadphase", &StepProfile::broadphase },
+    { "narrowphase", &StepProfile::narrowphase },
+    { "islands", &StepProfile::islands },
+    { "solve", &StepProfile::solve },
+    { "sleep", &StepProfile::sleep },
+    { "total", &StepProfile::total },
+};
+
+// Rollback snapshots taken after every measured frame with --snapshots.
+// The delta is written against the previous frame and applied to a replica,
+// the incremental snapshot refers to a key saved before the first measured frame.
+enum SnapshotStage {
+    SaveFull,
+    SaveDelta,
+    LoadDelta,
+    SaveIncremental,
+    StateHash,
+    SnapshotStageCount,
+};
+
+static const char* SNAPSHOT_STAGES[] = { "save_full", "save_delta", "load_delta", "save_incremental", "state_hash" };
+
+// ── Memory ──────────────────────────────────────────────────────────
+
+// Handed to each world as its allocator to measure how much memory it holds.
+// Worker threads grow their contact lists concurrently, hence the atomics.
+struct CountingAllocator : Allocator {
+    std::atomic<size_t> live { 0 };
+    std::atomic<size_t> peak { 0 };
+
+    void* allocate(size_t size, size_t align) override {
+        const size_t now = live.fetch_add(size) + size;
+        size_t seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+        return default_allocator()->allocate(size, align);
+    }
+
+    void deallocate(void* ptr, size_t size, size_t align) override {
+        live.fetch_sub(size);
+        default_allocator()->deallocate(ptr, size, align);
+    }
+};
+
+// ── Options ─────────────────────────────────────────────────────────
+
+struct Options {
+    std::vector<int> sizes = { 100, 1000, 5000, 20000 };
+    std::vector<std::string> scenes;
+    int frames = 300;
+    int warmup = 30;
+    int threads = 1;
+    bool sleeping = true;
+    bool snapshots = false;
+    BroadphaseType broadphase = BroadphaseType::SweepAndPrune;
+    std::string csv_path = "gekko_bench.csv";
+};
+
+static std::vector<std::string> Split(const char* list) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* c = list; ; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+static const char* BroadphaseName(BroadphaseType type) {
+    switch (type) {
+    case BroadphaseType::DynamicTree: return "tree";
+    case BroadphaseType::Grid: return "grid";
+    default: return "sap";
+    }
+}
+
+static void PrintUsage() {
+    std::printf(
+        "usage: GekkoPhysicsBench [options]\n"
+        "  --sizes 100,1000,5000,20000  body counts per scene\n"
+        "  --scenes a,b                 subset of scenes to run (default all)\n"
+        "  --frames N                   measured frames per run (default 300)\n"
+        "  --warmup N                   unmeasured frames before measuring (default 30)\n"
+        "  --broadphase sap|tree|grid   broadphase backend (default sap)\n"
+        "  --threads N                  narrowphase threads (default 1)\n"
+        "  --no-sleep                   keep every body awake\n"
+        "  --snapshots                  also time full and delta snapshots each frame\n"
+        "  --csv PATH                   output file (default gekko_bench.csv)\n"
+        "build with /p:GekkoLargeIds=true (GEKKO_LARGE_IDS) to measure 32 bit identifiers\n"
+        "scenes:");
+    for (const Scene& scene : SCENES) std::printf(" %s", scene.name);
+    std::printf("\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--no-sleep") == 0) {
+            options.sleeping = false;
+        } else if (std::strcmp(arg, "--snapshots") == 0) {
+            options.snapshots = true;
+        } else if (std::strcmp(arg, "--sizes") == 0 && has_value) {
+            options.sizes.clear();
+            for (const std::string& size : Split(argv[++i])) options.sizes.push_back(std::atoi(size.c_str()));
+        } else if (std::strcmp(arg, "--scenes") == 0 && has_value) {
+            options.scenes = Split(argv[++i]);
+        } else if (std::strcmp(arg, "--frames") == 0 && has_value) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--warmup") == 0 && has_value) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--csv") == 0 && has_value) {
+            options.csv_path = argv[++i];
+        } else if (std::strcmp(arg, "--broadphase") == 0 && has_value) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "sap") == 0) options.broadphase = BroadphaseType::SweepAndPrune;
+            else if (std::strcmp(name, "tree") == 0) options.broadphase = BroadphaseType::DynamicTree;
+            else if (std::strcmp(name, "grid") == 0) options.broadphase = BroadphaseType::Grid;
+            else return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool IsSelected(const Options& options, const char* scene) {
+    if (options.scenes.empty()) return true;
+    for (const std::string& name : options.scenes) {
+        if (name == scene) return true;
+    }
+    return false;
+}
+
+// Bodies, groups and shapes each draw from their own identifier range,
+// which caps how many bodies a scene can hold (one is left for the floor).
+static int MaxBodies() {
+    return std::numeric_limits<Identifier>::max() - 1;
+}
+
+static uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// ── Main ────────────────────────────────────────────────────────────
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    FILE* csv = std::fopen(options.csv_path.c_str(), "w");
+    if (!csv) {
+        std::fprintf(stderr, "could not open %s\n", options.csv_path.c_str());
+        return 1;
+    }
+    std::fprintf(csv, "scene,bodies,broadphase,threads,id_bits,frames,stage,min_us,median_us,p99_us,peak_kb,median_bytes\n");
+
+    const int id_bits = static_cast<int>(sizeof(Identifier) * 8);
+    std::printf("%d bit identifiers\n", id_bits);
+    std::printf("%-18s %7s %-16s %10s %10s %10s %10s %12s\n", "scene", "bodies", "stage", "min_us", "median_us", "p99_us", "peak_kb", "median_bytes");
+
+    const size_t stage_count = sizeof(STAGES) / sizeof(STAGES[0]);
+    std::vector<uint64_t> samples[stage_count];
+    std::vector<uint64_t> snapshot_samples[SnapshotStageCount];
+    std::vector<uint64_t> snapshot_bytes[SnapshotStageCount];
+
+    for (const Scene& scene : SCENES) {
+        if (!IsSelected(options, scene.name)) continue;
+
+        for (int size : options.sizes) {
+            if (size > MaxBodies()) {
+                std::fprintf(stderr, "skipping %s/%d: more bodies than identifiers allow (%d)\n", scene.name, size, MaxBodies());
+                continue;
+            }
+
+            CountingAllocator memory;
+            World world(&memory);
+            world.SetBroadphase(options.broadphase);
+            world.SetThreadCount(static_cast<uint8_t>(std::max(1, std::min(options.threads, 255))));
+            world.SetSleeping(options.sleeping);
+            scene.build(world, size);
+
+            for (int frame = 0; frame < options.warmup; frame++) world.Update();
+
+            // the previous frame's snapshot is the delta base, the two streams swap every frame
+            MemStream snapshots[2];
+            MemStream delta;
+            MemStream key;
+            MemStream incremental;
+            World replica;
+            int base = 0;
+            if (options.snapshots) {
+                world.Save(key, SnapshotFormat::Compact);
+                world.Save(snapshots[base], SnapshotFormat::Compact);
+                snapshots[base].rewind();
+                replica.Load(snapshots[base]);
+            }
+
+            world.SetProfiling(true);
+            for (auto& stage_samples : samples) stage_samples.clear();
+            for (auto& stage_samples : snapshot_samples) stage_samples.clear();
+            for (auto& stage_bytes : snapshot_bytes) stage_bytes.clear();
+            for (int frame = 0; frame < options.frames; frame++) {
+                world.Update();
+                const StepProfile& profile = world.GetProfile();
+                for (size_t s = 0; s < stage_count; s++) samples[s].push_back(profile.*STAGES[s].time);
+                if (!options.snapshots) continue;
+
+                MemStream& full = snapshots[1 - base];
+                full.clear();
+                auto start = std::chrono::steady_clock::now();
+                world.Save(full, SnapshotFormat::Compact);
+                snapshot_samples[SaveFull].push_back(ElapsedNs(start));
+                snapshot_bytes[SaveFull].push_back(full.size());
+
+                delta.clear();
+                start = std::chrono::steady_clock::now();
+                world.SaveDelta(snapshots[base], delta);
+                snapshot_samples[SaveDelta].push_back(ElapsedNs(start));
+                snapshot_bytes[SaveDelta].push_back(delta.size());
+
+                delta.rewind();
+                start = std::chrono::steady_clock::now();
+                replica.LoadDelta(snapshots[base], delta);
+                snapshot_samples[LoadDelta].push_back(ElapsedNs(start));
+                snapshot_bytes[LoadDelta].push_back(delta.size());
+
+                incremental.clear();
+                start = std::chrono::steady_clock::now();
+                world.SaveIncremental(key, incremental);
+                snapshot_samples[SaveIncremental].push_back(ElapsedNs(start));
+                snapshot_bytes[SaveIncremental].push_back(incremental.size());
+
+                start = std::chrono::steady_clock::now();
+                world.StateHash();
+                snapshot_samples[StateHash].push_back(ElapsedNs(start));
+
+                base = 1 - base;
+            }
+
+            const double peak_kb = memory.peak.load() / 1024.0;
+            auto report = [&](const char* stage, std::vector<uint64_t>& sorted, std::vector<uint64_t>& bytes) {
+                std::sort(sorted.begin(), sorted.end());
+                const double min_us = sorted.front() / 1000.0;
+                const double median_us = sorted[sorted.size() / 2] / 1000.0;
+                const double p99_us = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] / 1000.0;
+                std::sort(bytes.begin(), bytes.end());
+                const uint64_t median_bytes = bytes.empty() ? 0 : bytes[bytes.size() / 2];
+
+                std::printf("%-18s %7d %-16s %10.1f %10.1f %10.1f %10.1f %12llu\n", scene.name, size, stage, min_us, median_us, p99_us, peak_kb,
+                    static_cast<unsigned long long>(median_bytes));
+                std::fprintf(csv, "%s,%d,%s,%d,%d,%d,%s,%.3f,%.3f,%.3f,%.1f,%llu\n", scene.name, size, BroadphaseName(options.broadphase),
+                    options.threads, id_bits, options.frames, stage, min_us, median_us, p99_us, peak_kb, static_cast<unsigned long long>(median_bytes));
+            };
+
+            std::vector<uint64_t> no_bytes;
+            for (size_t s = 0; s < stage_count; s++) report(STAGES[s].name, samples[s], no_bytes);
+            if (options.snapshots) {
+                for (int s = 0; s < SnapshotStageCount; s++) report(SNAPSHOT_STAGES[s], snapshot_samples[s], snapshot_bytes[s]);
+            }
+            std::fflush(csv);
+        }
+    }
+
+    std::fclose(csv);
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gekko_physics.h"
+
+using namespace GekkoPhysics;
+using namespace GekkoMath;
+
+// Steps a recorded world headless, checks it against the state hashes of a
+// replay and reports how long every frame took. The input is either a replay
+// written by ReplayWriter or a plain World::Save snapshot, which has no
+// hashes to check but can be recorded as the reference for later runs.
+
+// ── Overrides ───────────────────────────────────────────────────────
+
+// A velocity set on a body right before the Update of its frame, the way
+// game input reaches the simulation.
+struct Override {
+    uint32_t frame;
+    Identifier body;
+    Vec3 velocity;
+};
+
+// One override per line: "frame body vx vy vz" with the velocity as raw
+// 16.16 fixed point values, so a run reproduces bit for bit. '#' starts a comment.
+static bool LoadOverrides(const char* path, std::vector<Override>& overrides) {
+    FILE* file = std::fopen(path, "r");
+    if (!file) return false;
+
+    char line[256];
+    int line_number = 0;
+    bool ok = true;
+    while (std::fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* comment = std::strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        unsigned long frame = 0;
+        long body = 0, x = 0, y = 0, z = 0;
+        const int fields = std::sscanf(line, "%lu %ld %ld %ld %ld", &frame, &body, &x, &y, &z);
+        if (fields <= 0) continue;
+        if (fields != 5 || body < 0 || body > std::numeric_limits<Identifier>::max()) {
+            std::fprintf(stderr, "%s:%d: expected \"frame body vx vy vz\"\n", path, line_number);
+            ok = false;
+            break;
+        }
+
+        Override entry;
+        entry.frame = static_cast<uint32_t>(frame);
+        entry.body = static_cast<Identifier>(body);
+        entry.velocity = Vec3(Unit::from_raw_value(static_cast<int32_t>(x)),
+            Unit::from_raw_value(static_cast<int32_t>(y)), Unit::from_raw_value(static_cast<int32_t>(z)));
+        overrides.push_back(entry);
+    }
+    std::fclose(file);
+
+    // file order is kept within a frame
+    std::stable_sort(overrides.begin(), overrides.end(), [](const Override& a, const Override& b) { return a.frame < b.frame; });
+    return ok;
+}
+
+// ── Timing ──────────────────────────────────────────────────────────
+
+struct Stage {
+    const char* name;
+    uint64_t StepProfile::* time;
+};
+
+static const Stage STAGES[] = {
+    { "integrate", &StepProfile::integrate },
+    { "transform", &StepProfile::transform },
+    { "broadphase", &StepProfile::broadphase },
+    { "narrowphase", &StepProfile::narrowphase },
+    { "islands", &StepProfile::islands },
+    { "solve", &StepProfile::solve },
+    { "sleep", &StepProfile::sleep },
+    { "total", &StepProfile::total },
+};
+
+struct FrameSample {
+    uint32_t frame;
+    StepProfile profile;
+};
+
+static double Percentile(const std::vector<uint64_t>& sorted, int percent) {
+    return sorted[std::min(sorted.size() - 1, sorted.size() * percent / 100)] / 1000.0;
+}
+
+static void PrintDistribution(const std::vector<FrameSample>& samples) {
+    std::printf("\n%-12s %10s %10s %10s %10s %10s %10s\n", "stage", "min_us", "median_us", "p90_us", "p99_us", "max_us", "mean_us");
+    std::vector<uint64_t> sorted;
+    for (const Stage& stage : STAGES) {
+        sorted.clear();
+        uint64_t sum = 0;
+        for (const FrameSample& sample : samples) {
+            sorted.push_back(sample.profile.*stage.time);
+            sum += sample.profile.*stage.time;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        std::printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", stage.name, sorted.front() / 1000.0, Percentile(sorted, 50),
+            Percentile(sorted, 90), Percentile(sorted, 99), sorted.back() / 1000.0, sum / 1000.0 / sorted.size());
+    }
+
+    // frame totals in power of two buckets, spikes stand out as a separate tail
+    const int bucket_count = 32;
+    uint32_t buckets[bucket_count] = {};
+    int first = bucket_count, last = 0;
+    for (const FrameSample& sample : samples) {
+        const uint64_t us = sample.profile.total / 1000;
+        int bucket = 0;
+        while (bucket < bucket_count - 1 && (uint64_t{ 1 } << (bucket + 1)) <= us) bucket++;
+        buckets[bucket]++;
+        first = std::min(first, bucket);
+        last = std::max(last, bucket);
+    }
+
+    uint32_t widest = 0;
+    for (int b = first; b <= last; b++) widest = std::max(widest, buckets[b]);
+    std::printf("\nframe time histogram\n");
+    for (int b = first; b <= last; b++) {
+        const int bar = static_cast<int>((buckets[b] * 40 + widest - 1) / widest);
+        std::printf("  %8llu - %8llu us %7u %s\n", b == 0 ? 0ull : (1ull << b), (1ull << (b + 1)) - 1, buckets[b], std::string(bar, '#').c_str());
+    }
+}
+
+static void PrintSlowest(std::vector<FrameSample> samples, int count) {
+    std::sort(samples.begin(), samples.end(), [](const FrameSample& a, const FrameSample& b) {
+        return a.profile.total > b.profile.total;
+    });
+    if (count > static_cast<int>(samples.size())) count = static_cast<int>(samples.size());
+
+    std::printf("\nslowest frames\n");
+    for (int i = 0; i < count; i++) {
+        const FrameSample& sample = samples[i];
+        std::printf("  frame %6u %10.1f us:", sample.frame, sample.profile.total / 1000.0);
+        for (const Stage& stage : STAGES) {
+            if (stage.time == &StepProfile::total) continue;
+            std::printf(" %s %.1f", stage.name, (sample.profile.*stage.time) / 1000.0);
+        }
+        std::printf("\n");
+    }
+}
+
+// ── Desync report ───────────────────────────────────────────────────
+
+// Lists the bodies that differ in order of id, the first 16 of them.
+static void PrintBodyDiff(const World& actual, const World& expected) {
+    struct BodyDiff {
+        Identifier id;
+        const char* what;
+    };
+    std::vector<BodyDiff> diffs;
+    for (uint32_t i = 0; i < actual.GetBodyCount(); i++) {
+        const Identifier id = actual.GetBodyId(i);
+        try {
+            if (actual.BodyHash(id) != expected.BodyHash(id)) diffs.push_back({ id, "differs" });
+        } catch (const std::out_of_range&) {
+            diffs.push_back({ id, "should not exist" });
+        }
+    }
+    for (uint32_t i = 0; i < expected.GetBodyCount(); i++) {
+        const Identifier id = expected.GetBodyId(i);
+        try {
+            actual.BodyHash(id);
+        } catch (const std::out_of_range&) {
+            diffs.push_back({ id, "is missing" });
+        }
+    }
+
+    std::sort(diffs.begin(), diffs.end(), [](const BodyDiff& a, const BodyDiff& b) { return a.id < b.id; });
+    for (size_t i = 0; i < diffs.size() && i < 16; i++) {
+        std::printf("    body %u %s\n", static_cast<unsigned>(diffs[i].id), diffs[i].what);
+    }
+
+    if (diffs.size() > 16) std::printf("    ... %zu bodies in total\n", diffs.size());
+    if (diffs.empty()) std::printf("    every body matches, the difference is in shapes, contacts or settings\n");
+}
+
+// ── Options ─────────────────────────────────────────────────────────
+
+struct Options {
+    std::string input_path;
+    std::string overrides_path;
+    std::string record_path;
+    uint32_t from = 0;
+    int frames = -1;
+    int threads = 0;
+    int spikes = 5;
+    bool set_broadphase = false;
+    BroadphaseType broadphase = BroadphaseType::SweepAndPrune;
+};
+
+static void PrintUsage() {
+    std::printf(
+        "usage: GekkoPhysicsReplay INPUT [options]\n"
+        "  INPUT                        replay from ReplayWriter or a World::Save snapshot\n"
+        "  --from N                     replay frame to start at (default 0)\n"
+        "  --frames N                   frames to step (default rest of the replay, 300 for a snapshot)\n"
+        "  --overrides PATH             velocity overrides, lines of \"frame body vx vy vz\" in raw 16.16\n"
+        "  --broadphase sap|tree|grid   broadphase backend (default as recorded)\n"
+        "  --threads N                  narrowphase threads (default 1)\n"
+        "  --record PATH                write the run as a replay to check later runs against\n"
+        "  --spikes N                   slowest frames to list (default 5)\n"
+        "exits with 2 when a state hash does not match the replay\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--from") == 0 && has_value) {
+            options.from = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (std::strcmp(arg, "--frames") == 0 && has_value) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--overrides") == 0 && has_value) {
+            options.overrides_path = argv[++i];
+        } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--record") == 0 && has_value) {
+            options.record_path = argv[++i];
+        } else if (std::strcmp(arg, "--spikes") == 0 && has_value) {
+            options.spikes = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--broadphase") == 0 && has_value) {
+            const char* name = argv[++i];
+            options.set_broadphase = true;
+            if (std::strcmp(name, "sap") == 0) options.broadphase = BroadphaseType::SweepAndPrune;
+            else if (std::strcmp(name, "tree") == 0) options.broadphase = BroadphaseType::DynamicTree;
+            else if (std::strcmp(name, "grid") == 0) options.broadphase = BroadphaseType::Grid;
+            else return false;
+        } else if (arg[0] != '-' && options.input_path.empty()) {
+            options.input_path = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.input_path.empty();
+}
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& bytes) {
+    FILE* file = std::fopen(path, "rb");
+    if (!file) return false;
+
+    uint8_t buffer[1 << 16];
+    size_t read = 0;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+    std::fclose(file);
+    return true;
+}
+
+// ── Main ────────────────────────────────────────────────────────────
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Override> overrides;
+    if (!options.overrides_path.empty() && !LoadOverrides(options.overrides_path.c_str(), overrides)) {
+        std::fprintf(stderr, "could not read overrides from %s\n", options.overrides_path.c_str());
+        return 1;
+    }
+
+    World world;
+    ReplayReader replay;
+    uint32_t frames = 0;
+    try {
+        if (replay.Open(options.input_path.c_str())) {
+            if (options.from >= replay.FrameCount()) {
+                std::fprintf(stderr, "%s holds frames 0..%u\n", options.input_path.c_str(), replay.FrameCount() - 1);
+                return 1;
+            }
+            replay.Seek(world, options.from);
+            frames = options.frames > 0 ? static_cast<uint32_t>(options.frames) : replay.FrameCount() - 1 - options.from;
+            std::printf("%s: replay of %u frames, keyframe every %u, starting at frame %u\n", options.input_path.c_str(),
+                replay.FrameCount(), replay.KeyframeInterval(), options.from);
+        } else {
+            std::vector<uint8_t> bytes;
+            if (!ReadFile(options.input_path.c_str(), bytes)) {
+                std::fprintf(stderr, "could not open %s\n", options.input_path.c_str());
+                return 1;
+            }
+            MemStream snapshot(bytes.data(), bytes.size());
+            world.Load(snapshot);
+            options.from = 0;
+            frames = options.frames > 0 ? static_cast<uint32_t>(options.frames) : 300;
+            std::printf("%s: snapshot, no hashes to check\n", options.input_path.c_str());
+        }
+    } catch (const std::out_of_range& error) {
+        std::fprintf(stderr, "could not load %s: %s\n", options.input_path.c_str(), error.what());
+        return 1;
+    }
+
+    if (options.set_broadphase) world.SetBroadphase(options.broadphase);
+    world.SetThreadCount(static_cast<uint8_t>(std::max(1, std::min(options.threads, 255))));
+
+    ReplayWriter recorder;
+    if (!options.record_path.empty() && !recorder.Open(options.record_path.c_str(), replay.IsOpen() ? replay.KeyframeInterval() : 60)) {
+        std::fprintf(stderr, "could not create %s\n", options.record_path.c_str());
+        return 1;
+    }
+
+    std::vector<FrameSample> samples;
+    samples.reserve(frames);
+    size_t next_override = 0;
+    while (next_override < overrides.size() && overrides[next_override].frame < options.from) next_override++;
+
+    uint32_t checked = 0, mismatches = 0;
+    bool record_failed = false;
+    world.SetProfiling(true);
+    for (uint32_t step = 0; step < frames; step++) {
+        const uint32_t frame = options.from + step;
+        if (recorder.IsOpen() && !recorder.Record(world)) {
+            std::fprintf(stderr, "could not write frame %u to %s\n", frame, options.record_path.c_str());
+            recorder.Close();
+            record_failed = true;
+        }
+
+        for (; next_override < overrides.size() && overrides[next_override].frame == frame; next_override++) {
+            const Override& entry = overrides[next_override];
+            try {
+                world.GetBody(entry.body);
+            } catch (const std::out_of_range&) {
+                std::fprintf(stderr, "frame %u: override for unknown body %d\n", frame, static_cast<int>(entry.body));
+                continue;
+            }
+            world.EditBody(entry.body).velocity = entry.velocity;
+        }
+
+        world.Update();
+        samples.push_back({ frame, world.GetProfile() });
+
+        // the replay holds the state before each frame's Update, so frame + 1 is what this step produced
+        if (!replay.IsOpen() || frame + 1 >= replay.FrameCount()) continue;
+        checked++;
+        const uint64_t expected = replay.GetFrame(frame + 1).hash;
+        const uint64_t actual = world.StateHash();
+        if (actual == expected) continue;
+
+        if (mismatches++ == 0) {
+            std::printf("first mismatch after frame %u: state hash %016llx, recorded %016llx\n", frame, static_cast<unsigned long long>(actual),
+                static_cast<unsigned long long>(expected));
+            World recorded;
+            replay.Seek(recorded, frame + 1);
+            PrintBodyDiff(world, recorded);
+        }
+    }
+    if (recorder.IsOpen()) {
+        const bool recorded = recorder.Record(world);
+        if (!recorder.Close() || !recorded) {
+            std::fprintf(stderr, "could not finish %s\n", options.record_path.c_str());
+            record_failed = true;
+        }
+    }
+
+    if (replay.IsOpen()) {
+        std::printf("stepped %u frames, %u hashes checked, %u mismatched\n", frames, checked, mismatches);
+    } else {
+        std::printf("stepped %u frames\n", frames);
+    }
+    if (!samples.empty()) {
+        PrintDistribution(samples);
+        PrintSlowest(samples, options.spikes);
+    }
+    if (record_failed) return 1;
+    return mismatches > 0 ? 2 : 0;
+}
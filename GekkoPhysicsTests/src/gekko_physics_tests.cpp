@@ -1,20 +1,96 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
 #include <sstream>
 #include <vector>
 #include <cmath>
+#include <cstdio>
 
 #include "gekko_math.h"
 #include "gekko_ds.h"
 #include "gekko_physics.h"
 #include "gekko_debug_draw.h"
+#include "algo.h"
 
 using namespace GekkoMath;
 using namespace GekkoDS;
 using namespace GekkoPhysics;
 
+// ============================================================================
+// Allocation counting hook
+// ============================================================================
+
+// Every heap allocation in the test binary goes through here, so tests can
+// assert that a code path does not allocate. All forms are replaced so every
+// delete matches the new that handed out the pointer.
+static std::atomic<uint64_t> g_allocation_count { 0 };
+
+static void* CountedAlloc(std::size_t size, std::size_t alignment) noexcept {
+    g_allocation_count++;
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+// Kept out of line, once inlined into a delete GCC sees free() called on a
+// pointer from operator new and warns about the mismatch.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#elif defined(_MSC_VER)
+__declspec(noinline)
+#endif
+static void CountedFree(void* ptr, std::size_t alignment) noexcept {
+#ifdef _MSC_VER
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(ptr);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(ptr);
+}
+
+static void* CountedAllocOrThrow(std::size_t size, std::size_t alignment) {
+    if (void* ptr = CountedAlloc(size, alignment)) return ptr;
+    throw std::bad_alloc();
+}
+
+static const std::size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+void* operator new(std::size_t size) { return CountedAllocOrThrow(size, DEFAULT_ALIGNMENT); }
+void* operator new[](std::size_t size) { return CountedAllocOrThrow(size, DEFAULT_ALIGNMENT); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return CountedAllocOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return CountedAllocOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size, DEFAULT_ALIGNMENT); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size, DEFAULT_ALIGNMENT); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return CountedAlloc(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return CountedAlloc(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* ptr) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete[](void* ptr) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete(void* ptr, std::size_t) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete[](void* ptr, std::size_t) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete(void* ptr, std::align_val_t alignment) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { CountedFree(ptr, DEFAULT_ALIGNMENT); }
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { CountedFree(ptr, static_cast<std::size_t>(alignment)); }
+
 // ============================================================================
 // Vec tests
 // ============================================================================
@@ -158,6 +234,24 @@ TEST_SUITE("Vec") {
         CHECK(v[2] == 30);
     }
 
+    TEST_CASE("empty ranges leave an unallocated Vec alone") {
+        Vec<int> v;
+        Vec<int> empty;
+        v.push_back_range(empty);
+        v.push_back_range(nullptr, 0);
+        CHECK(v.empty());
+        CHECK(v.begin() == nullptr);
+
+        MemStream stream;
+        save_vec(empty, stream);
+        write_elements(empty, stream);
+        stream.rewind();
+        load_vec(v, stream);
+        read_elements(v, 0, stream);
+        CHECK(v.empty());
+        CHECK(v.begin() == nullptr);
+    }
+
     TEST_CASE("iterator") {
         Vec<int> v;
         v.push_back(1);
@@ -194,6 +288,20 @@ TEST_SUITE("Vec") {
         CHECK(v[0] == 100);
         CHECK(v[9] == 109);
     }
+
+    TEST_CASE("resize grows and shrinks") {
+        Vec<int> v;
+        for (int i = 0; i < 5; i++) v.push_back(i);
+
+        v.resize(2);
+        CHECK(v.size() == 2);
+        CHECK(v[1] == 1);
+
+        v.resize(40);
+        CHECK(v.size() == 40);
+        CHECK(v.capacity() >= 40);
+        CHECK(v[0] == 0);
+    }
 }
 
 // ============================================================================
@@ -305,6 +413,28 @@ TEST_SUITE("MemStream") {
         stream.seek(999999);
         CHECK(stream.tell() == stream.size());
     }
+
+    TEST_CASE("view reads in place and refuses writes") {
+        MemStream source;
+        int a = 7, b = 8;
+        source.write_chunk(&a, sizeof(a));
+        source.write_chunk(&b, sizeof(b));
+
+        MemStream view(source.data(), source.size());
+        CHECK(view.read_only());
+        CHECK(view.size() == source.size());
+
+        uint32_t out_size = 0;
+        view.read_chunk(out_size);
+        const uint8_t* data = view.read_chunk(out_size);
+        REQUIRE(data != nullptr);
+        CHECK(data == source.data() + sizeof(uint32_t) * 2 + sizeof(int));
+        CHECK(view.read_chunk(out_size) == nullptr);
+
+        CHECK_THROWS_AS(view.write_chunk(&a, sizeof(a)), std::invalid_argument);
+        CHECK_THROWS_AS(view.write_value(a), std::invalid_argument);
+        CHECK_THROWS_AS(view.clear(), std::invalid_argument);
+    }
 }
 
 // ============================================================================
@@ -437,6 +567,46 @@ TEST_SUITE("SparseSet") {
         CHECK(loaded.is_enabled(id2));
     }
 
+    TEST_CASE("compact save and load roundtrip") {
+        SparseSet<int16_t, int> original;
+        auto id0 = original.insert(100);
+        auto id1 = original.insert(200);
+        auto id2 = original.insert(300);
+        original.remove(id0);
+        original.disable(id2);
+
+        MemStream stream;
+        original.save_compact(stream);
+        stream.rewind();
+
+        SparseSet<int16_t, int> loaded;
+        loaded.load_compact(stream);
+
+        CHECK(loaded.size() == 2);
+        CHECK(loaded.active_size() == 1);
+        CHECK(loaded.get(id1) == 200);
+        CHECK(loaded.get(id2) == 300);
+        CHECK(!loaded.is_enabled(id2));
+        CHECK(loaded.generation(id0) == original.generation(id0));
+        CHECK(loaded.insert(400) == id0);
+    }
+
+    TEST_CASE("compact load of a truncated stream throws") {
+        SparseSet<int16_t, int> original;
+        original.insert(100);
+        original.insert(200);
+
+        MemStream stream;
+        original.save_compact(stream);
+
+        MemStream truncated;
+        truncated.write_bytes(stream.data(), static_cast<uint32_t>(stream.size() - 1));
+        truncated.rewind();
+
+        SparseSet<int16_t, int> loaded;
+        CHECK_THROWS_AS(loaded.load_compact(truncated), std::out_of_range);
+    }
+
     TEST_CASE("remove a disabled entity") {
         SparseSet<int16_t, int> set;
         auto id0 = set.insert(10);
@@ -549,6 +719,320 @@ TEST_SUITE("SparseSet") {
         CHECK(set.active_size() == 1);
         CHECK(set.get(d) == 99);
     }
+
+    TEST_CASE("recycled ids get a new generation") {
+        SparseSet<int16_t, int> set;
+        auto a = set.insert(1);
+        uint16_t first = set.generation(a);
+        CHECK(set.is_current(a, first));
+
+        set.remove(a);
+        CHECK(!set.is_current(a, first));
+
+        auto b = set.insert(2);
+        REQUIRE(b == a);
+        CHECK(set.generation(b) != first);
+        CHECK(!set.is_current(b, first));
+        CHECK(set.is_current(b, set.generation(b)));
+        CHECK(set.get_unchecked(b) == 2);
+    }
+}
+
+// ============================================================================
+// SoASparseSet tests
+// ============================================================================
+
+TEST_SUITE("SoASparseSet") {
+    using Set = SoASparseSet<int16_t, int, float, uint8_t>;
+
+    TEST_CASE("insert and get every column") {
+        Set set;
+        auto id = set.insert(42, 1.5f, 7);
+        CHECK(id != Set::INVALID_ID);
+        CHECK(set.get<0>(id) == 42);
+        CHECK(set.get<1>(id) == 1.5f);
+        CHECK(set.get<2>(id) == 7);
+        CHECK(set.size() == 1);
+        CHECK(set.active_size() == 1);
+    }
+
+    TEST_CASE("get invalid id throws") {
+        Set set;
+        CHECK_THROWS_AS(set.get<0>(0), std::out_of_range);
+        CHECK_THROWS_AS(set.index_of(-1), std::out_of_range);
+    }
+
+    TEST_CASE("columns stay aligned through remove") {
+        Set set;
+        auto a = set.insert(1, 10.0f, 100);
+        auto b = set.insert(2, 20.0f, 200);
+        auto c = set.insert(3, 30.0f, 30);
+
+        set.remove(a);
+        CHECK(!set.contains(a));
+        CHECK(set.size() == 2);
+        CHECK(set.get<0>(b) == 2);
+        CHECK(set.get<1>(b) == 20.0f);
+        CHECK(set.get<2>(b) == 200);
+        CHECK(set.get<0>(c) == 3);
+        CHECK(set.get<1>(c) == 30.0f);
+
+        // freed id is reused
+        auto d = set.insert(4, 40.0f, 40);
+        CHECK(d == a);
+        CHECK(set.get<1>(d) == 40.0f);
+    }
+
+    TEST_CASE("disable and enable move all columns together") {
+        Set set;
+        auto a = set.insert(1, 1.0f, 1);
+        auto b = set.insert(2, 2.0f, 2);
+        auto c = set.insert(3, 3.0f, 3);
+
+        set.disable(a);
+        CHECK(!set.is_enabled(a));
+        CHECK(set.active_size() == 2);
+        CHECK(set.disabled_size() == 1);
+
+        // the active range of every column holds only enabled entities
+        int sum = 0;
+        for (uint32_t i = 0; i < set.active_size(); i++) {
+            CHECK(set.column<0>()[i] == static_cast<int>(set.column<1>()[i]));
+            sum += set.column<0>()[i];
+        }
+        CHECK(sum == 5);
+
+        set.enable(a);
+        CHECK(set.is_enabled(a));
+        CHECK(set.get<0>(a) == 1);
+        CHECK(set.get<2>(b) == 2);
+        CHECK(set.get<1>(c) == 3.0f);
+    }
+
+    TEST_CASE("save and load round trip") {
+        Set set;
+        auto a = set.insert(1, 1.0f, 1);
+        auto b = set.insert(2, 2.0f, 2);
+        set.insert(3, 3.0f, 3);
+        set.remove(a);
+        set.disable(b);
+
+        MemStream stream;
+        set.save(stream);
+        stream.rewind();
+
+        Set loaded;
+        loaded.load(stream);
+        CHECK(loaded.size() == 2);
+        CHECK(loaded.active_size() == 1);
+        CHECK(!loaded.is_enabled(b));
+        CHECK(loaded.get<1>(b) == 2.0f);
+        CHECK(loaded.insert(9, 9.0f, 9) == a);
+    }
+
+    TEST_CASE("generations survive save and load") {
+        Set set;
+        auto a = set.insert(1, 1.0f, 1);
+        set.remove(a);
+        set.insert(2, 2.0f, 2);
+        const uint16_t generation = set.generation(a);
+
+        MemStream stream;
+        set.save(stream);
+        stream.rewind();
+
+        Set loaded;
+        loaded.load(stream);
+        CHECK(loaded.is_current(a, generation));
+        CHECK(loaded.get_unchecked<0>(a) == 2);
+        CHECK(loaded.index_unchecked(a) == loaded.index_of(a));
+    }
+}
+
+// ============================================================================
+// FrameArena tests
+// ============================================================================
+
+TEST_SUITE("FrameArena") {
+    TEST_CASE("allocations are aligned and do not overlap") {
+        FrameArena arena;
+        arena.reset();
+        uint8_t* bytes = arena.alloc<uint8_t>(3);
+        uint64_t* words = arena.alloc<uint64_t>(4);
+        CHECK(reinterpret_cast<uintptr_t>(words) % alignof(uint64_t) == 0);
+
+        bytes[0] = 1; bytes[1] = 2; bytes[2] = 3;
+        for (int i = 0; i < 4; i++) words[i] = 0xFFFFFFFFFFFFFFFFull;
+        CHECK(bytes[2] == 3);
+        CHECK(arena.used() >= 3 + 4 * sizeof(uint64_t));
+    }
+
+    TEST_CASE("overflow grows the block on reset") {
+        FrameArena arena;
+        uint64_t before = g_allocation_count;
+        arena.alloc<int>(100);
+        arena.alloc<int>(1000);
+        CHECK(g_allocation_count - before == 2);
+        CHECK(arena.capacity() == 0);
+
+        arena.reset();
+        CHECK(arena.capacity() >= 1100 * sizeof(int));
+        CHECK(arena.used() == 0);
+    }
+
+    TEST_CASE("warmed up arena does not allocate") {
+        FrameArena arena;
+        for (int frame = 0; frame < 2; frame++) {
+            arena.reset();
+            arena.alloc<int>(500);
+            arena.alloc<double>(200);
+        }
+
+        uint64_t before = g_allocation_count;
+        for (int frame = 0; frame < 10; frame++) {
+            arena.reset();
+            arena.alloc<int>(500);
+            arena.alloc<double>(200);
+        }
+        CHECK(g_allocation_count - before == 0);
+    }
+
+    TEST_CASE("reset invalidates but reuses memory") {
+        FrameArena arena;
+        arena.alloc<int>(64);
+        arena.reset();
+        int* first = arena.alloc<int>(64);
+        arena.reset();
+        int* second = arena.alloc<int>(64);
+        CHECK(first == second);
+    }
+}
+
+// ============================================================================
+// Allocator tests
+// ============================================================================
+
+TEST_SUITE("Allocator") {
+    struct CountingAllocator : Allocator {
+        int allocations = 0;
+        int deallocations = 0;
+
+        void* allocate(size_t size, size_t align) override {
+            allocations++;
+            return default_allocator()->allocate(size, align);
+        }
+
+        void deallocate(void* ptr, size_t size, size_t align) override {
+            deallocations++;
+            default_allocator()->deallocate(ptr, size, align);
+        }
+    };
+
+    TEST_CASE("Vec draws from a custom allocator") {
+        CountingAllocator counting;
+        {
+            Vec<int> vec(&counting);
+            for (int i = 0; i < 100; i++) vec.push_back(i);
+            CHECK(vec.allocator() == &counting);
+            CHECK(counting.allocations > 0);
+            CHECK(vec[99] == 99);
+        }
+        CHECK(counting.allocations == counting.deallocations);
+    }
+
+    TEST_CASE("set_allocator migrates existing elements") {
+        CountingAllocator counting;
+        Vec<int> vec;
+        for (int i = 0; i < 10; i++) vec.push_back(i);
+        vec.set_allocator(&counting);
+        CHECK(counting.allocations == 1);
+        for (int i = 0; i < 10; i++) CHECK(vec[i] == i);
+    }
+
+    TEST_CASE("linear allocator grows the newest allocation in place") {
+        LinearAllocator arena(4096);
+        Vec<int> vec(&arena);
+        vec.push_back(1);
+        int* data = &vec[0];
+        for (int i = 0; i < 200; i++) vec.push_back(i);
+        CHECK(&vec[0] == data);
+        CHECK(vec[200] == 199);
+    }
+
+    TEST_CASE("heap allocator honours a minimum alignment") {
+        HeapAllocator aligned(64);
+        void* ptr = aligned.allocate(10, 4);
+        CHECK(reinterpret_cast<uintptr_t>(ptr) % 64 == 0);
+        aligned.deallocate(ptr, 10, 4);
+    }
+
+    TEST_CASE("allocation hook counts every form of new") {
+        struct alignas(64) Wide { uint8_t bytes[64]; };
+        uint64_t before = g_allocation_count;
+
+        int* single = new int(1);
+        int* array = new int[4];
+        Wide* wide = new Wide;
+        Wide* wide_array = new Wide[2];
+        int* quiet = new (std::nothrow) int(2);
+        int* quiet_array = new (std::nothrow) int[4];
+        Wide* quiet_wide = new (std::nothrow) Wide;
+        // escapes every pointer, an unused new and delete pair may be elided
+        void* volatile sink = nullptr;
+        for (void* ptr : { (void*)single, (void*)array, (void*)wide, (void*)wide_array,
+                (void*)quiet, (void*)quiet_array, (void*)quiet_wide }) {
+            sink = ptr;
+        }
+        (void)sink;
+        CHECK(g_allocation_count - before == 7);
+        CHECK(reinterpret_cast<uintptr_t>(wide) % 64 == 0);
+        CHECK(reinterpret_cast<uintptr_t>(wide_array) % 64 == 0);
+        CHECK(reinterpret_cast<uintptr_t>(quiet_wide) % 64 == 0);
+
+        delete single;
+        delete[] array;
+        delete wide;
+        delete[] wide_array;
+        delete quiet;
+        delete[] quiet_array;
+        delete quiet_wide;
+    }
+
+    TEST_CASE("world runs entirely inside a linear allocator") {
+        LinearAllocator arena(1024 * 1024);
+        uint64_t before = g_allocation_count;
+        {
+            World world(&arena);
+            auto floor = world.CreateBody();
+            world.EditBody(floor).is_static = true;
+            world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+            auto floor_group = world.AddShapeGroup(floor);
+            world.EditShapeGroup(floor_group).layer = 1;
+            world.EditShapeGroup(floor_group).mask = 1;
+            auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+            world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{30}, Unit{1}, Unit{30});
+
+            for (int i = 0; i < 8; i++) {
+                auto bid = world.CreateBody();
+                world.EditBody(bid).position = Vec3(Unit{i * 2}, Unit{1}, Unit{0});
+                world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+                auto gid = world.AddShapeGroup(bid);
+                world.EditShapeGroup(gid).layer = 1;
+                world.EditShapeGroup(gid).mask = 1;
+                auto sid = world.AddShape(gid, Shape::Sphere);
+                world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+            }
+
+            for (int i = 0; i < 30; i++) world.Update();
+            CHECK(world.GetContacts().size() > 0);
+        }
+        // only the arena's own block came from the heap
+        CHECK(g_allocation_count - before == 1);
+        CHECK(arena.reserved() > 0);
+
+        arena.release();
+        CHECK(arena.reserved() == 0);
+    }
 }
 
 // ============================================================================
@@ -730,20 +1214,6 @@ TEST_SUITE("Math Utils") {
     }
 }
 
-// ============================================================================
-// Link tests
-// ============================================================================
-
-TEST_SUITE("Link") {
-    TEST_CASE("reset sets all children to INVALID_ID") {
-        Link link;
-        link.Reset();
-        for (int i = 0; i < Link::NUM_LINKS; i++) {
-            CHECK(link.children[i] == INVALID_ID);
-        }
-    }
-}
-
 // ============================================================================
 // World tests
 // ============================================================================
@@ -759,6 +1229,25 @@ TEST_SUITE("World") {
         CHECK(id0 != id2);
     }
 
+    TEST_CASE("profiling records every stage only when enabled") {
+        World world;
+        auto bid = world.CreateBody();
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        world.AddShape(gid, Shape::Sphere);
+
+        world.Update();
+        CHECK(world.GetProfile().total == 0);
+
+        world.SetProfiling(true);
+        world.Update();
+        const StepProfile& profile = world.GetProfile();
+        CHECK(profile.total > 0);
+        CHECK(profile.total == profile.integrate + profile.transform + profile.broadphase +
+            profile.narrowphase + profile.islands + profile.solve + profile.sleep);
+    }
+
     TEST_CASE("add shape group to invalid body returns INVALID_ID") {
         World world;
         auto group = world.AddShapeGroup(INVALID_ID);
@@ -771,15 +1260,13 @@ TEST_SUITE("World") {
     TEST_CASE("add multiple shape groups to body") {
         World world;
         auto body = world.CreateBody();
-        Identifier groups[Link::NUM_LINKS];
-        for (int i = 0; i < Link::NUM_LINKS; i++) {
+        Identifier groups[20];
+        for (int i = 0; i < 20; i++) {
             groups[i] = world.AddShapeGroup(body);
             CHECK(groups[i] != INVALID_ID);
+            CHECK(world.GetShapeGroup(groups[i]).owner_body == body);
         }
-
-        // 9th should fail (limit is NUM_LINKS = 8)
-        auto overflow = world.AddShapeGroup(body);
-        CHECK(overflow == INVALID_ID);
+        CHECK(groups[19] != groups[0]);
     }
 
     TEST_CASE("add shape to shape group") {
@@ -860,25 +1347,24 @@ TEST_SUITE("World") {
         World world;
         auto body = world.CreateBody();
 
-        // fill all 8 slots
-        Identifier groups[Link::NUM_LINKS];
-        for (int i = 0; i < Link::NUM_LINKS; i++) {
+        Identifier groups[8];
+        for (int i = 0; i < 8; i++) {
             groups[i] = world.AddShapeGroup(body);
             REQUIRE(groups[i] != INVALID_ID);
         }
 
-        // full - can't add more
-        CHECK(world.AddShapeGroup(body) == INVALID_ID);
-
         // remove one in the middle
         world.RemoveShapeGroup(body, groups[3]);
+        CHECK_THROWS_AS(world.GetShapeGroup(groups[3]), std::out_of_range);
 
-        // should be able to add one more now (reuses the freed slot)
         auto new_group = world.AddShapeGroup(body);
         CHECK(new_group != INVALID_ID);
 
-        // but still full again
-        CHECK(world.AddShapeGroup(body) == INVALID_ID);
+        // removing the body takes every remaining group with it
+        world.RemoveBody(body);
+        CHECK_THROWS_AS(world.GetShapeGroup(groups[0]), std::out_of_range);
+        CHECK_THROWS_AS(world.GetShapeGroup(groups[7]), std::out_of_range);
+        CHECK_THROWS_AS(world.GetShapeGroup(new_group), std::out_of_range);
     }
 
     TEST_CASE("remove shape then add new one to same group") {
@@ -886,24 +1372,108 @@ TEST_SUITE("World") {
         auto body = world.CreateBody();
         auto group = world.AddShapeGroup(body);
 
-        // fill all 8 shape slots
-        Identifier shapes[Link::NUM_LINKS];
-        for (int i = 0; i < Link::NUM_LINKS; i++) {
+        Identifier shapes[12];
+        for (int i = 0; i < 12; i++) {
             shapes[i] = world.AddShape(group, Shape::Sphere);
             REQUIRE(shapes[i] != INVALID_ID);
         }
-
-        CHECK(world.AddShape(group, Shape::OBB) == INVALID_ID);
+        CHECK(world.GetShapeGroup(group).shape_count == 12);
 
         // remove one in the middle
         world.RemoveShape(group, shapes[4]);
+        CHECK(world.GetShapeGroup(group).shape_count == 11);
 
-        // should be able to add again
         auto new_shape = world.AddShape(group, Shape::Capsule);
         CHECK(new_shape != INVALID_ID);
+        CHECK(world.GetShape(new_shape).type == Shape::Capsule);
+        CHECK(world.GetShapeGroup(group).shape_count == 12);
+    }
+
+    TEST_CASE("shape ranges grow without moving other ranges") {
+        World world;
+        auto body_a = world.CreateBody();
+        auto body_b = world.CreateBody();
+        auto group_a = world.AddShapeGroup(body_a);
+        auto group_b = world.AddShapeGroup(body_b);
+
+        world.AddShape(group_a, Shape::Sphere);
+        world.AddShape(group_b, Shape::OBB);
+        auto middle = world.AddShape(group_a, Shape::Capsule);
+        world.AddShape(group_b, Shape::Sphere);
+
+        const ShapeGroup& a = world.GetShapeGroup(group_a);
+        const ShapeGroup& b = world.GetShapeGroup(group_b);
+        const uint32_t b_start = b.shape_start;
+        // a range that grows moves behind the others instead of shifting them
+        world.AddShape(group_a, Shape::Sphere);
+        CHECK(a.shape_count == 3);
+        CHECK(b.shape_count == 2);
+        CHECK(b.shape_start == b_start);
+        CHECK(a.shape_start >= b.shape_start + b.shape_count);
+
+        world.RemoveShape(group_a, middle);
+        CHECK(a.shape_count == 2);
+        CHECK(b.shape_start == b_start);
+
+        // the next step closes the holes, keeping the ranges in list order
+        world.Update();
+        CHECK(b.shape_start == 0);
+        CHECK(a.shape_start == 2);
+
+        world.RemoveBody(body_a);
+        world.Update();
+        CHECK(world.GetShapeGroup(group_b).shape_start == 0);
+        CHECK(world.GetShapeGroup(group_b).shape_count == 2);
+    }
+
+    TEST_CASE("interleaved shape edits keep every range intact") {
+        World world;
+        Identifier groups[6];
+        std::vector<Identifier> expected[6];
+        for (int i = 0; i < 6; i++) {
+            groups[i] = world.AddShapeGroup(world.CreateBody());
+        }
 
-        // full again
-        CHECK(world.AddShape(group, Shape::OBB) == INVALID_ID);
+        uint32_t seed = 12345;
+        auto next = [&seed](uint32_t range) {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) % range;
+        };
+
+        for (int step = 0; step < 600; step++) {
+            const uint32_t g = next(6);
+            if (expected[g].empty() || next(3) != 0) {
+                expected[g].push_back(world.AddShape(groups[g], Shape::Sphere));
+            } else {
+                const uint32_t pick = next(static_cast<uint32_t>(expected[g].size()));
+                world.RemoveShape(groups[g], expected[g][pick]);
+                expected[g].erase(expected[g].begin() + pick);
+            }
+
+            if (step % 97 == 0) world.Update();
+            // holes survive a rollback and are closed by the step after it
+            if (step == 300) {
+                MemStream stream;
+                world.Save(stream, SnapshotFormat::Compact);
+                stream.rewind();
+                world.Load(stream);
+            }
+        }
+
+        for (int g = 0; g < 6; g++) {
+            REQUIRE(world.GetShapeGroup(groups[g]).shape_count == expected[g].size());
+            // every shape is found in its own range and nowhere else
+            const Identifier other = groups[(g + 1) % 6];
+            for (Identifier shape : expected[g]) {
+                const uint32_t other_count = world.GetShapeGroup(other).shape_count;
+                world.RemoveShape(other, shape);
+                CHECK(world.GetShapeGroup(other).shape_count == other_count);
+            }
+            for (Identifier shape : expected[g]) {
+                world.RemoveShape(groups[g], shape);
+            }
+            CHECK(world.GetShapeGroup(groups[g]).shape_count == 0);
+        }
     }
 
     TEST_CASE("remove middle body of several") {
@@ -959,14 +1529,28 @@ TEST_SUITE("World") {
         // try removing shape from the wrong group
         world.RemoveShape(group_b, shape);
 
-        // fill group_a to prove the shape wasn't removed
-        int added = 0;
-        for (int i = 0; i < Link::NUM_LINKS; i++) {
-            auto s = world.AddShape(group_a, Shape::Sphere);
-            if (s != INVALID_ID) added++;
+        // the shape stays in group_a
+        CHECK(world.GetShapeGroup(group_a).shape_count == 1);
+        CHECK(world.GetShape(shape).type == Shape::Sphere);
+    }
+
+    TEST_CASE("shape count is capped only by the identifier range") {
+        World world;
+        auto body = world.CreateBody();
+        auto group = world.AddShapeGroup(body);
+
+        // 16 bit ids run out at 32767 shapes, GEKKO_LARGE_IDS goes past that
+        const int limit = std::numeric_limits<Identifier>::max();
+        const int count = std::min(limit, 40000);
+        bool all_added = true;
+        for (int i = 0; i < count; i++) {
+            if (world.AddShape(group, Shape::Sphere) == ShapeHandle{}) all_added = false;
+        }
+        CHECK(all_added);
+        CHECK(world.GetShapeGroup(group).shape_count == static_cast<uint32_t>(count));
+        if (count == limit) {
+            CHECK(world.AddShape(group, Shape::Sphere) == ShapeHandle{});
         }
-        // we already had 1 shape, so only 7 more should fit
-        CHECK(added == 7);
     }
 
     TEST_CASE("save load then continue mutating") {
@@ -1026,6 +1610,143 @@ TEST_SUITE("World") {
     }
 }
 
+// ============================================================================
+// Handle tests
+// ============================================================================
+
+TEST_SUITE("Handles") {
+    TEST_CASE("handles go stale when their entity is removed") {
+        World world;
+        auto body = world.CreateBody();
+        auto group = world.AddShapeGroup(body);
+        auto shape = world.AddShape(group, Shape::Sphere);
+        CHECK(world.IsValid(body));
+        CHECK(world.IsValid(group));
+        CHECK(world.IsValid(shape));
+
+        world.RemoveBody(body);
+        CHECK(!world.IsValid(body));
+        CHECK(!world.IsValid(group));
+        CHECK(!world.IsValid(shape));
+        CHECK_THROWS_AS(world.GetBody(body), std::out_of_range);
+    }
+
+    TEST_CASE("stale handle does not alias a recycled id") {
+        World world;
+        auto old_body = world.CreateBody();
+        world.RemoveBody(old_body);
+
+        auto new_body = world.CreateBody();
+        REQUIRE(new_body.id == old_body.id);
+        CHECK(new_body != old_body);
+        CHECK(!world.IsValid(old_body));
+        CHECK(world.IsValid(new_body));
+
+        // operations through the stale handle leave the new body alone
+        CHECK(world.AddShapeGroup(old_body) == ShapeGroupHandle{});
+        world.RemoveBody(old_body);
+        CHECK(world.IsValid(new_body));
+        CHECK_THROWS_AS(world.GetBody(old_body), std::out_of_range);
+        CHECK_THROWS_AS(static_cast<const World&>(world).GetBody(old_body), std::out_of_range);
+    }
+
+    TEST_CASE("rolling back detects handles from the discarded frames") {
+        World world;
+        auto body = world.CreateBody();
+        auto group = world.AddShapeGroup(body);
+        world.AddShape(group, Shape::Sphere);
+
+        MemStream stream;
+        world.Save(stream);
+
+        // frames that get rolled back replace the body with a new one on the same id
+        world.RemoveBody(body);
+        auto replacement = world.CreateBody();
+        REQUIRE(replacement.id == body.id);
+
+        stream.rewind();
+        world.Load(stream);
+        CHECK(world.IsValid(body));
+        CHECK(world.IsValid(group));
+        CHECK(!world.IsValid(replacement));
+        CHECK_THROWS_AS(world.GetBody(replacement), std::out_of_range);
+    }
+
+    TEST_CASE("rolling back detects handles created in the discarded frames") {
+        const SnapshotFormat formats[] = { SnapshotFormat::Chunked, SnapshotFormat::Compact };
+        for (SnapshotFormat format : formats) {
+            World world;
+            auto kept = world.CreateBody();
+            MemStream stream;
+            world.Save(stream, format);
+
+            // a body created in frames that get rolled back, then created again
+            auto discarded = world.CreateBody();
+            stream.rewind();
+            world.Load(stream);
+            auto created = world.CreateBody();
+            REQUIRE(created.id == discarded.id);
+            CHECK(created.generation != discarded.generation);
+            CHECK(!world.IsValid(discarded));
+            CHECK(world.IsValid(created));
+
+            // the same after the restored body is removed and its id reused
+            stream.rewind();
+            world.Load(stream);
+            world.RemoveBody(kept);
+            auto reused = world.CreateBody();
+            REQUIRE(reused.id == kept.id);
+            CHECK(!world.IsValid(kept));
+            stream.rewind();
+            world.Load(stream);
+            world.RemoveBody(kept);
+            auto reused_again = world.CreateBody();
+            CHECK(reused_again.generation != reused.generation);
+            CHECK(!world.IsValid(reused));
+        }
+    }
+
+    TEST_CASE("a body respawned after a rollback hashes like one never rolled back") {
+        World a;
+        auto kept = a.CreateBody();
+        a.EditBody(kept).position = Vec3(Unit{2}, Unit{0}, Unit{0});
+        MemStream state;
+        a.Save(state, SnapshotFormat::Compact);
+
+        World b;
+        state.rewind();
+        b.Load(state);
+
+        // a predicts a body, rolls back and spawns it again, b only spawns it
+        a.CreateBody();
+        state.rewind();
+        a.Load(state);
+        auto spawned_a = a.CreateBody();
+        auto spawned_b = b.CreateBody();
+        REQUIRE(spawned_a.id == spawned_b.id);
+        CHECK(spawned_a.generation != spawned_b.generation);
+
+        a.EditBody(spawned_a).velocity = Vec3(Unit{1}, Unit{0}, Unit{0});
+        b.EditBody(spawned_b).velocity = Vec3(Unit{1}, Unit{0}, Unit{0});
+        a.Update();
+        b.Update();
+        CHECK(a.BodyHash(spawned_a) == b.BodyHash(spawned_b));
+        CHECK(a.StateHash() == b.StateHash());
+    }
+
+    TEST_CASE("handles still work as plain identifiers") {
+        World world;
+        auto body = world.CreateBody();
+        Identifier id = body;
+        world.EditBody(id).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        CHECK(world.GetBody(body).position.x == Unit{3});
+
+        auto shape = world.AddShape(world.AddShapeGroup(body), Shape::OBB);
+        CHECK(world.GetShape(shape).type == Shape::OBB);
+        CHECK(world.GetShape(shape.id).type == Shape::OBB);
+    }
+}
+
 // ============================================================================
 // Collision Pipeline tests
 // ============================================================================
@@ -1037,15 +1758,15 @@ TEST_SUITE("Collision Pipeline") {
         auto b2 = world.CreateBody();
 
         // Place bodies in world space
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1062,20 +1783,97 @@ TEST_SUITE("Collision Pipeline") {
         CHECK(contacts[0].depth == Unit{1});
     }
 
+    static Identifier AddUnitShape(World& world, Identifier group, Shape::Type type, const Vec3& center) {
+        auto sid = world.AddShape(group, type);
+        auto type_id = world.GetShape(sid).shape_type_id;
+        switch (type) {
+        case Shape::Sphere:
+            world.GetSphere(type_id).center = center;
+            world.GetSphere(type_id).radius = Unit{1};
+            break;
+        case Shape::OBB:
+            world.GetOBB(type_id).center = center;
+            world.GetOBB(type_id).half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
+            break;
+        case Shape::Capsule:
+            world.GetCapsule(type_id).start = center;
+            world.GetCapsule(type_id).end = center + Vec3(Unit{0}, Unit{0}, Unit{1});
+            world.GetCapsule(type_id).radius = Unit{1};
+            break;
+        default: break;
+        }
+        return sid;
+    }
+
+    TEST_CASE("every shape type pair reports the normal from a to b") {
+        const Shape::Type types[] = { Shape::OBB, Shape::Sphere, Shape::Capsule };
+        int correct = 0;
+        for (Shape::Type type_a : types) {
+            for (Shape::Type type_b : types) {
+                World world;
+                auto b1 = world.CreateBody();
+                auto b2 = world.CreateBody();
+                world.EditBody(b2).position = Vec3(Unit{3} / Unit{2}, Unit{0}, Unit{0});
+
+                auto g1 = world.AddShapeGroup(b1);
+                auto g2 = world.AddShapeGroup(b2);
+                world.EditShapeGroup(g1).layer = world.EditShapeGroup(g1).mask = 1;
+                world.EditShapeGroup(g2).layer = world.EditShapeGroup(g2).mask = 1;
+                AddUnitShape(world, g1, type_a, Vec3());
+                AddUnitShape(world, g2, type_b, Vec3());
+
+                world.Update();
+                if (world.GetContacts().size() != 1) continue;
+
+                const ContactPair& contact = world.GetContacts()[0];
+                const Vec3 a_to_b = world.GetBody(contact.body_b).position - world.GetBody(contact.body_a).position;
+                if (contact.normal.Dot(a_to_b) > Unit{0}) correct++;
+            }
+        }
+        CHECK(correct == 9);
+    }
+
+    TEST_CASE("contacts of mixed groups come out in shape order") {
+        World world;
+        auto b1 = world.CreateBody();
+        auto b2 = world.CreateBody();
+        world.EditBody(b2).position = Vec3(Unit{0}, Unit{3} / Unit{2}, Unit{0});
+
+        auto g1 = world.AddShapeGroup(b1);
+        auto g2 = world.AddShapeGroup(b2);
+        world.EditShapeGroup(g1).layer = world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = world.EditShapeGroup(g2).mask = 1;
+
+        // a row of mixed shapes under one sphere, every pair lands in another bucket
+        Identifier row[3];
+        row[0] = AddUnitShape(world, g1, Shape::Capsule, Vec3(Unit{-1}, Unit{0}, Unit{0}));
+        row[1] = AddUnitShape(world, g1, Shape::Sphere, Vec3());
+        row[2] = AddUnitShape(world, g1, Shape::OBB, Vec3(Unit{1}, Unit{0}, Unit{0}));
+        AddUnitShape(world, g2, Shape::Sphere, Vec3());
+
+        world.Update();
+        const auto& contacts = world.GetContacts();
+        REQUIRE(contacts.size() == 3);
+        for (uint32_t i = 0; i < 3; i++) {
+            const Identifier row_shape = contacts[i].body_a == b1 ? contacts[i].shape_a : contacts[i].shape_b;
+            CHECK(row_shape == row[i]);
+        }
+    }
+
     TEST_CASE("separated spheres produce no contact") {
         World world;
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b2).position = Vec3(Unit{10}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{10}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1093,17 +1891,17 @@ TEST_SUITE("Collision Pipeline") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b1).is_static = true;
-        world.GetBody(b2).is_static = true;
-        world.GetBody(b2).position = Vec3(Unit{1}, Unit{0}, Unit{0});
+        world.EditBody(b1).is_static = true;
+        world.EditBody(b2).is_static = true;
+        world.EditBody(b2).position = Vec3(Unit{1}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1121,16 +1919,16 @@ TEST_SUITE("Collision Pipeline") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b2).position = Vec3(Unit{1}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{1}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
         // different layers, masks don't match
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 2;
-        world.GetShapeGroup(g2).mask = 2;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 2;
+        world.EditShapeGroup(g2).mask = 2;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1150,10 +1948,10 @@ TEST_SUITE("Collision Pipeline") {
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b1);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1173,15 +1971,15 @@ TEST_SUITE("Collision Pipeline") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1193,7 +1991,7 @@ TEST_SUITE("Collision Pipeline") {
         CHECK(world.GetContacts().size() == 1);
 
         // separate them by moving body
-        world.GetBody(b2).position = Vec3(Unit{20}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{20}, Unit{0}, Unit{0});
         world.Update();
         CHECK(world.GetContacts().size() == 0);
     }
@@ -1203,15 +2001,15 @@ TEST_SUITE("Collision Pipeline") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b1).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b1).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
 
-        world.GetShapeGroup(g1).layer = 1;
-        world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1;
-        world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1;
+        world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1;
+        world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::OBB);
@@ -1234,13 +2032,13 @@ TEST_SUITE("Collision Pipeline") {
         auto b2 = world.CreateBody();
 
         // Bodies at origin, shapes with local offset
-        world.GetBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
-        world.GetBody(b2).position = Vec3(Unit{5}, Unit{0}, Unit{0});
+        world.EditBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{5}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
-        world.GetShapeGroup(g1).layer = 1; world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1; world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1; world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1; world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1256,7 +2054,7 @@ TEST_SUITE("Collision Pipeline") {
         CHECK(world.GetContacts().size() == 0);
 
         // Move b2 closer so they overlap
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
         // sphere1 at (1,0,0), sphere2 at (2,0,0). Distance=1, sum_r=2 => depth=1
         world.Update();
         CHECK(world.GetContacts().size() == 1);
@@ -1269,15 +2067,15 @@ TEST_SUITE("Collision Pipeline") {
         auto b2 = world.CreateBody();
 
         // Body 1 at origin, rotated 90 deg around Z (X->Y, Y->-X)
-        world.GetBody(b1).rotation = Mat3::RotateZ(90);
+        world.EditBody(b1).rotation = Mat3::RotateZ(90);
 
         // Body 2 at (0, 3, 0)
-        world.GetBody(b2).position = Vec3(Unit{0}, Unit{3}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{0}, Unit{3}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
-        world.GetShapeGroup(g1).layer = 1; world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1; world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1; world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1; world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1298,15 +2096,15 @@ TEST_SUITE("Collision Pipeline") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
-        world.GetBody(b2).position = Vec3(Unit{4}, Unit{0}, Unit{0});
+        world.EditBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{4}, Unit{0}, Unit{0});
         // Rotate body2 90 deg around Y, so OBB's local X-axis (half=3) maps to world Z
-        world.GetBody(b2).rotation = Mat3::RotateY(90);
+        world.EditBody(b2).rotation = Mat3::RotateY(90);
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
-        world.GetShapeGroup(g1).layer = 1; world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1; world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1; world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1; world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::OBB);
@@ -1322,7 +2120,7 @@ TEST_SUITE("Collision Pipeline") {
         CHECK(world.GetContacts().size() == 0);
 
         // Move body2 closer
-        world.GetBody(b2).position = Vec3(Unit{2}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{2}, Unit{0}, Unit{0});
         // Closest on OBB = 2-1 = 1, dist=1, r=2 => depth=1
         world.Update();
         CHECK(world.GetContacts().size() == 1);
@@ -1331,193 +2129,2555 @@ TEST_SUITE("Collision Pipeline") {
 }
 
 // ============================================================================
-// Integration tests
+// Broadphase tests
 // ============================================================================
 
-TEST_SUITE("Integration") {
-    TEST_CASE("iteration benchmark") {
-        World world;
-        const int N = 100;
+TEST_SUITE("Broadphase") {
+    static GroupAABB MakeGroupAABB(Identifier id, int x, int y, int z, int half) {
+        GroupAABB ga;
+        ga.group_id = id;
+        ga.aabb.min = Vec3(Unit{x - half}, Unit{y - half}, Unit{z - half});
+        ga.aabb.max = Vec3(Unit{x + half}, Unit{y + half}, Unit{z + half});
+        return ga;
+    }
 
-        // Create N bodies in a 10x10 grid, spacing 3, radius 2 => neighbors overlap
-        for (int i = 0; i < N; i++) {
-            auto bid = world.CreateBody();
+    static uint32_t CountBruteForcePairs(const Vec<GroupAABB>& aabbs) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < aabbs.size(); i++) {
+            for (uint32_t j = i + 1; j < aabbs.size(); j++) {
+                if (Algo::OverlapAABB(aabbs[i].aabb, aabbs[j].aabb)) count++;
+            }
+        }
+        return count;
+    }
+
+    TEST_CASE("sweep and prune matches brute force") {
+        Vec<GroupAABB> aabbs;
+        uint32_t seed = 12345;
+        for (int i = 0; i < 200; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int x = (seed >> 16) % 100;
+            seed = seed * 1103515245u + 12345u;
+            int z = (seed >> 16) % 100;
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), x, 0, z, 3));
+        }
+
+        SweepAndPrune sap;
+        Vec<GroupPair> pairs;
+        sap.Update(aabbs, pairs);
+
+        CHECK(pairs.size() == CountBruteForcePairs(aabbs));
+        for (auto& pair : pairs) {
+            CHECK(pair.a < pair.b);
+            CHECK(Algo::OverlapAABB(aabbs[pair.a].aabb, aabbs[pair.b].aabb));
+        }
+    }
+
+    TEST_CASE("sweep and prune selects axis with most spread") {
+        Vec<GroupAABB> aabbs;
+        for (int i = 0; i < 10; i++) {
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), 0, 0, i * 10, 1));
+        }
+
+        SweepAndPrune sap;
+        Vec<GroupPair> pairs;
+        sap.Update(aabbs, pairs);
+        CHECK(sap.GetAxis() == 2);
+        CHECK(pairs.size() == 0);
+    }
+
+    TEST_CASE("sweep and prune output does not depend on previous updates") {
+        Vec<GroupAABB> aabbs;
+        for (int i = 0; i < 50; i++) {
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), (i * 7) % 30, 0, (i * 3) % 20, 2));
+        }
+
+        // warm sap sees a shuffled history first, cold sap only the final state
+        SweepAndPrune warm;
+        Vec<GroupPair> pairs;
+        for (int frame = 0; frame < 5; frame++) {
+            Vec<GroupAABB> moved;
+            for (auto& ga : aabbs) {
+                GroupAABB copy = ga;
+                copy.aabb.min.x -= Unit{frame * 3};
+                copy.aabb.max.x -= Unit{frame * 3};
+                moved.push_back(copy);
+            }
+            pairs.clear();
+            warm.Update(moved, pairs);
+        }
+        pairs.clear();
+        warm.Update(aabbs, pairs);
+
+        SweepAndPrune cold;
+        Vec<GroupPair> cold_pairs;
+        cold.Update(aabbs, cold_pairs);
+
+        REQUIRE(pairs.size() == cold_pairs.size());
+        for (uint32_t i = 0; i < pairs.size(); i++) {
+            CHECK(pairs[i].a == cold_pairs[i].a);
+            CHECK(pairs[i].b == cold_pairs[i].b);
+        }
+    }
+
+    TEST_CASE("sweep and prune re-sorts when the axis flips") {
+        // spread along x first, then the same groups spread along z in reverse
+        Vec<GroupAABB> along_x, along_z;
+        for (int i = 0; i < 300; i++) {
+            along_x.push_back(MakeGroupAABB(static_cast<Identifier>(i), i * 2, 0, i % 7, 2));
+            along_z.push_back(MakeGroupAABB(static_cast<Identifier>(i), i % 7, 0, (300 - i) * 2, 2));
+        }
+
+        SweepAndPrune warm;
+        Vec<GroupPair> pairs;
+        warm.Update(along_x, pairs);
+        CHECK(warm.GetAxis() == 0);
+        pairs.clear();
+        warm.Update(along_z, pairs);
+        CHECK(warm.GetAxis() == 2);
+
+        SweepAndPrune cold;
+        Vec<GroupPair> cold_pairs;
+        cold.Update(along_z, cold_pairs);
+
+        CHECK(pairs.size() == CountBruteForcePairs(along_z));
+        REQUIRE(pairs.size() == cold_pairs.size());
+        for (uint32_t i = 0; i < pairs.size(); i++) {
+            CHECK(pairs[i].a == cold_pairs[i].a);
+            CHECK(pairs[i].b == cold_pairs[i].b);
+        }
+    }
+
+    TEST_CASE("sweep and prune drops removed groups") {
+        Vec<GroupAABB> aabbs;
+        aabbs.push_back(MakeGroupAABB(0, 0, 0, 0, 2));
+        aabbs.push_back(MakeGroupAABB(1, 1, 0, 0, 2));
+        aabbs.push_back(MakeGroupAABB(2, 2, 0, 0, 2));
+
+        SweepAndPrune sap;
+        Vec<GroupPair> pairs;
+        sap.Update(aabbs, pairs);
+        CHECK(pairs.size() == 3);
+
+        Vec<GroupAABB> fewer;
+        fewer.push_back(aabbs[0]);
+        fewer.push_back(aabbs[2]);
+        pairs.clear();
+        sap.Update(fewer, pairs);
+        REQUIRE(pairs.size() == 1);
+        CHECK(pairs[0].a == 0);
+        CHECK(pairs[0].b == 1);
+    }
+
+    TEST_CASE("dynamic tree matches brute force") {
+        Vec<GroupAABB> aabbs;
+        uint32_t seed = 777;
+        for (int i = 0; i < 200; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int x = (seed >> 16) % 100;
+            seed = seed * 1103515245u + 12345u;
+            int y = (seed >> 16) % 100;
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), x, y, 0, 3));
+        }
+
+        DynamicTree tree;
+        Vec<GroupPair> pairs;
+        tree.Update(aabbs, pairs);
+
+        CHECK(tree.GetProxyCount() == 200);
+        CHECK(pairs.size() == CountBruteForcePairs(aabbs));
+        for (auto& pair : pairs) {
+            CHECK(pair.a < pair.b);
+            CHECK(Algo::OverlapAABB(aabbs[pair.a].aabb, aabbs[pair.b].aabb));
+        }
+    }
+
+    TEST_CASE("dynamic tree matches sweep and prune beyond 16 bit node counts") {
+        // 20000 groups need 39999 nodes, more than a 16 bit id can address
+        Vec<GroupAABB> aabbs;
+        for (int i = 0; i < 20000; i++) {
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), (i % 200) * 2, 0, (i / 200) * 2, 1));
+        }
+
+        SweepAndPrune sap;
+        Vec<GroupPair> sap_pairs;
+        sap.Update(aabbs, sap_pairs);
+
+        DynamicTree tree;
+        tree.SetMargin(Unit{0});
+        Vec<GroupPair> tree_pairs;
+        tree.Update(aabbs, tree_pairs);
+
+        CHECK(tree.GetProxyCount() == 20000);
+        REQUIRE(sap_pairs.size() > 0);
+        CHECK(tree_pairs.size() == sap_pairs.size());
+    }
+
+    TEST_CASE("dynamic tree stays balanced for sorted inserts") {
+        DynamicTree tree;
+        for (int i = 0; i < 256; i++) {
+            tree.CreateProxy(static_cast<Identifier>(i), MakeGroupAABB(0, i * 4, 0, 0, 1).aabb);
+        }
+        CHECK(tree.GetProxyCount() == 256);
+        // perfectly balanced is 8, AVL style rotations keep it well below linear
+        CHECK(tree.GetHeight() <= 16);
+
+        Vec<Identifier> hits;
+        tree.Query(MakeGroupAABB(0, 400, 0, 0, 1).aabb, hits);
+        REQUIRE(hits.size() == 1);
+        CHECK(hits[0] == 100);
+    }
+
+    TEST_CASE("dynamic tree only reinserts when leaving the fat AABB") {
+        DynamicTree tree;
+        tree.SetMargin(Unit{1});
+        tree.CreateProxy(0, MakeGroupAABB(0, 0, 0, 0, 1).aabb);
+
+        AABB nudged = MakeGroupAABB(0, 0, 0, 0, 1).aabb;
+        nudged.min.x += Unit{1} / Unit{2};
+        nudged.max.x += Unit{1} / Unit{2};
+        CHECK(!tree.MoveProxy(0, nudged));
+        CHECK(tree.GetFatAABB(0).max.x == Unit{2});
+
+        CHECK(tree.MoveProxy(0, MakeGroupAABB(0, 5, 0, 0, 1).aabb));
+        CHECK(tree.GetFatAABB(0).max.x == Unit{7});
+    }
+
+    TEST_CASE("dynamic tree destroy proxy") {
+        DynamicTree tree;
+        for (int i = 0; i < 10; i++) {
+            tree.CreateProxy(static_cast<Identifier>(i), MakeGroupAABB(0, i, 0, 0, 1).aabb);
+        }
+        for (int i = 0; i < 10; i += 2) {
+            tree.DestroyProxy(static_cast<Identifier>(i));
+        }
+        CHECK(tree.GetProxyCount() == 5);
+        CHECK(!tree.HasProxy(4));
+        CHECK(tree.HasProxy(5));
+
+        Vec<Identifier> hits;
+        tree.Query(MakeGroupAABB(0, 0, 0, 0, 100).aabb, hits);
+        CHECK(hits.size() == 5);
+        for (auto id : hits) CHECK(id % 2 == 1);
+    }
+
+    TEST_CASE("world dynamic tree proxies follow shape groups") {
+        World world;
+        world.SetBroadphase(BroadphaseType::DynamicTree);
+
+        auto b1 = world.CreateBody();
+        auto b2 = world.CreateBody();
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        auto g1 = world.AddShapeGroup(b1);
+        auto g2 = world.AddShapeGroup(b2);
+        for (auto gid : { g1, g2 }) {
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+            auto sid = world.AddShape(gid, Shape::Sphere);
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+        }
+
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+
+        world.RemoveBody(b2);
+        world.Update();
+        CHECK(world.GetContacts().size() == 0);
+    }
+
+    TEST_CASE("hash grid matches brute force across cell sizes") {
+        Vec<GroupAABB> aabbs;
+        uint32_t seed = 4242;
+        for (int i = 0; i < 150; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int x = (int)((seed >> 16) % 80) - 40;
+            seed = seed * 1103515245u + 12345u;
+            int z = (int)((seed >> 16) % 80) - 40;
+            seed = seed * 1103515245u + 12345u;
+            int half = 1 + (int)((seed >> 16) % 4);
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), x, 0, z, half));
+        }
+        const uint32_t expected = CountBruteForcePairs(aabbs);
+
+        for (int cell : { 1, 3, 8, 100 }) {
+            HashGrid grid;
+            grid.SetCellSize(Unit{cell});
+            Vec<GroupPair> pairs;
+            grid.Update(aabbs, pairs);
+
+            CHECK(pairs.size() == expected);
+            for (auto& pair : pairs) {
+                CHECK(pair.a < pair.b);
+                CHECK(Algo::OverlapAABB(aabbs[pair.a].aabb, aabbs[pair.b].aabb));
+            }
+        }
+    }
+
+    TEST_CASE("hash grid reports multi-cell pairs once") {
+        Vec<GroupAABB> aabbs;
+        aabbs.push_back(MakeGroupAABB(0, 0, 0, 0, 5));
+        aabbs.push_back(MakeGroupAABB(1, 1, 1, 1, 5));
+
+        HashGrid grid;
+        grid.SetCellSize(Unit{1});
+        Vec<GroupPair> pairs;
+        grid.Update(aabbs, pairs);
+        REQUIRE(pairs.size() == 1);
+        CHECK(pairs[0].a == 0);
+        CHECK(pairs[0].b == 1);
+    }
+
+    TEST_CASE("hash grid rejects cell sizes of zero or less") {
+        HashGrid grid;
+        grid.SetCellSize(Unit{2});
+        CHECK_THROWS_AS(grid.SetCellSize(Unit{0}), std::invalid_argument);
+        CHECK_THROWS_AS(grid.SetCellSize(Unit{-1}), std::invalid_argument);
+        CHECK(grid.GetCellSize() == Unit{2});
+
+        Vec<GroupAABB> aabbs;
+        aabbs.push_back(MakeGroupAABB(0, 0, 0, 0, 1));
+        aabbs.push_back(MakeGroupAABB(1, 1, 0, 0, 1));
+        Vec<GroupPair> pairs;
+        grid.Update(aabbs, pairs);
+        CHECK(pairs.size() == 1);
+    }
+
+    TEST_CASE("hash grid tests huge groups against everything instead of binning them") {
+        Vec<GroupAABB> aabbs;
+        // a floor and a wall over billions of unit cells, and a row of small groups
+        GroupAABB floor = MakeGroupAABB(0, 0, -1, 0, 20000);
+        floor.aabb.max.y = Unit{0};
+        aabbs.push_back(floor);
+        aabbs.push_back(MakeGroupAABB(1, 0, 0, 0, 8));
+        for (int i = 0; i < 32; i++) {
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i + 2), i * 3, 1, 0, 1));
+        }
+        aabbs.push_back(MakeGroupAABB(34, 0, 0, 0, 12000));
+
+        HashGrid grid;
+        grid.SetCellSize(Unit{1});
+        Vec<GroupPair> pairs;
+        grid.Update(aabbs, pairs);
+
+        CHECK(pairs.size() == CountBruteForcePairs(aabbs));
+        for (uint32_t i = 0; i < pairs.size(); i++) {
+            CHECK(pairs[i].a < pairs[i].b);
+            CHECK(Algo::OverlapAABB(aabbs[pairs[i].a].aabb, aabbs[pairs[i].b].aabb));
+            for (uint32_t j = i + 1; j < pairs.size(); j++) {
+                CHECK((pairs[i].a != pairs[j].a || pairs[i].b != pairs[j].b));
+            }
+        }
+    }
+
+    TEST_CASE("hash grid handles cells at the end of the coordinate range") {
+        const int32_t top = std::numeric_limits<int32_t>::max();
+        Vec<GroupAABB> aabbs;
+        for (Identifier id = 0; id < 2; id++) {
+            GroupAABB ga;
+            ga.group_id = id;
+            ga.aabb.min = Vec3(Unit::from_raw_value(top - 1), Unit::from_raw_value(id), Unit{0});
+            ga.aabb.max = Vec3(Unit::from_raw_value(top), Unit::from_raw_value(id + 1), Unit{0});
+            aabbs.push_back(ga);
+        }
+
+        HashGrid grid;
+        grid.SetCellSize(Unit::from_raw_value(1));
+        Vec<GroupPair> pairs;
+        grid.Update(aabbs, pairs);
+        REQUIRE(pairs.size() == 1);
+        CHECK(pairs[0].a == 0);
+        CHECK(pairs[0].b == 1);
+    }
+
+    TEST_CASE("hash grid output is repeatable") {
+        Vec<GroupAABB> aabbs;
+        for (int i = 0; i < 64; i++) {
+            aabbs.push_back(MakeGroupAABB(static_cast<Identifier>(i), (i * 5) % 17, 0, (i * 3) % 11, 2));
+        }
+
+        HashGrid grid;
+        Vec<GroupPair> first, second;
+        grid.Update(aabbs, first);
+        grid.Update(aabbs, second);
+
+        REQUIRE(first.size() == second.size());
+        for (uint32_t i = 0; i < first.size(); i++) {
+            CHECK(first[i].a == second[i].a);
+            CHECK(first[i].b == second[i].b);
+        }
+    }
+
+    TEST_CASE("world grid broadphase produces contacts") {
+        World world;
+        world.SetBroadphase(BroadphaseType::Grid, Unit{2});
+
+        auto b1 = world.CreateBody();
+        auto b2 = world.CreateBody();
+        world.EditBody(b2).position = Vec3(Unit{-3}, Unit{0}, Unit{0});
+        for (auto bid : { b1, b2 }) {
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+            auto sid = world.AddShape(gid, Shape::Sphere);
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+        }
+
+        world.Update();
+        REQUIRE(world.GetContacts().size() == 1);
+        CHECK(world.GetContacts()[0].depth == Unit{1});
+    }
+
+    static Identifier AddSphereBody(World& world, int x, int radius, bool is_static) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = Vec3(Unit{x}, Unit{0}, Unit{0});
+        world.EditBody(bid).is_static = is_static;
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, Shape::Sphere);
+        world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{radius};
+        return bid;
+    }
+
+    TEST_CASE("static groups collide with dynamic groups only") {
+        World world;
+        // overlapping statics never produce contacts
+        AddSphereBody(world, 0, 2, true);
+        AddSphereBody(world, 1, 2, true);
+        AddSphereBody(world, 20, 2, false);
+
+        world.Update();
+        CHECK(world.GetContacts().size() == 0);
+
+        auto dyn = AddSphereBody(world, 3, 2, false);
+        world.Update();
+        CHECK(world.GetContacts().size() == 2);
+        for (auto& c : world.GetContacts()) {
+            CHECK(c.body_a == dyn);
+        }
+    }
+
+    TEST_CASE("moving a static body rebuilds static geometry") {
+        World world;
+        world.SetSolverIterations(0);
+        auto floor = AddSphereBody(world, 50, 2, true);
+        AddSphereBody(world, 0, 2, false);
+
+        world.Update();
+        CHECK(world.GetContacts().size() == 0);
+
+        world.EditBody(floor).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+    }
+
+    TEST_CASE("switching a body between static and dynamic") {
+        World world;
+        world.SetSolverIterations(0);
+        auto a = AddSphereBody(world, 0, 2, false);
+        AddSphereBody(world, 3, 2, false);
+
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+
+        world.EditBody(a).is_static = true;
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+
+        world.EditBody(a).is_static = false;
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+    }
+
+    TEST_CASE("removing a static body removes its contacts") {
+        World world;
+        auto floor = AddSphereBody(world, 0, 2, true);
+        AddSphereBody(world, 3, 2, false);
+
+        world.Update();
+        CHECK(world.GetContacts().size() == 1);
+
+        world.RemoveBody(floor);
+        world.Update();
+        CHECK(world.GetContacts().size() == 0);
+    }
+
+    TEST_CASE("world contacts identical after save and load") {
+        for (auto type : { BroadphaseType::SweepAndPrune, BroadphaseType::DynamicTree, BroadphaseType::Grid }) {
+            World world;
+            world.SetBroadphase(type);
+            for (int i = 0; i < 30; i++) {
+                auto bid = world.CreateBody();
+                world.EditBody(bid).position = Vec3(Unit{(i * 7) % 15}, Unit{(i * 5) % 9}, Unit{0});
+                world.EditBody(bid).velocity = Vec3(Unit{i % 3 - 1}, Unit{0}, Unit{0});
+                auto gid = world.AddShapeGroup(bid);
+                world.EditShapeGroup(gid).layer = 1;
+                world.EditShapeGroup(gid).mask = 1;
+                auto sid = world.AddShape(gid, Shape::Sphere);
+                world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+            }
+            for (int i = 0; i < 3; i++) world.Update();
+
+            MemStream stream;
+            world.Save(stream);
+            stream.rewind();
+            World world2;
+            world2.Load(stream);
+
+            for (int i = 0; i < 5; i++) {
+                world.Update();
+                world2.Update();
+            }
+
+            auto& c1 = world.GetContacts();
+            auto& c2 = world2.GetContacts();
+            REQUIRE(c1.size() == c2.size());
+            CHECK(c1.size() > 0);
+            for (uint32_t i = 0; i < c1.size(); i++) {
+                CHECK(c1[i].shape_a == c2[i].shape_a);
+                CHECK(c1[i].shape_b == c2[i].shape_b);
+                CHECK(c1[i].depth == c2[i].depth);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Transform cache tests
+// ============================================================================
+
+TEST_SUITE("Transform Cache") {
+    TEST_CASE("shape AABB is cached after update") {
+        World world;
+        auto b = world.CreateBody();
+        world.EditBody(b).position = Vec3(Unit{10}, Unit{0}, Unit{0});
+        auto g = world.AddShapeGroup(b);
+        auto s = world.AddShape(g, Shape::Sphere);
+        world.GetSphere(world.GetShape(s).shape_type_id).radius = Unit{1};
+
+        CHECK_THROWS_AS(world.GetShapeAABB(s), std::out_of_range);
+
+        world.Update();
+        const AABB& aabb = world.GetShapeAABB(s);
+        CHECK(aabb.min == Vec3(Unit{9}, Unit{-1}, Unit{-1}));
+        CHECK(aabb.max == Vec3(Unit{11}, Unit{1}, Unit{1}));
+    }
+
+    TEST_CASE("removed shape is dropped from the cache") {
+        World world;
+        auto b = world.CreateBody();
+        auto g = world.AddShapeGroup(b);
+        auto s = world.AddShape(g, Shape::OBB);
+        world.GetOBB(world.GetShape(s).shape_type_id).half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
+
+        world.Update();
+        CHECK(world.GetShapeAABB(s).max == Vec3(Unit{1}, Unit{1}, Unit{1}));
+
+        world.RemoveShape(g, s);
+        CHECK_THROWS_AS(world.GetShapeAABB(s), std::out_of_range);
+    }
+
+    TEST_CASE("static shapes follow their body after it moves") {
+        World world;
+        auto b = world.CreateBody();
+        world.EditBody(b).is_static = true;
+        auto g = world.AddShapeGroup(b);
+        auto s = world.AddShape(g, Shape::Capsule);
+        auto& cap = world.GetCapsule(world.GetShape(s).shape_type_id);
+        cap.start = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        cap.end = Vec3(Unit{0}, Unit{1}, Unit{0});
+        cap.radius = Unit{1};
+
+        world.Update();
+        CHECK(world.GetShapeAABB(s).max == Vec3(Unit{1}, Unit{2}, Unit{1}));
+
+        world.EditBody(b).position = Vec3(Unit{5}, Unit{0}, Unit{0});
+        world.Update();
+        CHECK(world.GetShapeAABB(s).max == Vec3(Unit{6}, Unit{2}, Unit{1}));
+    }
+
+    TEST_CASE("cache is rebuilt after load") {
+        World world;
+        auto b = world.CreateBody();
+        auto g = world.AddShapeGroup(b);
+        auto s = world.AddShape(g, Shape::Sphere);
+        world.GetSphere(world.GetShape(s).shape_type_id).radius = Unit{2};
+        world.Update();
+
+        MemStream stream;
+        world.Save(stream);
+        stream.rewind();
+        World world2;
+        world2.Load(stream);
+        CHECK_THROWS_AS(world2.GetShapeAABB(s), std::out_of_range);
+
+        world2.Update();
+        CHECK(world2.GetShapeAABB(s).max == world.GetShapeAABB(s).max);
+    }
+}
+
+// ============================================================================
+// Sleeping tests
+// ============================================================================
+
+TEST_SUITE("Sleeping") {
+    static Identifier AddBody(World& world, Shape::Type type, const Vec3& position, bool is_static) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = position;
+        world.EditBody(bid).is_static = is_static;
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, type);
+        auto type_id = world.GetShape(sid).shape_type_id;
+        switch (type) {
+        case Shape::Sphere:
+            world.GetSphere(type_id).radius = Unit{1};
+            break;
+        case Shape::OBB:
+            world.GetOBB(type_id).half_extents = Vec3(Unit{10}, Unit{1}, Unit{10});
+            break;
+        case Shape::Capsule:
+            world.GetCapsule(type_id).start = Vec3(Unit{0}, Unit{0}, Unit{-10});
+            world.GetCapsule(type_id).end = Vec3(Unit{0}, Unit{0}, Unit{10});
+            world.GetCapsule(type_id).radius = Unit{1};
+            break;
+        default: break;
+        }
+        return bid;
+    }
+
+    static Identifier AddRestingSphere(World& world) {
+        AddBody(world, Shape::OBB, Vec3(Unit{0}, Unit{-1}, Unit{0}), true);
+        auto sphere = AddBody(world, Shape::Sphere, Vec3(Unit{0}, Unit{1}, Unit{0}), false);
+        world.EditBody(sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        return sphere;
+    }
+
+    TEST_CASE("resting body falls asleep and keeps its contact") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 10);
+        auto sphere = AddRestingSphere(world);
+
+        for (int i = 0; i < 30; i++) world.Update();
+        CHECK(!world.IsAwake(sphere));
+        CHECK(world.GetContacts().size() == 1);
+
+        // sleeping bodies skip integration even with gravity applied
+        const World& view = world;
+        Vec3 before = view.GetBody(sphere).position;
+        for (int i = 0; i < 10; i++) world.Update();
+        CHECK(view.GetBody(sphere).position == before);
+        CHECK(!world.IsAwake(sphere));
+    }
+
+    TEST_CASE("mutable access wakes a body") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        world.EditBody(sphere).velocity = Vec3(Unit{5}, Unit{0}, Unit{0});
+        CHECK(world.IsAwake(sphere));
+        world.Update();
+        CHECK(static_cast<const World&>(world).GetBody(sphere).position.x > Unit{0});
+    }
+
+    TEST_CASE("reading bodies wakes nothing") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        // the floor is body 0, reading it must not look like moved static geometry
+        CHECK(world.GetBody(Identifier{0}).is_static);
+        CHECK(world.GetBody(sphere).position.y > Unit{0});
+        CHECK(!world.IsAwake(sphere));
+        world.Update();
+        CHECK(!world.IsAwake(sphere));
+    }
+
+    TEST_CASE("moving body wakes a sleeper it touches") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sleeper = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sleeper));
+
+        auto bullet = AddBody(world, Shape::Sphere, Vec3(Unit{-6}, Unit{1}, Unit{0}), false);
+        world.EditBody(bullet).velocity = Vec3(Unit{30}, Unit{0}, Unit{0});
+
+        bool woke = false;
+        for (int i = 0; i < 20 && !woke; i++) {
+            world.Update();
+            woke = world.IsAwake(sleeper);
+        }
+        CHECK(woke);
+    }
+
+    TEST_CASE("bodies in contact with a moving body stay awake") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 10);
+
+        // long capsule at rest, a sphere slides along it without leaving contact
+        auto rail = AddBody(world, Shape::Capsule, Vec3(), false);
+        auto slider = AddBody(world, Shape::Sphere, Vec3(Unit{2}, Unit{0}, Unit{-8}), false);
+        world.EditBody(slider).velocity = Vec3(Unit{0}, Unit{0}, Unit{1});
+
+        for (int i = 0; i < 30; i++) world.Update();
+        CHECK(world.GetContacts().size() == 1);
+        CHECK(world.IsAwake(slider));
+        CHECK(world.IsAwake(rail));
+    }
+
+    TEST_CASE("sleep state survives save and load") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        MemStream stream;
+        world.Save(stream);
+        stream.rewind();
+        World world2;
+        world2.Load(stream);
+        CHECK(!world2.IsAwake(sphere));
+
+        world2.Update();
+        CHECK(!world2.IsAwake(sphere));
+        CHECK(world2.GetContacts().size() == 1);
+    }
+
+    TEST_CASE("disabling sleep wakes everything") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        world.SetSleeping(false);
+        CHECK(world.IsAwake(sphere));
+        for (int i = 0; i < 20; i++) world.Update();
+        CHECK(world.IsAwake(sphere));
+    }
+
+    TEST_CASE("removing a neighbour wakes a sleeper") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto left = AddBody(world, Shape::Sphere, Vec3(Unit{0}, Unit{0}, Unit{0}), false);
+        auto right = AddBody(world, Shape::Sphere, Vec3(Unit{2}, Unit{0}, Unit{0}), false);
+
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(left));
+        REQUIRE(!world.IsAwake(right));
+
+        world.RemoveBody(right);
+        CHECK(world.IsAwake(left));
+    }
+
+    TEST_CASE("removing the static support wakes a sleeper") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto floor = AddBody(world, Shape::OBB, Vec3(Unit{0}, Unit{-1}, Unit{0}), true);
+        auto sphere = AddBody(world, Shape::Sphere, Vec3(Unit{0}, Unit{1}, Unit{0}), false);
+        world.EditBody(sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        world.RemoveBody(floor);
+        world.Update();
+        CHECK(world.IsAwake(sphere));
+        CHECK(static_cast<const World&>(world).GetBody(sphere).position.y < Unit{1});
+    }
+
+    TEST_CASE("a hit on a sleeping row wakes the whole row") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 10);
+        auto first = AddRestingSphere(world);
+        auto middle = AddBody(world, Shape::Sphere, Vec3(Unit{19} / Unit{10}, Unit{1}, Unit{0}), false);
+        auto last = AddBody(world, Shape::Sphere, Vec3(Unit{38} / Unit{10}, Unit{1}, Unit{0}), false);
+        world.EditBody(middle).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        world.EditBody(last).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        for (int i = 0; i < 60; i++) world.Update();
+        REQUIRE(!world.IsAwake(first));
+        REQUIRE(!world.IsAwake(middle));
+        REQUIRE(!world.IsAwake(last));
+        // three floor contacts and the two that join the row into one island
+        REQUIRE(world.GetContacts().size() == 5);
+
+        auto bullet = AddBody(world, Shape::Sphere, Vec3(Unit{7}, Unit{1}, Unit{0}), false);
+        world.EditBody(bullet).velocity = Vec3(Unit{-20}, Unit{0}, Unit{0});
+        for (int i = 0; i < 10 && !world.IsAwake(last); i++) world.Update();
+        REQUIRE(world.IsAwake(last));
+        // in the same step, not one body further per step
+        CHECK(world.IsAwake(middle));
+        CHECK(world.IsAwake(first));
+    }
+
+    TEST_CASE("shape access wakes the owning body only") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto near_sphere = AddRestingSphere(world);
+        auto far_sphere = AddBody(world, Shape::Sphere, Vec3(Unit{50}, Unit{0}, Unit{0}), false);
+        auto far_floor = AddBody(world, Shape::OBB, Vec3(Unit{-50}, Unit{0}, Unit{0}), true);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(near_sphere));
+        REQUIRE(!world.IsAwake(far_sphere));
+        (void)far_floor;
+
+        // shapes were added in body order, so type ids follow it too
+        const World& view = world;
+        CHECK(view.GetSphere(0).radius == Unit{1});
+        CHECK(view.GetOBB(1).half_extents.x == Unit{10});
+        world.Update();
+        CHECK(!world.IsAwake(near_sphere));
+        CHECK(!world.IsAwake(far_sphere));
+
+        // an unrelated static shape grows away from both sleepers
+        world.GetOBB(1).half_extents = Vec3(Unit{12}, Unit{1}, Unit{12});
+        world.Update();
+        CHECK(!world.IsAwake(near_sphere));
+        CHECK(!world.IsAwake(far_sphere));
+
+        world.GetSphere(1).radius = Unit{2};
+        CHECK(world.IsAwake(far_sphere));
+        CHECK(!world.IsAwake(near_sphere));
+    }
+
+    TEST_CASE("editing the static support wakes a sleeper") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+
+        // the support drops away under the sphere, only its refit can tell
+        world.GetOBB(0).center = Vec3(Unit{0}, Unit{-4}, Unit{0});
+        world.Update();
+        CHECK(world.IsAwake(sphere));
+        for (int i = 0; i < 5; i++) world.Update();
+        CHECK(static_cast<const World&>(world).GetBody(sphere).position.y < Unit{1});
+        CHECK(world.GetShapeAABB(0).max.y == Unit{-4});
+    }
+
+    TEST_CASE("editing a static body leaves distant sleepers asleep") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto near_sphere = AddRestingSphere(world);
+        auto far_floor = AddBody(world, Shape::OBB, Vec3(Unit{50}, Unit{-1}, Unit{0}), true);
+        auto far_sphere = AddBody(world, Shape::Sphere, Vec3(Unit{50}, Unit{1}, Unit{0}), false);
+        world.EditBody(far_sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(near_sphere));
+        REQUIRE(!world.IsAwake(far_sphere));
+
+        // only the sphere on the moved floor loses its support
+        world.EditBody(far_floor).position = Vec3(Unit{50}, Unit{-4}, Unit{0});
+        world.Update();
+        CHECK(world.IsAwake(far_sphere));
+        CHECK(!world.IsAwake(near_sphere));
+        CHECK(world.GetShapeAABB(2).max.y == Unit{-3});
+
+        for (int i = 0; i < 5; i++) world.Update();
+        CHECK(static_cast<const World&>(world).GetBody(far_sphere).position.y < Unit{1});
+        CHECK(!world.IsAwake(near_sphere));
+    }
+
+    TEST_CASE("shape group edits wake the owner or refit the static group") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        auto far_sphere = AddBody(world, Shape::Sphere, Vec3(Unit{50}, Unit{0}, Unit{0}), false);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(sphere));
+        REQUIRE(!world.IsAwake(far_sphere));
+
+        // groups were added in body order: floor, sphere, far sphere
+        world.EditShapeGroup(2).layer = 1;
+        CHECK(world.IsAwake(far_sphere));
+        CHECK(!world.IsAwake(sphere));
+
+        // the floor stops colliding, the sphere resting on it has to notice
+        world.EditShapeGroup(0).mask = 0;
+        world.Update();
+        CHECK(world.IsAwake(sphere));
+        for (int i = 0; i < 5; i++) world.Update();
+        CHECK(static_cast<const World&>(world).GetBody(sphere).position.y < Unit{1});
+    }
+
+    TEST_CASE("shape access finds its owner after a load") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        auto sphere = AddRestingSphere(world);
+        auto far_sphere = AddBody(world, Shape::Sphere, Vec3(Unit{50}, Unit{0}, Unit{0}), false);
+        for (int i = 0; i < 20; i++) world.Update();
+        REQUIRE(!world.IsAwake(far_sphere));
+
+        Vec<uint8_t> buffer;
+        MemStream stream(&buffer);
+        world.Save(stream);
+        World loaded;
+        stream.rewind();
+        loaded.Load(stream);
+        REQUIRE(!loaded.IsAwake(far_sphere));
+
+        loaded.GetSphere(1).radius = Unit{2};
+        CHECK(loaded.IsAwake(far_sphere));
+        CHECK(!loaded.IsAwake(sphere));
+    }
+}
+
+// ============================================================================
+// Threading tests
+// ============================================================================
+
+TEST_SUITE("Threading") {
+    static void MakeCrowdedWorld(World& world) {
+        // a grid of overlapping spheres falling onto a floor gives a few hundred pairs
+        auto floor = world.CreateBody();
+        world.EditBody(floor).is_static = true;
+        world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        auto floor_group = world.AddShapeGroup(floor);
+        world.EditShapeGroup(floor_group).layer = 1;
+        world.EditShapeGroup(floor_group).mask = 1;
+        auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+        world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{50}, Unit{1}, Unit{50});
+
+        for (int x = 0; x < 12; x++) {
+            for (int z = 0; z < 12; z++) {
+                auto bid = world.CreateBody();
+                world.EditBody(bid).position = Vec3(Unit{x} * Unit{3} / Unit{2}, Unit{2 + (x + z) % 3}, Unit{z} * Unit{3} / Unit{2});
+                world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+                auto gid = world.AddShapeGroup(bid);
+                world.EditShapeGroup(gid).layer = 1;
+                world.EditShapeGroup(gid).mask = 1;
+                auto sid = world.AddShape(gid, Shape::Sphere);
+                world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+            }
+        }
+    }
+
+    TEST_CASE("contacts are identical for every thread count") {
+        for (uint8_t threads = 2; threads <= World::MAX_THREADS; threads += 3) {
+            World world;
+            MakeCrowdedWorld(world);
+            world.SetThreadCount(threads);
+
+            World serial;
+            MakeCrowdedWorld(serial);
+
+            for (int frame = 0; frame < 20; frame++) {
+                world.Update();
+                serial.Update();
+
+                const Vec<ContactPair>& a = world.GetContacts();
+                const Vec<ContactPair>& b = serial.GetContacts();
+                REQUIRE(a.size() == b.size());
+                CHECK(a.size() > 128);
+                bool identical = true;
+                for (uint32_t i = 0; i < a.size(); i++) {
+                    identical = identical && a[i].shape_a == b[i].shape_a && a[i].shape_b == b[i].shape_b &&
+                        a[i].normal == b[i].normal && a[i].point == b[i].point &&
+                        a[i].depth == b[i].depth && a[i].correction == b[i].correction;
+                }
+                CHECK(identical);
+            }
+        }
+    }
+
+    TEST_CASE("thread count is clamped") {
+        World world;
+        MakeCrowdedWorld(world);
+        world.SetThreadCount(0);
+        world.Update();
+        world.SetThreadCount(255);
+        world.Update();
+        CHECK(world.GetContacts().size() > 0);
+    }
+
+    TEST_CASE("threaded Update reuses its workers") {
+        World world;
+        MakeCrowdedWorld(world);
+        world.SetThreadCount(4);
+        for (int i = 0; i < 60; i++) world.Update();
+
+        // spawning a thread allocates its state, steady workers do not
+        uint64_t before = g_allocation_count;
+        for (int i = 0; i < 20; i++) world.Update();
+        CHECK(g_allocation_count - before == 0);
+        CHECK(world.GetContacts().size() > 128);
+
+        // shrinking and growing again restarts the workers cleanly
+        world.SetThreadCount(2);
+        world.Update();
+        world.SetThreadCount(World::MAX_THREADS);
+        world.Update();
+        CHECK(world.GetContacts().size() > 128);
+    }
+
+    TEST_CASE("a threaded world can be moved") {
+        static_assert(std::is_nothrow_move_constructible_v<World> && std::is_nothrow_move_assignable_v<World>,
+            "World must stay movable");
+
+        World serial;
+        MakeCrowdedWorld(serial);
+        World threaded;
+        MakeCrowdedWorld(threaded);
+        threaded.SetThreadCount(4);
+        for (int i = 0; i < 10; i++) {
+            serial.Update();
+            threaded.Update();
+        }
+
+        // the workers move along with the world and keep stepping it
+        World moved(std::move(threaded));
+        World assigned;
+        MakeCrowdedWorld(assigned);
+        assigned.SetThreadCount(2);
+        assigned = std::move(moved);
+        for (int i = 0; i < 10; i++) {
+            serial.Update();
+            assigned.Update();
+        }
+        CHECK(assigned.GetContacts().size() > 128);
+        CHECK(assigned.StateHash() == serial.StateHash());
+    }
+}
+
+// ============================================================================
+// Allocation tests
+// ============================================================================
+
+TEST_SUITE("Allocation") {
+    static void AddSphere(World& world, const Vec3& position, const Vec3& velocity, bool gravity) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = position;
+        world.EditBody(bid).velocity = velocity;
+        if (gravity) world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, Shape::Sphere);
+        world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+    }
+
+    static void MakeSteadyWorld(World& world) {
+        auto floor = world.CreateBody();
+        world.EditBody(floor).is_static = true;
+        world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        auto floor_group = world.AddShapeGroup(floor);
+        world.EditShapeGroup(floor_group).layer = 1;
+        world.EditShapeGroup(floor_group).mask = 1;
+        auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+        world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{30}, Unit{1}, Unit{30});
+
+        // a resting row that keeps its contacts and a few drifters high above it
+        for (int i = 0; i < 8; i++) {
+            AddSphere(world, Vec3(Unit{i * 2}, Unit{1}, Unit{0}), Vec3(), true);
+        }
+        for (int i = 0; i < 4; i++) {
+            AddSphere(world, Vec3(Unit{i * 6}, Unit{20}, Unit{10}), Vec3(Unit{1}, Unit{0}, Unit{0}), false);
+        }
+    }
+
+    TEST_CASE("warmed up Update does not allocate") {
+        const BroadphaseType types[] = { BroadphaseType::SweepAndPrune, BroadphaseType::DynamicTree, BroadphaseType::Grid };
+        for (BroadphaseType type : types) {
+            for (int sleeping = 0; sleeping < 2; sleeping++) {
+                World world;
+                world.SetBroadphase(type);
+                world.SetSleeping(sleeping == 1);
+                MakeSteadyWorld(world);
+
+                for (int i = 0; i < 30; i++) world.Update();
+                REQUIRE(world.GetContacts().size() > 0);
+
+                uint64_t before = g_allocation_count;
+                for (int i = 0; i < 60; i++) world.Update();
+                CHECK(g_allocation_count - before == 0);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Island tests
+// ============================================================================
+
+TEST_SUITE("Islands") {
+    static Identifier AddSphere(World& world, int x, int y, bool is_static) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = Vec3(Unit{x}, Unit{y}, Unit{0});
+        world.EditBody(bid).is_static = is_static;
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, Shape::Sphere);
+        world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+        return bid;
+    }
+
+    TEST_CASE("touching bodies share an island") {
+        World world;
+        world.SetSleeping(false);
+        // three overlapping bodies, a lone body and a separate pair
+        auto a = AddSphere(world, 0, 0, false);
+        auto b = AddSphere(world, 1, 0, false);
+        auto c = AddSphere(world, 2, 0, false);
+        auto lone = AddSphere(world, 20, 0, false);
+        auto d = AddSphere(world, 41, 0, false);
+        auto e = AddSphere(world, 40, 0, false);
+        world.Update();
+
+        const Vec<Island>& islands = world.GetIslands();
+        REQUIRE(islands.size() == 3);
+
+        CHECK(islands[0].root == a);
+        CHECK(islands[0].body_count == 3);
+        CHECK(islands[0].contact_count == 3);
+        CHECK(world.GetIslandBody(islands[0], 0) == a);
+        CHECK(world.GetIslandBody(islands[0], 1) == b);
+        CHECK(world.GetIslandBody(islands[0], 2) == c);
+
+        CHECK(islands[1].root == lone);
+        CHECK(islands[1].body_count == 1);
+        CHECK(islands[1].contact_count == 0);
+
+        CHECK(islands[2].root == d);
+        CHECK(islands[2].body_count == 2);
+        CHECK(world.GetIslandBody(islands[2], 1) == e);
+        const ContactPair& contact = world.GetIslandContact(islands[2], 0);
+        CHECK(((contact.body_a == d && contact.body_b == e) || (contact.body_a == e && contact.body_b == d)));
+    }
+
+    TEST_CASE("static bodies do not join islands") {
+        World world;
+        world.SetSleeping(false);
+        auto floor = AddSphere(world, 0, 0, true);
+        auto left = AddSphere(world, -1, 1, false);
+        auto right = AddSphere(world, 1, 1, false);
+        world.Update();
+
+        const Vec<Island>& islands = world.GetIslands();
+        REQUIRE(islands.size() == 1);
+        CHECK(islands[0].root == left);
+        CHECK(islands[0].body_count == 2);
+        CHECK(islands[0].contact_count == 3);
+        for (uint32_t i = 0; i < islands[0].body_count; i++) {
+            CHECK(world.GetIslandBody(islands[0], i) != floor);
+        }
+        CHECK(world.GetIslandBody(islands[0], 1) == right);
+    }
+
+    TEST_CASE("isolated pairs exit the solver early") {
+        World world;
+        world.SetSleeping(false);
+        world.SetSolverIterations(8);
+        AddSphere(world, 0, 0, true);
+        auto sphere = AddSphere(world, 0, 2, false);
+        world.EditBody(sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+
+        for (int i = 0; i < 30; i++) world.Update();
+
+        const Vec<Island>& islands = world.GetIslands();
+        REQUIRE(islands.size() == 1);
+        CHECK(islands[0].contact_count == 1);
+        CHECK(islands[0].iterations >= 1);
+        CHECK(islands[0].iterations < 8);
+    }
+
+    TEST_CASE("sleeping bodies are left out of islands") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        AddSphere(world, 0, 0, false);
+        AddSphere(world, 2, 0, false);
+        for (int i = 0; i < 20; i++) world.Update();
+
+        CHECK(world.GetIslands().size() == 0);
+        CHECK(world.GetContacts().size() == 1);
+    }
+
+    TEST_CASE("island accessors reject out of range indices") {
+        World world;
+        world.SetSleeping(false);
+        AddSphere(world, 0, 0, false);
+        world.Update();
+
+        REQUIRE(world.GetIslands().size() == 1);
+        const Island& island = world.GetIslands()[0];
+        CHECK_THROWS_AS(world.GetIslandBody(island, 1), std::out_of_range);
+        CHECK_THROWS_AS(world.GetIslandContact(island, 0), std::out_of_range);
+    }
+}
+
+// ============================================================================
+// Integration tests
+// ============================================================================
+
+TEST_SUITE("Integration") {
+    TEST_CASE("iteration benchmark") {
+        World world;
+        const int N = 100;
+
+        // Create N bodies in a 10x10 grid, spacing 3, radius 2 => neighbors overlap
+        for (int i = 0; i < N; i++) {
+            auto bid = world.CreateBody();
             int row = i / 10;
             int col = i % 10;
-            world.GetBody(bid).position = Vec3(Unit{col * 3}, Unit{0}, Unit{row * 3});
+            world.EditBody(bid).position = Vec3(Unit{col * 3}, Unit{0}, Unit{row * 3});
+
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+
+            auto sid = world.AddShape(gid, Shape::Sphere);
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+        }
+
+        const int M = 100;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < M; i++) {
+            world.Update();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        auto& contacts = world.GetContacts();
+
+        std::ostringstream log;
+        log << "bodies=" << N
+            << " iterations=" << M
+            << " total_us=" << ms
+            << " per_iter_us=" << (ms / M)
+            << " contacts=" << contacts.size();
+        MESSAGE(log.str());
+
+        CHECK(contacts.size() > 0);
+    }
+
+    TEST_CASE("save load roundtrip with contacts") {
+        World world;
+
+        // Body A: sphere at origin
+        auto ba = world.CreateBody();
+        auto ga = world.AddShapeGroup(ba);
+        world.EditShapeGroup(ga).layer = 1;
+        world.EditShapeGroup(ga).mask = 1;
+        auto sa = world.AddShape(ga, Shape::Sphere);
+        world.GetSphere(world.GetShape(sa).shape_type_id).radius = Unit{2};
+
+        // Body B: OBB at (3,0,0)
+        auto bb = world.CreateBody();
+        world.EditBody(bb).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        auto gb = world.AddShapeGroup(bb);
+        world.EditShapeGroup(gb).layer = 1;
+        world.EditShapeGroup(gb).mask = 1;
+        auto sb = world.AddShape(gb, Shape::OBB);
+        auto& obb = world.GetOBB(world.GetShape(sb).shape_type_id);
+        obb.half_extents = Vec3(Unit{2}, Unit{2}, Unit{2});
+
+        // Body C: capsule at (0,0,3)
+        auto bc = world.CreateBody();
+        world.EditBody(bc).position = Vec3(Unit{0}, Unit{0}, Unit{3});
+        auto gc = world.AddShapeGroup(bc);
+        world.EditShapeGroup(gc).layer = 1;
+        world.EditShapeGroup(gc).mask = 1;
+        auto sc = world.AddShape(gc, Shape::Capsule);
+        auto& cap = world.GetCapsule(world.GetShape(sc).shape_type_id);
+        cap.start = Vec3(Unit{-2}, Unit{0}, Unit{0});
+        cap.end = Vec3(Unit{2}, Unit{0}, Unit{0});
+        cap.radius = Unit{1};
+
+        world.Update();
+        uint32_t contacts_before = world.GetContacts().size();
+        CHECK(contacts_before > 0);
+
+        // Save
+        MemStream stream;
+        auto save_start = std::chrono::high_resolution_clock::now();
+        world.Save(stream);
+        auto save_end = std::chrono::high_resolution_clock::now();
+        uint32_t save_size = (uint32_t)stream.size();
+        stream.rewind();
+
+        // Load
+        World world2;
+        auto load_start = std::chrono::high_resolution_clock::now();
+        world2.Load(stream);
+        auto load_end = std::chrono::high_resolution_clock::now();
+
+        auto save_us = std::chrono::duration_cast<std::chrono::microseconds>(save_end - save_start).count();
+        auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count();
+
+        std::ostringstream log;
+        log << "save_bytes=" << save_size
+            << " save_us=" << save_us
+            << " load_us=" << load_us
+            << " contacts_before=" << contacts_before;
+        MESSAGE(log.str());
+
+        // Re-save loaded world and memcmp (no Update — tests save/load fidelity)
+        MemStream stream2;
+        world2.Save(stream2);
+        CHECK(stream.size() == stream2.size());
+        CHECK(std::memcmp(stream.data(), stream2.data(), stream.size()) == 0);
+
+        // After update, loaded world should still produce contacts
+        world2.Update();
+        CHECK(world2.GetContacts().size() > 0);
+    }
+
+    TEST_CASE("save load large world") {
+        World world;
+        const int BODY_COUNT = 50;
+
+        for (int i = 0; i < BODY_COUNT; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{i * 2}, Unit{0}, Unit{0});
+
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+
+            // Alternate shape types
+            Shape::Type type;
+            switch (i % 3) {
+            case 0: type = Shape::Sphere; break;
+            case 1: type = Shape::OBB; break;
+            default: type = Shape::Capsule; break;
+            }
+
+            auto sid = world.AddShape(gid, type);
+            switch (type) {
+            case Shape::Sphere:
+                world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+                break;
+            case Shape::OBB: {
+                auto& o = world.GetOBB(world.GetShape(sid).shape_type_id);
+                o.half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
+                break;
+            }
+            case Shape::Capsule: {
+                auto& c = world.GetCapsule(world.GetShape(sid).shape_type_id);
+                c.start = Vec3(Unit{0}, Unit{-1}, Unit{0});
+                c.end = Vec3(Unit{0}, Unit{1}, Unit{0});
+                c.radius = Unit{1};
+                break;
+            }
+            default: break;
+            }
+        }
+
+        // Save
+        MemStream stream1;
+        auto save_start = std::chrono::high_resolution_clock::now();
+        world.Save(stream1);
+        auto save_end = std::chrono::high_resolution_clock::now();
+        stream1.rewind();
+
+        // Load
+        World world2;
+        auto load_start = std::chrono::high_resolution_clock::now();
+        world2.Load(stream1);
+        auto load_end = std::chrono::high_resolution_clock::now();
+
+        // Re-save and compare
+        MemStream stream2;
+        world2.Save(stream2);
+
+        auto save_us = std::chrono::duration_cast<std::chrono::microseconds>(save_end - save_start).count();
+        auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count();
+
+        std::ostringstream log;
+        log << "bodies=" << BODY_COUNT
+            << " save1_bytes=" << stream1.size()
+            << " save2_bytes=" << stream2.size()
+            << " save_us=" << save_us
+            << " load_us=" << load_us;
+        MESSAGE(log.str());
+
+        CHECK(stream1.size() == stream2.size());
+        CHECK(std::memcmp(stream1.data(), stream2.data(), stream1.size()) == 0);
+    }
+}
+
+// ============================================================================
+// Snapshot format tests
+// ============================================================================
+
+TEST_SUITE("Snapshot Format") {
+    static void BuildSnapshotScene(World& world) {
+        for (int i = 0; i < 30; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{(i * 7) % 15}, Unit{(i * 5) % 9}, Unit{0});
+            world.EditBody(bid).velocity = Vec3(Unit{i % 3 - 1}, Unit{0}, Unit{0});
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+            auto sid = world.AddShape(gid, i % 2 ? Shape::Sphere : Shape::OBB);
+            if (i % 2) {
+                world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+            } else {
+                world.GetOBB(world.GetShape(sid).shape_type_id).half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
+            }
+        }
+        // leave holes so the containers carry free ids
+        world.RemoveBody(3);
+        world.RemoveBody(11);
+    }
+
+    TEST_CASE("compact snapshot continues like a chunked one") {
+        for (auto type : { BroadphaseType::SweepAndPrune, BroadphaseType::DynamicTree, BroadphaseType::Grid }) {
+            World world;
+            world.SetBroadphase(type);
+            BuildSnapshotScene(world);
+            for (int i = 0; i < 3; i++) world.Update();
+
+            MemStream chunked;
+            MemStream compact;
+            world.Save(chunked);
+            world.Save(compact, SnapshotFormat::Compact);
+            chunked.rewind();
+            compact.rewind();
+
+            World from_chunked;
+            World from_compact;
+            from_chunked.Load(chunked);
+            from_compact.Load(compact);
+
+            for (int i = 0; i < 5; i++) {
+                from_chunked.Update();
+                from_compact.Update();
+            }
+
+            auto& c1 = from_chunked.GetContacts();
+            auto& c2 = from_compact.GetContacts();
+            REQUIRE(c1.size() == c2.size());
+            CHECK(c1.size() > 0);
+            for (uint32_t i = 0; i < c1.size(); i++) {
+                CHECK(c1[i].shape_a == c2[i].shape_a);
+                CHECK(c1[i].shape_b == c2[i].shape_b);
+                CHECK(c1[i].depth == c2[i].depth);
+            }
+
+            for (Identifier id = 0; id < 30; id++) {
+                if (id == 3 || id == 11) continue;
+                CHECK(from_chunked.GetBody(id).position == from_compact.GetBody(id).position);
+                CHECK(from_chunked.GetBody(id).velocity == from_compact.GetBody(id).velocity);
+            }
+        }
+    }
+
+    TEST_CASE("compact snapshot round trips byte for byte") {
+        World world;
+        world.SetBroadphase(BroadphaseType::DynamicTree);
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream stream1;
+        world.Save(stream1, SnapshotFormat::Compact);
+        stream1.rewind();
+
+        World world2;
+        world2.Load(stream1);
+
+        MemStream stream2;
+        world2.Save(stream2, SnapshotFormat::Compact);
+        REQUIRE(stream1.size() == stream2.size());
+        CHECK(std::memcmp(stream1.data(), stream2.data(), stream1.size()) == 0);
+    }
+
+    TEST_CASE("compact snapshot is smaller than a chunked one") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream chunked;
+        MemStream compact;
+        world.Save(chunked);
+        world.Save(compact, SnapshotFormat::Compact);
+
+        std::ostringstream log;
+        log << "chunked_bytes=" << chunked.size() << " compact_bytes=" << compact.size();
+        MESSAGE(log.str());
+
+        CHECK(compact.size() < chunked.size());
+    }
+
+    // Chunked save of a world with one body at (1, 2, 3), written by the first
+    // release, before snapshots carried a magic word and a version.
+    static const uint8_t UNVERSIONED_CHUNKED_SNAPSHOT[] = {
+        0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x60, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x04
+    };
+
+    TEST_CASE("snapshots of another version are rejected untouched") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+        const uint64_t hash = world.StateHash();
+
+        MemStream old_stream(UNVERSIONED_CHUNKED_SNAPSHOT, sizeof(UNVERSIONED_CHUNKED_SNAPSHOT));
+        CHECK_THROWS_AS(world.Load(old_stream), std::out_of_range);
+        CHECK(old_stream.tell() == 0);
+        CHECK(world.StateHash() == hash);
+
+        // the version follows the magic word in every format
+        for (auto format : { SnapshotFormat::Chunked, SnapshotFormat::Compact }) {
+            MemStream stream;
+            world.Save(stream, format);
+            Vec<uint8_t> bytes;
+            MemStream newer(&bytes);
+            newer.write_bytes(stream.data(), static_cast<uint32_t>(stream.size()));
+            uint32_t version = 0;
+            std::memcpy(&version, bytes.data() + 4, sizeof(version));
+            version++;
+            std::memcpy(bytes.data() + 4, &version, sizeof(version));
+            newer.rewind();
+            CHECK_THROWS_AS(world.Load(newer), std::out_of_range);
+            CHECK(world.StateHash() == hash);
+            if (format == SnapshotFormat::Compact) {
+                CHECK_THROWS_AS(WorldView{ newer }, std::out_of_range);
+            }
+
+            stream.rewind();
+            world.Load(stream);
+            CHECK(world.StateHash() == hash);
+        }
+    }
+
+    TEST_CASE("truncated compact snapshot throws") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream stream;
+        world.Save(stream, SnapshotFormat::Compact);
+
+        MemStream truncated;
+        truncated.write_bytes(stream.data(), static_cast<uint32_t>(stream.size() / 2));
+        truncated.rewind();
+
+        World loaded;
+        CHECK_THROWS_AS(loaded.Load(truncated), std::out_of_range);
+    }
+
+    static void CheckSameSnapshot(World& a, World& b) {
+        MemStream stream_a;
+        MemStream stream_b;
+        a.Save(stream_a, SnapshotFormat::Compact);
+        b.Save(stream_b, SnapshotFormat::Compact);
+        REQUIRE(stream_a.size() == stream_b.size());
+        CHECK(std::memcmp(stream_a.data(), stream_b.data(), stream_a.size()) == 0);
+    }
+
+    TEST_CASE("delta applied to its base restores the world") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream base;
+        world.Save(base, SnapshotFormat::Compact);
+
+        for (int i = 0; i < 3; i++) world.Update();
+        MemStream delta;
+        world.SaveDelta(base, delta);
+
+        World replica;
+        base.rewind();
+        replica.Load(base);
+        delta.rewind();
+        replica.LoadDelta(base, delta);
+        CheckSameSnapshot(world, replica);
+
+        world.Update();
+        replica.Update();
+        CheckSameSnapshot(world, replica);
+    }
+
+    TEST_CASE("delta covers added and removed entities") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream base;
+        world.Save(base, SnapshotFormat::Compact);
+
+        world.RemoveBody(5);
+        auto body = world.CreateBody();
+        auto group = world.AddShapeGroup(body);
+        world.AddShape(group, Shape::Capsule);
+        world.Update();
+
+        MemStream delta;
+        world.SaveDelta(base, delta);
+        World replica;
+        delta.rewind();
+        replica.LoadDelta(base, delta);
+        CheckSameSnapshot(world, replica);
+
+        // and back to the smaller world
+        MemStream bigger;
+        world.Save(bigger, SnapshotFormat::Compact);
+        base.rewind();
+        world.Load(base);
+        MemStream shrink;
+        world.SaveDelta(bigger, shrink);
+        shrink.rewind();
+        replica.LoadDelta(bigger, shrink);
+        CheckSameSnapshot(world, replica);
+    }
+
+    TEST_CASE("delta of a mostly static world is small") {
+        World world;
+        world.SetSleeping(false);
+        for (int i = 0; i < 200; i++) {
+            auto body = world.CreateBody();
+            world.EditBody(body).position = Vec3(Unit{(i % 20) * 4}, Unit{0}, Unit{(i / 20) * 4});
+            world.EditBody(body).is_static = i >= 10;
+            if (i < 10) world.EditBody(body).velocity = Vec3(Unit{0}, Unit{1}, Unit{0});
+            auto group = world.AddShapeGroup(body);
+            world.AddShape(group, Shape::Sphere);
+        }
+        world.Update();
+
+        MemStream base;
+        world.Save(base, SnapshotFormat::Compact);
+        world.Update();
+
+        MemStream full;
+        MemStream delta;
+        world.Save(full, SnapshotFormat::Compact);
+        world.SaveDelta(base, delta);
+
+        std::ostringstream log;
+        log << "full_bytes=" << full.size() << " delta_bytes=" << delta.size();
+        MESSAGE(log.str());
+
+        CHECK(delta.size() * 10 < full.size());
+    }
+
+    TEST_CASE("delta against the wrong base throws") {
+        World world;
+        BuildSnapshotScene(world);
+
+        MemStream base;
+        world.Save(base, SnapshotFormat::Compact);
+        world.Update();
+        MemStream delta;
+        world.SaveDelta(base, delta);
+
+        MemStream other;
+        world.Save(other, SnapshotFormat::Chunked);
+        World replica;
+        delta.rewind();
+        CHECK_THROWS_AS(replica.LoadDelta(other, delta), std::out_of_range);
+    }
+
+    TEST_CASE("delta against a wrong base of the same size throws") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream base;
+        world.Save(base, SnapshotFormat::Compact);
+
+        // same layout as base, only a position differs
+        World moved;
+        base.rewind();
+        moved.Load(base);
+        moved.EditBody(Identifier{0}).position.x += Unit{1};
+        MemStream other;
+        moved.Save(other, SnapshotFormat::Compact);
+
+        world.Update();
+        MemStream delta;
+        world.SaveDelta(base, delta);
+
+        REQUIRE(other.size() == base.size());
+        REQUIRE(std::memcmp(other.data(), base.data(), base.size()) != 0);
+        World replica;
+        delta.rewind();
+        CHECK_THROWS_AS(replica.LoadDelta(other, delta), std::out_of_range);
+
+        delta.rewind();
+        replica.LoadDelta(base, delta);
+        CheckSameSnapshot(world, replica);
+    }
+
+    static Identifier FirstSphere(World& world) {
+        for (Identifier id = 0; id < 30; id++) {
+            if (world.GetShape(id).type == Shape::Sphere) return world.GetShape(id).shape_type_id;
+        }
+        return INVALID_ID;
+    }
+
+    // Bodies made of several shapes, far enough apart to never touch.
+    static void BuildCompoundScene(World& world) {
+        for (int i = 0; i < 20; i++) {
+            auto body = world.CreateBody();
+            world.EditBody(body).position = Vec3(Unit{i * 10}, Unit{0}, Unit{0});
+            world.EditBody(body).velocity = Vec3(Unit{0}, Unit{1}, Unit{0});
+            auto group = world.AddShapeGroup(body);
+            world.AddShape(group, Shape::OBB);
+            world.AddShape(group, Shape::Sphere);
+            world.AddShape(group, Shape::Capsule);
+        }
+    }
+
+    TEST_CASE("incremental snapshot refers to unchanged containers") {
+        World world;
+        BuildCompoundScene(world);
+        world.Update();
+
+        MemStream key;
+        world.Save(key, SnapshotFormat::Compact);
+        for (int i = 0; i < 3; i++) world.Update();
+
+        MemStream full;
+        MemStream incremental;
+        world.Save(full, SnapshotFormat::Compact);
+        world.SaveIncremental(key, incremental);
+
+        std::ostringstream log;
+        log << "full_bytes=" << full.size() << " incremental_bytes=" << incremental.size();
+        MESSAGE(log.str());
+        CHECK(incremental.size() * 2 < full.size());
+
+        World replica;
+        incremental.rewind();
+        replica.LoadIncremental(key, incremental);
+        CheckSameSnapshot(world, replica);
+    }
+
+    TEST_CASE("incremental snapshot refers to the bodies of a sleeping world") {
+        World world;
+        world.SetSleepThreshold(Unit{1} / Unit{20}, 5);
+        BuildCompoundScene(world);
+        for (Identifier id = 0; id < 20; id++) {
+            world.EditBody(id).velocity = Vec3();
+        }
+        for (int i = 0; i < 10; i++) world.Update();
+        REQUIRE(!world.IsAwake(0));
+
+        MemStream key;
+        world.Save(key, SnapshotFormat::Compact);
+        MemStream fresh;
+        world.SaveIncremental(key, fresh);
+
+        // nothing is integrated, so the bodies stay unchanged since the key
+        for (int i = 0; i < 3; i++) world.Update();
+        MemStream incremental;
+        world.SaveIncremental(key, incremental);
+        CHECK(incremental.size() == fresh.size());
+
+        World replica;
+        incremental.rewind();
+        replica.LoadIncremental(key, incremental);
+        CheckSameSnapshot(world, replica);
+    }
+
+    TEST_CASE("incremental snapshot picks up shape edits and new entities") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream key;
+        world.Save(key, SnapshotFormat::Compact);
+
+        world.GetSphere(FirstSphere(world)).radius = Unit{3};
+        world.RemoveBody(7);
+        auto body = world.CreateBody();
+        world.AddShape(world.AddShapeGroup(body), Shape::Capsule);
+        world.Update();
+
+        MemStream incremental;
+        world.SaveIncremental(key, incremental);
+        World replica;
+        incremental.rewind();
+        replica.LoadIncremental(key, incremental);
+        CheckSameSnapshot(world, replica);
+        CHECK(!replica.IsValid(BodyHandle{ 7, 0 }));
+        // mutable access, only after comparing
+        CHECK(replica.GetSphere(FirstSphere(replica)).radius == Unit{3});
+    }
+
+    TEST_CASE("incremental snapshot still refers to a key after rolling back to it") {
+        World world;
+        BuildCompoundScene(world);
+        world.Update();
+
+        MemStream key;
+        world.Save(key, SnapshotFormat::Compact);
+        world.GetSphere(0).radius = Unit{3};
+        world.Update();
+
+        key.rewind();
+        world.Load(key);
+        world.Update();
+
+        MemStream full;
+        MemStream incremental;
+        world.Save(full, SnapshotFormat::Compact);
+        world.SaveIncremental(key, incremental);
+        CHECK(incremental.size() * 2 < full.size());
+
+        World replica;
+        incremental.rewind();
+        replica.LoadIncremental(key, incremental);
+        CheckSameSnapshot(world, replica);
+    }
+
+    TEST_CASE("incremental snapshot needs its key") {
+        World world;
+        BuildSnapshotScene(world);
+
+        MemStream key;
+        world.Save(key, SnapshotFormat::Compact);
+        world.Update();
+        MemStream incremental;
+        world.SaveIncremental(key, incremental);
+
+        World replica;
+        incremental.rewind();
+        CHECK_THROWS_AS(replica.Load(incremental), std::out_of_range);
+
+        MemStream other;
+        world.Save(other, SnapshotFormat::Chunked);
+        incremental.rewind();
+        CHECK_THROWS_AS(replica.LoadIncremental(other, incremental), std::out_of_range);
+    }
+
+    TEST_CASE("incremental snapshot without a usable key is complete") {
+        World world;
+        BuildSnapshotScene(world);
+        world.Update();
+
+        MemStream not_a_key;
+        world.Save(not_a_key, SnapshotFormat::Chunked);
+        MemStream incremental;
+        world.SaveIncremental(not_a_key, incremental);
+
+        World replica;
+        incremental.rewind();
+        replica.LoadIncremental(not_a_key, incremental);
+        CheckSameSnapshot(world, replica);
+    }
+}
+
+// ============================================================================
+// Snapshot ring tests
+// ============================================================================
+
+TEST_SUITE("Snapshot Ring") {
+    static void BuildRingScene(World& world) {
+        for (int i = 0; i < 12; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{(i % 4) * 3}, Unit{(i / 4) * 3}, Unit{0});
+            world.EditBody(bid).velocity = Vec3(Unit{i % 3 - 1}, Unit{1 - i % 2}, Unit{0});
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+            auto sid = world.AddShape(gid, Shape::Sphere);
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+        }
+    }
+
+    static Vec3 PositionAfter(int frames) {
+        World world;
+        BuildRingScene(world);
+        for (int i = 0; i < frames; i++) world.Update();
+        return world.GetBody(0).position;
+    }
+
+    TEST_CASE("restore rolls back and resimulates identically") {
+        World world;
+        BuildRingScene(world);
+        SnapshotRing ring(8);
+        for (int i = 0; i < 10; i++) {
+            ring.Push(world);
+            world.Update();
+        }
+        // pushed after 0..9 updates, the newest frame is 9 updates in
+        CHECK(ring.Newest() == 9);
+
+        ring.Restore(world, 3);
+        CHECK(ring.Newest() == 6);
+        CHECK(world.GetBody(0).position == PositionAfter(6));
+
+        for (int i = 0; i < 4; i++) world.Update();
+        CHECK(world.GetBody(0).position == PositionAfter(10));
+    }
+
+    TEST_CASE("ring keeps only the newest frames") {
+        World world;
+        BuildRingScene(world);
+        SnapshotRing ring(4);
+        for (int i = 0; i < 6; i++) {
+            CHECK(ring.Push(world) == static_cast<uint32_t>(i));
+            world.Update();
+        }
+
+        CHECK(ring.Size() == 4);
+        CHECK(!ring.Contains(1));
+        CHECK(ring.Contains(2));
+        CHECK(ring.Contains(5));
+        CHECK(!ring.Contains(6));
+        CHECK_THROWS_AS(ring.Peek(1), std::out_of_range);
+        CHECK_THROWS_AS(ring.Restore(world, 4), std::out_of_range);
+
+        MemStream oldest = ring.Peek(2);
+        World loaded;
+        loaded.Load(oldest);
+        CHECK(loaded.GetBody(0).position == PositionAfter(2));
+    }
+
+    TEST_CASE("restore drops the frames after it") {
+        World world;
+        BuildRingScene(world);
+        SnapshotRing ring(8);
+        for (int i = 0; i < 5; i++) {
+            ring.Push(world);
+            world.Update();
+        }
+
+        ring.Restore(world, 2);
+        CHECK(ring.Size() == 3);
+        CHECK(!ring.Contains(3));
+        CHECK(ring.Push(world) == 3);
+    }
+
+    TEST_CASE("capacity is clamped") {
+        CHECK(SnapshotRing(0).Capacity() == 1);
+        CHECK(SnapshotRing(1000).Capacity() == SnapshotRing::MAX_FRAMES);
+    }
+
+    TEST_CASE("warmed up push and restore do not allocate") {
+        World world;
+        BuildRingScene(world);
+        SnapshotRing ring(8);
+        for (int i = 0; i < 16; i++) {
+            ring.Push(world);
+            world.Update();
+        }
+        ring.Restore(world, 4);
+
+        uint64_t before = g_allocation_count;
+        for (int i = 0; i < 32; i++) {
+            ring.Push(world);
+            world.Update();
+            if (i % 4 == 3) ring.Restore(world, 2);
+        }
+        CHECK(g_allocation_count - before == 0);
+    }
+}
+
+// ============================================================================
+// State hash tests
+// ============================================================================
 
+TEST_SUITE("State Hash") {
+    static void BuildHashScene(World& world) {
+        auto floor = world.CreateBody();
+        world.EditBody(floor).is_static = true;
+        world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        auto floor_group = world.AddShapeGroup(floor);
+        world.EditShapeGroup(floor_group).layer = 1;
+        world.EditShapeGroup(floor_group).mask = 1;
+        auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+        world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{30}, Unit{1}, Unit{30});
+
+        for (int i = 0; i < 16; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{(i % 4) * 3}, Unit{1 + i % 3}, Unit{(i / 4) * 3});
+            world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
             auto gid = world.AddShapeGroup(bid);
-            world.GetShapeGroup(gid).layer = 1;
-            world.GetShapeGroup(gid).mask = 1;
-
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
             auto sid = world.AddShape(gid, Shape::Sphere);
-            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{2};
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
         }
+    }
 
-        const int M = 100;
-        auto start = std::chrono::high_resolution_clock::now();
-        for (int i = 0; i < M; i++) {
+    static uint64_t FreshHash(World& world) {
+        MemStream stream;
+        world.Save(stream, SnapshotFormat::Compact);
+        stream.rewind();
+        World copy;
+        copy.Load(stream);
+        return copy.StateHash();
+    }
+
+    TEST_CASE("equal worlds hash equal frame after frame") {
+        World a;
+        World b;
+        BuildHashScene(a);
+        BuildHashScene(b);
+        b.SetThreadCount(4);
+        for (int frame = 0; frame < 120; frame++) {
+            a.Update();
+            b.Update();
+            REQUIRE(a.StateHash() == b.StateHash());
+        }
+    }
+
+    TEST_CASE("incremental hash matches a hash from scratch") {
+        World world;
+        BuildHashScene(world);
+        for (int frame = 0; frame < 400; frame++) {
             world.Update();
+            world.StateHash();
+            if (frame == 40) world.RemoveBody(5);
+            if (frame == 60) world.GetSphere(2).radius = Unit{2};
+            if (frame == 90) world.EditBody(7).velocity = Vec3(Unit{0}, Unit{5}, Unit{0});
+            if (frame % 30 == 29) {
+                REQUIRE(world.StateHash() == FreshHash(world));
+            }
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        auto ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        // by now the scene has settled and gone to sleep
+        CHECK(!world.IsAwake(1));
+        CHECK(world.StateHash() == FreshHash(world));
+    }
 
-        auto& contacts = world.GetContacts();
+    TEST_CASE("a changed body changes the state hash and its own hash only") {
+        World world;
+        BuildHashScene(world);
+        world.Update();
 
-        std::ostringstream log;
-        log << "bodies=" << N
-            << " iterations=" << M
-            << " total_us=" << ms
-            << " per_iter_us=" << (ms / M)
-            << " contacts=" << contacts.size();
-        MESSAGE(log.str());
+        const uint64_t before = world.StateHash();
+        const uint64_t body_3 = world.BodyHash(3);
+        const uint64_t body_4 = world.BodyHash(4);
+        world.EditBody(3).velocity = Vec3(Unit{1}, Unit{0}, Unit{0});
 
-        CHECK(contacts.size() > 0);
+        CHECK(world.StateHash() != before);
+        CHECK(world.BodyHash(3) != body_3);
+        CHECK(world.BodyHash(4) == body_4);
     }
 
-    TEST_CASE("save load roundtrip with contacts") {
+    TEST_CASE("shape and settings changes change the state hash") {
         World world;
+        BuildHashScene(world);
+        world.Update();
 
-        // Body A: sphere at origin
-        auto ba = world.CreateBody();
-        auto ga = world.AddShapeGroup(ba);
-        world.GetShapeGroup(ga).layer = 1;
-        world.GetShapeGroup(ga).mask = 1;
-        auto sa = world.AddShape(ga, Shape::Sphere);
-        world.GetSphere(world.GetShape(sa).shape_type_id).radius = Unit{2};
+        uint64_t hash = world.StateHash();
+        world.GetSphere(0).radius = Unit{2};
+        CHECK(world.StateHash() != hash);
 
-        // Body B: OBB at (3,0,0)
-        auto bb = world.CreateBody();
-        world.GetBody(bb).position = Vec3(Unit{3}, Unit{0}, Unit{0});
-        auto gb = world.AddShapeGroup(bb);
-        world.GetShapeGroup(gb).layer = 1;
-        world.GetShapeGroup(gb).mask = 1;
-        auto sb = world.AddShape(gb, Shape::OBB);
-        auto& obb = world.GetOBB(world.GetShape(sb).shape_type_id);
-        obb.half_extents = Vec3(Unit{2}, Unit{2}, Unit{2});
+        hash = world.StateHash();
+        world.SetSolverIterations(8);
+        CHECK(world.StateHash() != hash);
+    }
 
-        // Body C: capsule at (0,0,3)
-        auto bc = world.CreateBody();
-        world.GetBody(bc).position = Vec3(Unit{0}, Unit{0}, Unit{3});
-        auto gc = world.AddShapeGroup(bc);
-        world.GetShapeGroup(gc).layer = 1;
-        world.GetShapeGroup(gc).mask = 1;
-        auto sc = world.AddShape(gc, Shape::Capsule);
-        auto& cap = world.GetCapsule(world.GetShape(sc).shape_type_id);
-        cap.start = Vec3(Unit{-2}, Unit{0}, Unit{0});
-        cap.end = Vec3(Unit{2}, Unit{0}, Unit{0});
-        cap.radius = Unit{1};
+    static void SpawnHashBody(World& world) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = Vec3(Unit{0}, Unit{6}, Unit{0});
+        world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, Shape::Sphere);
+        world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+    }
 
-        world.Update();
-        uint32_t contacts_before = world.GetContacts().size();
-        CHECK(contacts_before > 0);
+    TEST_CASE("a rollback that respawns a body is not a desync") {
+        World a;
+        BuildHashScene(a);
+        a.RemoveBody(5);
+        for (int frame = 0; frame < 5; frame++) a.Update();
+        MemStream state;
+        a.Save(state, SnapshotFormat::Compact);
+
+        World b;
+        state.rewind();
+        b.Load(state);
+
+        // a mispredicts two frames with a spawn, rolls back and spawns again
+        SpawnHashBody(a);
+        a.Update();
+        a.Update();
+        state.rewind();
+        a.Load(state);
+        SpawnHashBody(a);
+        SpawnHashBody(b);
+        for (int frame = 0; frame < 30; frame++) {
+            a.Update();
+            b.Update();
+            REQUIRE(a.StateHash() == b.StateHash());
+        }
+        for (uint32_t i = 0; i < a.GetBodyCount(); i++) {
+            CHECK(a.BodyHash(a.GetBodyId(i)) == b.BodyHash(a.GetBodyId(i)));
+        }
+    }
 
-        // Save
-        MemStream stream;
-        auto save_start = std::chrono::high_resolution_clock::now();
-        world.Save(stream);
-        auto save_end = std::chrono::high_resolution_clock::now();
-        uint32_t save_size = (uint32_t)stream.size();
-        stream.rewind();
+    TEST_CASE("body hash rejects stale handles") {
+        World world;
+        auto body = world.CreateBody();
+        CHECK(world.BodyHash(body) == world.BodyHash(body.id));
+        world.RemoveBody(body);
+        CHECK_THROWS_AS(world.BodyHash(body), std::out_of_range);
+        CHECK_THROWS_AS(world.BodyHash(INVALID_ID), std::out_of_range);
+    }
 
-        // Load
-        World world2;
-        auto load_start = std::chrono::high_resolution_clock::now();
-        world2.Load(stream);
-        auto load_end = std::chrono::high_resolution_clock::now();
+    TEST_CASE("body ids walk every body once") {
+        World world;
+        BuildHashScene(world);
+        world.RemoveBody(5);
+        for (int frame = 0; frame < 10; frame++) world.Update();
+
+        REQUIRE(world.GetBodyCount() == 16);
+        bool seen[17] = {};
+        for (uint32_t i = 0; i < world.GetBodyCount(); i++) {
+            const Identifier id = world.GetBodyId(i);
+            REQUIRE(id < 17);
+            CHECK(!seen[id]);
+            seen[id] = true;
+        }
+        for (Identifier id = 0; id < 17; id++) {
+            CHECK(seen[id] == (id != 5));
+        }
+        CHECK_THROWS_AS(world.GetBodyId(world.GetBodyCount()), std::out_of_range);
+    }
+}
 
-        auto save_us = std::chrono::duration_cast<std::chrono::microseconds>(save_end - save_start).count();
-        auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count();
+// ============================================================================
+// Replay tests
+// ============================================================================
 
-        std::ostringstream log;
-        log << "save_bytes=" << save_size
-            << " save_us=" << save_us
-            << " load_us=" << load_us
-            << " contacts_before=" << contacts_before;
-        MESSAGE(log.str());
+TEST_SUITE("Replay") {
+    static const char* REPLAY_PATH = "gekko_replay_test.bin";
 
-        // Re-save loaded world and memcmp (no Update — tests save/load fidelity)
-        MemStream stream2;
-        world2.Save(stream2);
-        CHECK(stream.size() == stream2.size());
-        CHECK(std::memcmp(stream.data(), stream2.data(), stream.size()) == 0);
+    static void BuildReplayScene(World& world) {
+        auto floor = world.CreateBody();
+        world.EditBody(floor).is_static = true;
+        world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        auto floor_group = world.AddShapeGroup(floor);
+        auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+        world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{20}, Unit{1}, Unit{20});
 
-        // After update, loaded world should still produce contacts
-        world2.Update();
-        CHECK(world2.GetContacts().size() > 0);
+        for (int i = 0; i < 6; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{i * 3}, Unit{2 + i}, Unit{0});
+            world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+            auto gid = world.AddShapeGroup(bid);
+            auto sid = world.AddShape(gid, Shape::Sphere);
+            world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+        }
     }
 
-    TEST_CASE("save load large world") {
+    // Records frames Update steps and returns the live hash of every frame.
+    static std::vector<uint64_t> RecordReplay(uint32_t frames, uint32_t keyframe_interval) {
         World world;
-        const int BODY_COUNT = 50;
+        BuildReplayScene(world);
+        ReplayWriter writer;
+        REQUIRE(writer.Open(REPLAY_PATH, keyframe_interval));
+
+        std::vector<uint64_t> hashes;
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            REQUIRE(writer.Record(world));
+            hashes.push_back(world.StateHash());
+            world.Update();
+        }
+        CHECK(writer.FrameCount() == frames);
+        CHECK(writer.Close());
+        return hashes;
+    }
 
-        for (int i = 0; i < BODY_COUNT; i++) {
-            auto bid = world.CreateBody();
-            world.GetBody(bid).position = Vec3(Unit{i * 2}, Unit{0}, Unit{0});
+    static void TruncateReplay(uint64_t size) {
+        std::vector<uint8_t> bytes(static_cast<size_t>(size));
+        std::FILE* file = std::fopen(REPLAY_PATH, "rb");
+        REQUIRE(file != nullptr);
+        REQUIRE(std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        std::fclose(file);
+
+        file = std::fopen(REPLAY_PATH, "wb");
+        REQUIRE(file != nullptr);
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
 
-            auto gid = world.AddShapeGroup(bid);
-            world.GetShapeGroup(gid).layer = 1;
-            world.GetShapeGroup(gid).mask = 1;
+    TEST_CASE("seeking restores every recorded frame") {
+        const std::vector<uint64_t> hashes = RecordReplay(50, 16);
 
-            // Alternate shape types
-            Shape::Type type;
-            switch (i % 3) {
-            case 0: type = Shape::Sphere; break;
-            case 1: type = Shape::OBB; break;
-            default: type = Shape::Capsule; break;
-            }
+        ReplayReader reader;
+        REQUIRE(reader.Open(REPLAY_PATH));
+        CHECK(reader.FrameCount() == 50);
+        CHECK(reader.KeyframeInterval() == 16);
+        CHECK(reader.GetFrame(16).keyframe == 16);
+        CHECK(reader.GetFrame(37).keyframe == 32);
 
-            auto sid = world.AddShape(gid, type);
-            switch (type) {
-            case Shape::Sphere:
+        // out of order, the way a scrubbing viewer would seek
+        World world;
+        const uint32_t order[] = { 49, 0, 17, 32, 31, 5, 48 };
+        for (uint32_t frame : order) {
+            reader.Seek(world, frame);
+            CHECK(world.StateHash() == hashes[frame]);
+            CHECK(reader.GetFrame(frame).hash == hashes[frame]);
+        }
+
+        // a restored frame simulates on like the original
+        reader.Seek(world, 20);
+        world.Update();
+        CHECK(world.StateHash() == hashes[21]);
+
+        CHECK_THROWS_AS(reader.Seek(world, 50), std::out_of_range);
+        reader.Close();
+        std::remove(REPLAY_PATH);
+    }
+
+    static void SpawnReplayBody(World& world) {
+        auto bid = world.CreateBody();
+        world.EditBody(bid).position = Vec3(Unit{0}, Unit{8}, Unit{0});
+        world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+        auto gid = world.AddShapeGroup(bid);
+        world.EditShapeGroup(gid).layer = 1;
+        world.EditShapeGroup(gid).mask = 1;
+        auto sid = world.AddShape(gid, Shape::Sphere);
+        world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
+    }
+
+    TEST_CASE("a recording made across a rollback matches a straight run") {
+        World rolled;
+        BuildReplayScene(rolled);
+        MemStream state;
+        rolled.Save(state, SnapshotFormat::Compact);
+        World straight;
+        state.rewind();
+        straight.Load(state);
+
+        // the recording peer spawned a body in mispredicted frames, rolled back and spawned it again
+        SpawnReplayBody(rolled);
+        rolled.Update();
+        state.rewind();
+        rolled.Load(state);
+        SpawnReplayBody(rolled);
+        SpawnReplayBody(straight);
+
+        ReplayWriter writer;
+        REQUIRE(writer.Open(REPLAY_PATH, 8));
+        for (int frame = 0; frame < 20; frame++) {
+            REQUIRE(writer.Record(rolled));
+            rolled.Update();
+        }
+        CHECK(writer.Close());
+
+        // checked the way GekkoPhysicsReplay does, and against the peer that never rolled back
+        ReplayReader reader;
+        REQUIRE(reader.Open(REPLAY_PATH));
+        World replayed;
+        reader.Seek(replayed, 0);
+        for (uint32_t frame = 0; frame + 1 < reader.FrameCount(); frame++) {
+            REQUIRE(reader.GetFrame(frame).hash == straight.StateHash());
+            replayed.Update();
+            straight.Update();
+            REQUIRE(replayed.StateHash() == reader.GetFrame(frame + 1).hash);
+        }
+        reader.Close();
+        std::remove(REPLAY_PATH);
+    }
+
+    TEST_CASE("keyframes are mapped, aligned compact snapshots") {
+        RecordReplay(10, 4);
+
+        ReplayReader reader;
+        REQUIRE(reader.Open(REPLAY_PATH));
+        for (uint32_t frame = 0; frame < reader.FrameCount(); frame++) {
+            CHECK(reader.GetFrame(frame).offset % 8 == 0);
+        }
+
+        MemStream key = reader.Snapshot(8);
+        CHECK(key.read_only());
+        World world;
+        world.Load(key);
+        CHECK(world.StateHash() == reader.GetFrame(8).hash);
+        reader.Close();
+        std::remove(REPLAY_PATH);
+    }
+
+    TEST_CASE("a file without index is scanned and a torn record dropped") {
+        const std::vector<uint64_t> hashes = RecordReplay(12, 5);
+
+        uint64_t last_end = 0, records_end = 0;
+        {
+            ReplayReader reader;
+            REQUIRE(reader.Open(REPLAY_PATH));
+            const ReplayFrame& last = reader.GetFrame(11);
+            last_end = last.offset + last.size;
+            records_end = (last_end + 7) / 8 * 8;
+        }
+
+        // as if the writer died before Close
+        TruncateReplay(records_end);
+        {
+            ReplayReader reader;
+            REQUIRE(reader.Open(REPLAY_PATH));
+            CHECK(reader.FrameCount() == 12);
+            World world;
+            reader.Seek(world, 9);
+            CHECK(world.StateHash() == hashes[9]);
+        }
+
+        // or while writing the last record
+        TruncateReplay(last_end - 1);
+        {
+            ReplayReader reader;
+            REQUIRE(reader.Open(REPLAY_PATH));
+            CHECK(reader.FrameCount() == 11);
+            World world;
+            reader.Seek(world, 10);
+            CHECK(world.StateHash() == hashes[10]);
+        }
+        std::remove(REPLAY_PATH);
+    }
+
+    TEST_CASE("open rejects missing and foreign files") {
+        ReplayReader reader;
+        CHECK(!reader.Open("gekko_replay_missing.bin"));
+
+        std::FILE* file = std::fopen(REPLAY_PATH, "wb");
+        REQUIRE(file != nullptr);
+        const char text[] = "not a replay file at all";
+        std::fwrite(text, 1, sizeof(text), file);
+        std::fclose(file);
+        CHECK(!reader.Open(REPLAY_PATH));
+        CHECK(!reader.IsOpen());
+        std::remove(REPLAY_PATH);
+
+        ReplayWriter writer;
+        World world;
+        CHECK(!writer.Record(world));
+        CHECK(!writer.Close());
+    }
+
+#ifdef __linux__
+    TEST_CASE("close reports a full disk") {
+        World world;
+        BuildReplayScene(world);
+        ReplayWriter writer;
+        // every write to /dev/full fails with ENOSPC, buffered ones once flushed
+        REQUIRE(writer.Open("/dev/full", 4));
+        writer.Record(world);
+        CHECK(!writer.Close());
+        CHECK(!writer.IsOpen());
+    }
+#endif
+}
+
+// ============================================================================
+// World View tests
+// ============================================================================
+
+TEST_SUITE("World View") {
+    static void BuildViewScene(World& world) {
+        auto floor = world.CreateBody();
+        world.EditBody(floor).is_static = true;
+        world.EditBody(floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        auto floor_group = world.AddShapeGroup(floor);
+        world.EditShapeGroup(floor_group).layer = 1;
+        world.EditShapeGroup(floor_group).mask = 1;
+        auto floor_shape = world.AddShape(floor_group, Shape::OBB);
+        world.GetOBB(world.GetShape(floor_shape).shape_type_id).half_extents = Vec3(Unit{20}, Unit{1}, Unit{20});
+
+        for (int i = 0; i < 8; i++) {
+            auto bid = world.CreateBody();
+            world.EditBody(bid).position = Vec3(Unit{i * 3}, Unit{1 + i % 2}, Unit{0});
+            world.EditBody(bid).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+            auto gid = world.AddShapeGroup(bid);
+            world.EditShapeGroup(gid).layer = 1;
+            world.EditShapeGroup(gid).mask = 1;
+            auto sid = world.AddShape(gid, i % 2 ? Shape::Capsule : Shape::Sphere);
+            if (i % 2) {
+                Capsule& capsule = world.GetCapsule(world.GetShape(sid).shape_type_id);
+                capsule.start = Vec3(Unit{-1}, Unit{0}, Unit{0});
+                capsule.end = Vec3(Unit{1}, Unit{0}, Unit{0});
+                capsule.radius = Unit{1};
+            } else {
                 world.GetSphere(world.GetShape(sid).shape_type_id).radius = Unit{1};
-                break;
-            case Shape::OBB: {
-                auto& o = world.GetOBB(world.GetShape(sid).shape_type_id);
-                o.half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
-                break;
-            }
-            case Shape::Capsule: {
-                auto& c = world.GetCapsule(world.GetShape(sid).shape_type_id);
-                c.start = Vec3(Unit{0}, Unit{-1}, Unit{0});
-                c.end = Vec3(Unit{0}, Unit{1}, Unit{0});
-                c.radius = Unit{1};
-                break;
-            }
-            default: break;
             }
         }
+        // ids run 0 to 8, the removed body leaves a hole in the middle
+        world.RemoveBody(4);
+    }
 
-        // Save
-        MemStream stream1;
-        auto save_start = std::chrono::high_resolution_clock::now();
-        world.Save(stream1);
-        auto save_end = std::chrono::high_resolution_clock::now();
-        stream1.rewind();
+    TEST_CASE("view reads the same state a loaded world holds") {
+        World world;
+        BuildViewScene(world);
+        for (int frame = 0; frame < 20; frame++) world.Update();
 
-        // Load
-        World world2;
-        auto load_start = std::chrono::high_resolution_clock::now();
-        world2.Load(stream1);
-        auto load_end = std::chrono::high_resolution_clock::now();
+        MemStream stream;
+        world.Save(stream, SnapshotFormat::Compact);
+        const WorldView view(stream);
+
+        const World& read = world;
+        REQUIRE(view.BodyCount() == 8);
+        for (uint32_t i = 0; i < view.BodyCount(); i++) {
+            const Identifier id = view.BodyIds()[i];
+            CHECK(view.BodyIndex(id) == i);
+            CHECK(view.BodyPositions()[i] == read.GetBody(id).position);
+            CHECK(view.BodyVelocities()[i] == read.GetBody(id).velocity);
+            CHECK((i < view.AwakeBodyCount()) == world.IsAwake(id));
+        }
+        CHECK(!view.Bodies().contains(4));
+        CHECK_THROWS_AS(view.BodyIndex(4), std::out_of_range);
+
+        CHECK(view.Shapes().size() == 8);
+        CHECK(view.OBBs().size() == 1);
+        CHECK(view.Spheres().size() == 4);
+        CHECK(view.Capsules().size() == 3);
+        for (Sphere sphere : view.Spheres().column<0>()) CHECK(sphere.radius == Unit{1});
+
+        const Vec<ContactPair>& contacts = world.GetContacts();
+        REQUIRE(contacts.size() > 0);
+        REQUIRE(view.Contacts().size() == contacts.size());
+        uint32_t matched = 0;
+        for (ContactPair contact : view.Contacts()) {
+            for (const ContactPair& live : contacts) {
+                if (live.shape_a == contact.shape_a && live.shape_b == contact.shape_b && live.depth == contact.depth) matched++;
+            }
+        }
+        CHECK(matched == contacts.size());
+    }
 
-        // Re-save and compare
-        MemStream stream2;
-        world2.Save(stream2);
+    TEST_CASE("view borrows the snapshot bytes without allocating") {
+        World world;
+        BuildViewScene(world);
+        world.Update();
+        MemStream stream;
+        world.Save(stream, SnapshotFormat::Compact);
+
+        const uint64_t before = g_allocation_count;
+        const WorldView view(stream);
+        Unit highest = view.BodyPositions()[0].y;
+        for (Vec3 position : view.BodyPositions()) highest = position.y > highest ? position.y : highest;
+        CHECK(g_allocation_count - before == 0);
+        CHECK(highest > Unit{0});
+
+        const uint8_t* positions = view.BodyPositions().data();
+        CHECK(positions > stream.data());
+        CHECK(positions < stream.data() + stream.size());
+    }
 
-        auto save_us = std::chrono::duration_cast<std::chrono::microseconds>(save_end - save_start).count();
-        auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count();
+    TEST_CASE("view rejects anything but an intact compact snapshot") {
+        World world;
+        BuildViewScene(world);
+        world.Update();
 
-        std::ostringstream log;
-        log << "bodies=" << BODY_COUNT
-            << " save1_bytes=" << stream1.size()
-            << " save2_bytes=" << stream2.size()
-            << " save_us=" << save_us
-            << " load_us=" << load_us;
-        MESSAGE(log.str());
+        MemStream chunked;
+        world.Save(chunked);
+        CHECK_THROWS_AS(WorldView view(chunked), std::out_of_range);
+
+        MemStream compact;
+        world.Save(compact, SnapshotFormat::Compact);
+        MemStream truncated(compact.data(), compact.size() - 1);
+        CHECK_THROWS_AS(WorldView view(truncated), std::out_of_range);
+
+        // point the first sparse entry of the body set far past its dense arrays
+        Vec<uint8_t> bytes;
+        bytes.push_back_range(compact.data(), static_cast<uint32_t>(compact.size()));
+        MemStream corrupt(&bytes);
+        const WorldView intact(corrupt);
+        const uint32_t id_count = 9;
+        uint8_t* sparse = const_cast<uint8_t*>(intact.Bodies().entities().data()) - id_count * sizeof(Identifier);
+        const Identifier far = 1000;
+        std::memcpy(sparse, &far, sizeof(far));
+        CHECK_THROWS_AS(WorldView view(corrupt), std::out_of_range);
+    }
 
-        CHECK(stream1.size() == stream2.size());
-        CHECK(std::memcmp(stream1.data(), stream2.data(), stream1.size()) == 0);
+    TEST_CASE("view reads a keyframe straight from a replay mapping") {
+        const char* path = "gekko_view_test.bin";
+        World world;
+        BuildViewScene(world);
+        ReplayWriter writer;
+        REQUIRE(writer.Open(path, 4));
+        for (int frame = 0; frame < 6; frame++) {
+            REQUIRE(writer.Record(world));
+            world.Update();
+        }
+        CHECK(writer.Close());
+
+        ReplayReader reader;
+        REQUIRE(reader.Open(path));
+        const WorldView view(reader.Snapshot(4));
+        World loaded;
+        reader.Seek(loaded, 4);
+        const World& read = loaded;
+        for (uint32_t i = 0; i < view.BodyCount(); i++) {
+            CHECK(view.BodyPositions()[i] == read.GetBody(view.BodyIds()[i]).position);
+        }
+        CHECK_THROWS_AS(WorldView delta(reader.Snapshot(5)), std::out_of_range);
+        reader.Close();
+        std::remove(path);
     }
 }
 
@@ -1617,8 +4777,8 @@ public:
 static void MakeSingleSphereWorld(World& world, MockDebugDraw& dd) {
     auto b = world.CreateBody();
     auto g = world.AddShapeGroup(b);
-    world.GetShapeGroup(g).layer = 1;
-    world.GetShapeGroup(g).mask = 1;
+    world.EditShapeGroup(g).layer = 1;
+    world.EditShapeGroup(g).mask = 1;
     auto s = world.AddShape(g, Shape::Sphere);
     world.GetSphere(world.GetShape(s).shape_type_id).radius = Unit{2};
     world.SetDebugDraw(&dd);
@@ -1656,8 +4816,8 @@ TEST_SUITE("DebugDraw") {
 
         auto b = world.CreateBody();
         auto g = world.AddShapeGroup(b);
-        world.GetShapeGroup(g).layer = 1;
-        world.GetShapeGroup(g).mask = 1;
+        world.EditShapeGroup(g).layer = 1;
+        world.EditShapeGroup(g).mask = 1;
         auto s = world.AddShape(g, Shape::OBB);
         world.GetOBB(world.GetShape(s).shape_type_id).half_extents = Vec3(Unit{1}, Unit{1}, Unit{1});
 
@@ -1673,8 +4833,8 @@ TEST_SUITE("DebugDraw") {
 
         auto b = world.CreateBody();
         auto g = world.AddShapeGroup(b);
-        world.GetShapeGroup(g).layer = 1;
-        world.GetShapeGroup(g).mask = 1;
+        world.EditShapeGroup(g).layer = 1;
+        world.EditShapeGroup(g).mask = 1;
         auto s = world.AddShape(g, Shape::Capsule);
         auto& cap = world.GetCapsule(world.GetShape(s).shape_type_id);
         cap.start = Vec3(Unit{0}, Unit{-1}, Unit{0});
@@ -1693,8 +4853,8 @@ TEST_SUITE("DebugDraw") {
 
         auto b = world.CreateBody();
         auto g = world.AddShapeGroup(b);
-        world.GetShapeGroup(g).layer = 1;
-        world.GetShapeGroup(g).mask = 1;
+        world.EditShapeGroup(g).layer = 1;
+        world.EditShapeGroup(g).mask = 1;
 
         world.AddShape(g, Shape::Sphere);
         world.AddShape(g, Shape::OBB);
@@ -1751,12 +4911,12 @@ TEST_SUITE("DebugDraw") {
         // Create two overlapping spheres to produce a contact
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
-        world.GetShapeGroup(g1).layer = 1; world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1; world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1; world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1; world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1791,12 +4951,12 @@ TEST_SUITE("DebugDraw") {
 
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
-        world.GetShapeGroup(g1).layer = 1; world.GetShapeGroup(g1).mask = 1;
-        world.GetShapeGroup(g2).layer = 1; world.GetShapeGroup(g2).mask = 1;
+        world.EditShapeGroup(g1).layer = 1; world.EditShapeGroup(g1).mask = 1;
+        world.EditShapeGroup(g2).layer = 1; world.EditShapeGroup(g2).mask = 1;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1837,11 +4997,11 @@ TEST_SUITE("DebugDraw") {
         world.SetDebugDraw(&dd);
 
         auto b = world.CreateBody();
-        world.GetBody(b).position = Vec3(Unit{10}, Unit{5}, Unit{3});
+        world.EditBody(b).position = Vec3(Unit{10}, Unit{5}, Unit{3});
 
         auto g = world.AddShapeGroup(b);
-        world.GetShapeGroup(g).layer = 1;
-        world.GetShapeGroup(g).mask = 1;
+        world.EditShapeGroup(g).layer = 1;
+        world.EditShapeGroup(g).mask = 1;
         auto s = world.AddShape(g, Shape::Sphere);
         world.GetSphere(world.GetShape(s).shape_type_id).radius = Unit{1};
         // sphere local center at (1, 0, 0)
@@ -1865,8 +5025,8 @@ TEST_SUITE("DebugDraw") {
 TEST_SUITE("Collision Resolution") {
     // Helper: set up layer/mask for a group
     static void SetLayerMask(World& world, Identifier group_id) {
-        world.GetShapeGroup(group_id).layer = 1;
-        world.GetShapeGroup(group_id).mask = 1;
+        world.EditShapeGroup(group_id).layer = 1;
+        world.EditShapeGroup(group_id).mask = 1;
     }
 
     TEST_CASE("trigger contacts generated but not resolved") {
@@ -1875,7 +5035,7 @@ TEST_SUITE("Collision Resolution") {
         auto b2 = world.CreateBody();
 
         // Overlap: distance 3, sum radii 4 => depth 1
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
@@ -1883,7 +5043,7 @@ TEST_SUITE("Collision Resolution") {
         SetLayerMask(world, g2);
 
         // Mark one group as trigger
-        world.GetShapeGroup(g1).is_trigger = true;
+        world.EditShapeGroup(g1).is_trigger = true;
 
         auto s1 = world.AddShape(g1, Shape::Sphere);
         auto s2 = world.AddShape(g2, Shape::Sphere);
@@ -1911,8 +5071,8 @@ TEST_SUITE("Collision Resolution") {
         auto b_stat = world.CreateBody();
 
         // Dynamic sphere at origin, static OBB at (2,0,0)
-        world.GetBody(b_stat).is_static = true;
-        world.GetBody(b_stat).position = Vec3(Unit{2}, Unit{0}, Unit{0});
+        world.EditBody(b_stat).is_static = true;
+        world.EditBody(b_stat).position = Vec3(Unit{2}, Unit{0}, Unit{0});
 
         auto g_dyn = world.AddShapeGroup(b_dyn);
         auto g_stat = world.AddShapeGroup(b_stat);
@@ -1945,8 +5105,8 @@ TEST_SUITE("Collision Resolution") {
         auto b2 = world.CreateBody();
 
         // Two dynamic spheres overlapping
-        world.GetBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
@@ -1971,7 +5131,7 @@ TEST_SUITE("Collision Resolution") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
@@ -2005,13 +5165,13 @@ TEST_SUITE("Collision Resolution") {
         auto b_floor = world.CreateBody();
 
         // Floor: static OBB at y=-1 (top face at y=0)
-        world.GetBody(b_floor).is_static = true;
-        world.GetBody(b_floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        world.EditBody(b_floor).is_static = true;
+        world.EditBody(b_floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
 
         // Sphere: dynamic, sitting on floor. Center at y=1 (bottom at y=0, just touching)
         // Start slightly inside to test stability
-        world.GetBody(b_sphere).position = Vec3(Unit{0}, Unit{1}, Unit{0});
-        world.GetBody(b_sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0}); // gravity
+        world.EditBody(b_sphere).position = Vec3(Unit{0}, Unit{1}, Unit{0});
+        world.EditBody(b_sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0}); // gravity
 
         auto g_sphere = world.AddShapeGroup(b_sphere);
         auto g_floor = world.AddShapeGroup(b_floor);
@@ -2045,10 +5205,10 @@ TEST_SUITE("Collision Resolution") {
         auto b1 = world.CreateBody();
         auto b2 = world.CreateBody();
 
-        world.GetBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
-        world.GetBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
+        world.EditBody(b1).position = Vec3(Unit{0}, Unit{0}, Unit{0});
+        world.EditBody(b2).position = Vec3(Unit{3}, Unit{0}, Unit{0});
         // b1 moving toward b2
-        world.GetBody(b1).velocity = Vec3(Unit{5}, Unit{0}, Unit{0});
+        world.EditBody(b1).velocity = Vec3(Unit{5}, Unit{0}, Unit{0});
 
         auto g1 = world.AddShapeGroup(b1);
         auto g2 = world.AddShapeGroup(b2);
@@ -2060,7 +5220,7 @@ TEST_SUITE("Collision Resolution") {
         world.GetSphere(world.GetShape(s1).shape_type_id).radius = Unit{2};
         world.GetSphere(world.GetShape(s2).shape_type_id).radius = Unit{2};
 
-        world.GetBody(b2).is_static = true;
+        world.EditBody(b2).is_static = true;
 
         world.Update();
 
@@ -2076,8 +5236,8 @@ TEST_SUITE("Collision Resolution") {
 
         // Floor: top surface at y=0
         auto b_floor = world.CreateBody();
-        world.GetBody(b_floor).is_static = true;
-        world.GetBody(b_floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        world.EditBody(b_floor).is_static = true;
+        world.EditBody(b_floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
         auto g_floor = world.AddShapeGroup(b_floor);
         SetLayerMask(world, g_floor);
         auto s_floor = world.AddShape(g_floor, Shape::OBB);
@@ -2086,8 +5246,8 @@ TEST_SUITE("Collision Resolution") {
 
         // Back wall at z=-11
         auto b_wall1 = world.CreateBody();
-        world.GetBody(b_wall1).is_static = true;
-        world.GetBody(b_wall1).position = Vec3(Unit{0}, Unit{2}, Unit{-11});
+        world.EditBody(b_wall1).is_static = true;
+        world.EditBody(b_wall1).position = Vec3(Unit{0}, Unit{2}, Unit{-11});
         auto g_wall1 = world.AddShapeGroup(b_wall1);
         SetLayerMask(world, g_wall1);
         auto s_wall1 = world.AddShape(g_wall1, Shape::OBB);
@@ -2096,8 +5256,8 @@ TEST_SUITE("Collision Resolution") {
 
         // Left wall at x=-11
         auto b_wall2 = world.CreateBody();
-        world.GetBody(b_wall2).is_static = true;
-        world.GetBody(b_wall2).position = Vec3(Unit{-11}, Unit{2}, Unit{0});
+        world.EditBody(b_wall2).is_static = true;
+        world.EditBody(b_wall2).position = Vec3(Unit{-11}, Unit{2}, Unit{0});
         auto g_wall2 = world.AddShapeGroup(b_wall2);
         SetLayerMask(world, g_wall2);
         auto s_wall2 = world.AddShape(g_wall2, Shape::OBB);
@@ -2106,8 +5266,8 @@ TEST_SUITE("Collision Resolution") {
 
         // Capsule: place in the corner at (-9, 2, -9)
         auto b_cap = world.CreateBody();
-        world.GetBody(b_cap).position = Vec3(Unit{-9}, Unit{2}, Unit{-9});
-        world.GetBody(b_cap).acceleration = gravity;
+        world.EditBody(b_cap).position = Vec3(Unit{-9}, Unit{2}, Unit{-9});
+        world.EditBody(b_cap).acceleration = gravity;
         auto g_cap = world.AddShapeGroup(b_cap);
         SetLayerMask(world, g_cap);
         auto s_cap = world.AddShape(g_cap, Shape::Capsule);
@@ -2135,4 +5295,65 @@ TEST_SUITE("Collision Resolution") {
         // Allow some tolerance for fixed-point
         CHECK(end_pos.y > Unit{1});
     }
+
+    // Sphere of radius 1 resting on a static floor whose top face is at y=0
+    static Identifier MakeRestingSphere(World& world) {
+        auto b_sphere = world.CreateBody();
+        auto b_floor = world.CreateBody();
+        world.EditBody(b_floor).is_static = true;
+        world.EditBody(b_floor).position = Vec3(Unit{0}, Unit{-1}, Unit{0});
+        world.EditBody(b_sphere).position = Vec3(Unit{0}, Unit{1}, Unit{0});
+        world.EditBody(b_sphere).acceleration = Vec3(Unit{0}, Unit{-10}, Unit{0});
+
+        auto g_sphere = world.AddShapeGroup(b_sphere);
+        auto g_floor = world.AddShapeGroup(b_floor);
+        SetLayerMask(world, g_sphere);
+        SetLayerMask(world, g_floor);
+
+        auto s_sphere = world.AddShape(g_sphere, Shape::Sphere);
+        world.GetSphere(world.GetShape(s_sphere).shape_type_id).radius = Unit{1};
+        auto s_floor = world.AddShape(g_floor, Shape::OBB);
+        world.GetOBB(world.GetShape(s_floor).shape_type_id).half_extents = Vec3(Unit{10}, Unit{1}, Unit{10});
+        return b_sphere;
+    }
+
+    TEST_CASE("warm starting settles resting contact in one iteration") {
+        World world;
+        world.SetSolverIterations(1);
+        MakeRestingSphere(world);
+
+        for (int i = 0; i < 120; i++) {
+            world.Update();
+        }
+
+        // without warm starting a single iteration rests at ~0.017 deep,
+        // (slop 0.01 + per frame gravity drift / 0.4)
+        REQUIRE(world.GetContacts().size() == 1);
+        const ContactPair& contact = world.GetContacts()[0];
+        CHECK(contact.depth < Unit{135} / Unit{10000});
+        CHECK(contact.correction > Unit{0});
+    }
+
+    TEST_CASE("contact cache survives save and load") {
+        World world;
+        world.SetSolverIterations(1);
+        auto b_sphere = MakeRestingSphere(world);
+        for (int i = 0; i < 30; i++) {
+            world.Update();
+        }
+
+        MemStream stream;
+        world.Save(stream);
+        stream.rewind();
+        World world2;
+        world2.Load(stream);
+
+        for (int i = 0; i < 30; i++) {
+            world.Update();
+            world2.Update();
+        }
+        CHECK(world.GetBody(b_sphere).position == world2.GetBody(b_sphere).position);
+        REQUIRE(world2.GetContacts().size() == 1);
+        CHECK(world.GetContacts()[0].correction == world2.GetContacts()[0].correction);
+    }
 }
@@ -96,13 +96,13 @@ static GekkoPhysics::Identifier BuildScene(GekkoPhysics::World& world) {
     // Helper: create body + shape group
     auto makeBody = [&](Vec3 pos, bool is_static, Mat3 rot = Mat3()) {
         Identifier bid = world.CreateBody();
-        Body& b = world.GetBody(bid);
+        BodyRef b = world.EditBody(bid);
         b.position = pos;
         b.is_static = is_static;
         b.rotation = rot;
         if (!is_static) b.acceleration = gravity;
         Identifier gid = world.AddShapeGroup(bid);
-        ShapeGroup& sg = world.GetShapeGroup(gid);
+        ShapeGroupRef sg = world.EditShapeGroup(gid);
         sg.layer = 1; sg.mask = 0xFFFFFFFF;
         return std::pair<Identifier, Identifier>{bid, gid};
     };
@@ -213,7 +213,7 @@ int main() {
     while (!window.ShouldClose()) {
         // Arrow keys set horizontal velocity, space to jump
         {
-            auto& body = world.GetBody(controlled);
+            auto body = world.EditBody(controlled);
             GekkoMath::Unit vx{0}, vz{0};
             if (IsKeyDown(KEY_RIGHT)) vx += move_speed;
             if (IsKeyDown(KEY_LEFT))  vx -= move_speed;